@@ -0,0 +1,67 @@
+#include "Adafruit_NeoPixel.h"
+#include "NativeSim.h"
+
+#include <vector>
+
+Adafruit_NeoPixel::Adafruit_NeoPixel(uint16_t n, uint16_t, neoPixelType)
+  : numLEDs(n)
+  , brightness(0)
+  , pixels(new uint8_t[n * 3]())
+  , shown(new uint8_t[n * 3]()) {
+}
+
+Adafruit_NeoPixel::~Adafruit_NeoPixel() {
+  delete[] pixels;
+  delete[] shown;
+}
+
+void Adafruit_NeoPixel::show() {
+  memcpy(shown, pixels, numLEDs * 3);
+  std::vector<uint8_t> grb(numLEDs * 3);
+  for (uint16_t i = 0; i < numLEDs; i++) {
+    grb[i * 3] = shown[i * 3 + 1];
+    grb[i * 3 + 1] = shown[i * 3];
+    grb[i * 3 + 2] = shown[i * 3 + 2];
+  }
+  // 24 bits of 1.25us a pixel, busy-waited with the interrupts off
+  NativeSim::ledFrame(grb.data(), grb.size(), numLEDs * 30);
+}
+
+void Adafruit_NeoPixel::clear() {
+  memset(pixels, 0, numLEDs * 3);
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
+  if (n >= numLEDs) {
+    return;
+  }
+  if (brightness) {
+    r = (r * brightness) >> 8;
+    g = (g * brightness) >> 8;
+    b = (b * brightness) >> 8;
+  }
+  uint8_t *p = &pixels[n * 3];
+  p[0] = r;
+  p[1] = g;
+  p[2] = b;
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint32_t c) {
+  setPixelColor(n, (uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c);
+}
+
+uint32_t Adafruit_NeoPixel::getPixelColor(uint16_t n) const {
+  if (n >= numLEDs) {
+    return 0;
+  }
+  const uint8_t *p = &pixels[n * 3];
+  return Color(p[0], p[1], p[2]);
+}
+
+uint32_t Adafruit_NeoPixel::shownColor(uint16_t n) const {
+  if (n >= numLEDs) {
+    return 0;
+  }
+  const uint8_t *p = &shown[n * 3];
+  return Color(p[0], p[1], p[2]);
+}
@@ -0,0 +1,49 @@
+// Host stand-in for https://github.com/adafruit/Adafruit_NeoPixel
+// show() copies the frame and hands it to NativeSim, which moves the clock
+// on by the time the real one keeps the interrupts masked.
+
+#ifndef NATIVE_HAL_ADAFRUIT_NEOPIXEL_H
+#define NATIVE_HAL_ADAFRUIT_NEOPIXEL_H
+
+#include "Arduino.h"
+
+#define NEO_GRB ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_RGB ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_KHZ800 0x0000
+#define NEO_KHZ400 0x0100
+
+typedef uint16_t neoPixelType;
+
+class Adafruit_NeoPixel {
+  public:
+    Adafruit_NeoPixel(uint16_t n, uint16_t pin = 6, neoPixelType type = NEO_GRB + NEO_KHZ800);
+    ~Adafruit_NeoPixel();
+
+    void begin() {}
+    void show();
+    void clear();
+    void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+    void setPixelColor(uint16_t n, uint32_t c);
+    void setBrightness(uint8_t b) { brightness = b; }
+
+    uint32_t getPixelColor(uint16_t n) const;
+    uint8_t getBrightness() const { return brightness; }
+    uint16_t numPixels() const { return numLEDs; }
+    uint8_t *getPixels() const { return pixels; }
+    bool canShow() const { return true; }
+
+    // The frame as it was at the last show(), 0x00RRGGBB per pixel
+    uint32_t shownColor(uint16_t n) const;
+
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+      return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+    }
+
+  private:
+    uint16_t numLEDs;
+    uint8_t brightness;
+    uint8_t *pixels;
+    uint8_t *shown;
+};
+
+#endif // NATIVE_HAL_ADAFRUIT_NEOPIXEL_H
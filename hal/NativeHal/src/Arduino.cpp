@@ -0,0 +1,231 @@
+#include "Arduino.h"
+#include "NativeSim.h"
+
+#include <random>
+
+#include <malloc.h>
+
+EspClass ESP;
+
+namespace {
+  std::minstd_rand rng;
+  const uint8_t PIN_COUNT = 17;
+  uint8_t pinMode_[PIN_COUNT];
+  uint8_t pinLevel[PIN_COUNT];
+
+  struct PinInterrupt {
+    void (*callback)(void);
+    int mode;
+    int level;
+  };
+  PinInterrupt pinInterrupts[PIN_COUNT];
+  bool interruptsHooked = false;
+
+  void interruptPump() {
+    for (uint8_t pin = 0; pin < PIN_COUNT; pin++) {
+      PinInterrupt &irq = pinInterrupts[pin];
+      if (irq.callback == NULL) {
+        continue;
+      }
+      int level = digitalRead(pin);
+      bool fire = (irq.mode == ONLOW && level == LOW)
+               || (irq.mode == ONHIGH && level == HIGH)
+               || (level != irq.level && (irq.mode == CHANGE
+                                          || (irq.mode == RISING && level == HIGH)
+                                          || (irq.mode == FALLING && level == LOW)));
+      irq.level = level;
+      if (fire) {
+        irq.callback();
+      }
+    }
+  }
+
+  timercallback timer1Callback = NULL;
+  bool timer1Enabled = false;
+  bool timer1Loop = false;
+  uint8_t timer1Divider = TIM_DIV1;
+  uint32_t timer1Ticks = 0;
+  uint64_t timer1Due = 0;
+  bool timer1Hooked = false;
+
+  uint64_t timer1PeriodMicros() {
+    switch (timer1Divider) {
+      case TIM_DIV16:
+        return timer1Ticks / 5;
+      case TIM_DIV256:
+        return (uint64_t)timer1Ticks * 16 / 5;
+      default:
+        return timer1Ticks / 80;
+    }
+  }
+
+  void timer1Pump() {
+    if (!timer1Enabled || timer1Callback == NULL || NativeSim::nowMicros() < timer1Due) {
+      return;
+    }
+    // Like on the chip an overdue interrupt fires once, not once per missed period
+    uint64_t period = timer1PeriodMicros();
+    timer1Due = NativeSim::nowMicros() + (period > 0 ? period : 1);
+    if (!timer1Loop) {
+      timer1Enabled = false;
+    }
+    timer1Callback();
+  }
+}
+
+unsigned long millis() {
+  return (unsigned long)(NativeSim::nowMicros() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)NativeSim::nowMicros();
+}
+
+// Time passes in 1ms steps so timer1 and the MQTT events keep firing
+// during a long delay, like on the chip.
+void delay(unsigned long ms) {
+  do {
+    NativeSim::advance(ms > 0 ? 1 : 0);
+    NativeSim::pump();
+  } while (ms-- > 1);
+}
+
+void yield() {
+  NativeSim::pump();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < PIN_COUNT) {
+    pinMode_[pin] = mode;
+    if (mode == INPUT_PULLUP) {
+      pinLevel[pin] = HIGH;
+    }
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin < PIN_COUNT) {
+    pinLevel[pin] = val;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  if (pin >= PIN_COUNT) {
+    return LOW;
+  }
+  if (pinMode_[pin] == OUTPUT) {
+    return pinLevel[pin];
+  }
+  // a closed keypad switch pulls the input down to a column driven LOW
+  for (uint8_t col = 0; col < PIN_COUNT; col++) {
+    if (pinMode_[col] == OUTPUT && pinLevel[col] == LOW && NativeSim::keyClosed(pin, col)) {
+      return LOW;
+    }
+  }
+  return pinMode_[pin] == INPUT_PULLUP ? HIGH : pinLevel[pin];
+}
+
+void attachInterrupt(uint8_t pin, void (*userFunc)(void), int mode) {
+  if (pin >= PIN_COUNT) {
+    return;
+  }
+  pinInterrupts[pin].callback = userFunc;
+  pinInterrupts[pin].mode = mode;
+  pinInterrupts[pin].level = digitalRead(pin);
+  if (!interruptsHooked) {
+    interruptsHooked = true;
+    NativeSim::addInterruptHandler(interruptPump);
+  }
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin < PIN_COUNT) {
+    pinInterrupts[pin].callback = NULL;
+  }
+}
+
+void timer1_isr_init(void) {
+}
+
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload) {
+  (void)int_type;
+  timer1Divider = divider;
+  timer1Loop = reload == TIM_LOOP;
+  timer1Enabled = true;
+  timer1Due = NativeSim::nowMicros() + timer1PeriodMicros();
+  if (!timer1Hooked) {
+    timer1Hooked = true;
+    NativeSim::addInterruptHandler(timer1Pump);
+  }
+}
+
+void timer1_disable(void) {
+  timer1Enabled = false;
+}
+
+void timer1_attachInterrupt(timercallback userFunc) {
+  timer1Callback = userFunc;
+}
+
+void timer1_detachInterrupt(void) {
+  timer1Callback = NULL;
+  timer1Enabled = false;
+}
+
+void timer1_write(uint32_t ticks) {
+  timer1Ticks = ticks;
+  timer1Due = NativeSim::nowMicros() + timer1PeriodMicros();
+}
+
+long random(long howbig) {
+  if (howbig <= 0) {
+    return 0;
+  }
+  return (long)(rng() % (unsigned long)howbig);
+}
+
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) {
+    return howsmall;
+  }
+  return howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+  if (seed != 0) {
+    rng.seed(seed);
+  }
+}
+
+void EspClass::restart() {
+  Serial.println("ESP.restart()");
+  fflush(stdout);
+  exit(3);
+}
+
+uint32_t EspClass::getChipId() {
+  return 0x00C0FFEE;
+}
+
+// Mirrors the ~80KB heap of the ESP8266 so the firmware sees sane numbers;
+// what is reported as used is the host allocation grown since the first call.
+uint32_t EspClass::getFreeHeap() {
+  const uint32_t heapSize = 81920;
+  static size_t baseline = mallinfo2().uordblks;
+  size_t used = mallinfo2().uordblks;
+  used = used > baseline ? used - baseline : 0;
+  return used < heapSize ? heapSize - (uint32_t)used : 0;
+}
+
+// The host heap does not fragment like umm_malloc, report it as one block
+uint32_t EspClass::getMaxFreeBlockSize() {
+  return getFreeHeap();
+}
+
+uint8_t EspClass::getHeapFragmentation() {
+  return 0;
+}
+
+uint32_t EspClass::getCycleCount() {
+  return (uint32_t)(NativeSim::nowMicros() * 80);
+}
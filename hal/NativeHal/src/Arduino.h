@@ -0,0 +1,112 @@
+// Minimal Arduino core for the host (native) build.
+// Only what the keypad firmware uses is provided here.
+
+#ifndef NATIVE_HAL_ARDUINO_H
+#define NATIVE_HAL_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <memory>
+#include <functional>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT          0x00
+#define OUTPUT         0x01
+#define INPUT_PULLUP   0x02
+
+// Wemos D1 mini pin names mapped to the ESP8266 GPIO numbers
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+
+// Flash helpers are no-ops on the host
+#define PROGMEM
+#define PSTR(s) (s)
+#define ICACHE_RAM_ATTR
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define memcpy_P memcpy
+#define strcmp_P strcmp
+#define strlen_P strlen
+#define strncpy_P strncpy
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+#include "WString.h"
+#include "Print.h"
+#include "HardwareSerial.h"
+#include "IPAddress.h"
+#include "Esp.h"
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+// GPIO interrupts, checked by the simulator on every NativeSim::pump()
+#define RISING    0x01
+#define FALLING   0x02
+#define CHANGE    0x03
+#define ONLOW     0x04
+#define ONHIGH    0x05
+
+#define digitalPinToInterrupt(p) (p)
+
+void attachInterrupt(uint8_t pin, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+// timer1, the hardware timer interrupt. The simulator fires the callback
+// from NativeSim::pump() when the period has elapsed.
+typedef void (*timercallback)(void);
+
+#define TIM_DIV1   0 // 80MHz (80 ticks/us)
+#define TIM_DIV16  1 // 5MHz (5 ticks/us)
+#define TIM_DIV256 3 // 312.5Khz (1 tick = 3.2us)
+
+#define TIM_EDGE   0
+#define TIM_LEVEL  1
+
+#define TIM_SINGLE 0
+#define TIM_LOOP   1
+
+void timer1_isr_init(void);
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload);
+void timer1_disable(void);
+void timer1_attachInterrupt(timercallback userFunc);
+void timer1_detachInterrupt(void);
+void timer1_write(uint32_t ticks);
+
+#define interrupts() do {} while (0)
+#define noInterrupts() do {} while (0)
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+// The sketch entry points implemented in src/main.cpp
+void setup();
+void loop();
+
+#endif // NATIVE_HAL_ARDUINO_H
@@ -0,0 +1,306 @@
+#include "AsyncMqttClient.h"
+#include "NativeSim.h"
+
+#include <string.h>
+#include <chrono>
+#include <map>
+
+namespace {
+  AsyncMqttClient *instance = nullptr;
+  size_t fragmentSize = 1460;
+
+  // Retained messages of the simulated broker
+  std::map<std::string, std::string> retained;
+}
+
+AsyncMqttClient::AsyncMqttClient()
+  : state(State::DISCONNECTED)
+  , nextPacketId(1)
+  , willRetain(false)
+  , pendingDisconnect(false)
+  , secure(false)
+  , handshaking(false)
+  , handshakeStart(0) {
+  instance = this;
+  NativeSim::addPumpHandler([this]() { pump(); });
+}
+
+AsyncMqttClient::~AsyncMqttClient() {
+  if (instance == this) {
+    instance = nullptr;
+  }
+}
+
+AsyncMqttClient &AsyncMqttClient::setKeepAlive(uint16_t) { return *this; }
+AsyncMqttClient &AsyncMqttClient::setClientId(const char *) { return *this; }
+AsyncMqttClient &AsyncMqttClient::setCleanSession(bool) { return *this; }
+AsyncMqttClient &AsyncMqttClient::setMaxTopicLength(uint16_t) { return *this; }
+AsyncMqttClient &AsyncMqttClient::setCredentials(const char *, const char *) { return *this; }
+AsyncMqttClient &AsyncMqttClient::setServer(const char *, uint16_t) { return *this; }
+
+#if ASYNC_TCP_SSL_ENABLED
+AsyncMqttClient &AsyncMqttClient::setSecure(bool _secure) {
+  secure = _secure;
+  return *this;
+}
+
+AsyncMqttClient &AsyncMqttClient::addServerFingerprint(const uint8_t *fingerprint) {
+  std::array<uint8_t, 20> entry;
+  memcpy(entry.data(), fingerprint, entry.size());
+  fingerprints.push_back(entry);
+  return *this;
+}
+#endif
+
+AsyncMqttClient &AsyncMqttClient::setWill(const char *topic, uint8_t, bool retain, const char *payload, size_t length) {
+  willTopic = topic ? topic : "";
+  willPayload = payload ? std::string(payload, length ? length : strlen(payload)) : "";
+  willRetain = retain;
+  return *this;
+}
+
+AsyncMqttClient &AsyncMqttClient::onConnect(AsyncMqttClientInternals::OnConnectUserCallback callback) { connectCallback = callback; return *this; }
+AsyncMqttClient &AsyncMqttClient::onDisconnect(AsyncMqttClientInternals::OnDisconnectUserCallback callback) { disconnectCallback = callback; return *this; }
+AsyncMqttClient &AsyncMqttClient::onSubscribe(AsyncMqttClientInternals::OnSubscribeUserCallback callback) { subscribeCallback = callback; return *this; }
+AsyncMqttClient &AsyncMqttClient::onMessage(AsyncMqttClientInternals::OnMessageUserCallback callback) { messageCallback = callback; return *this; }
+AsyncMqttClient &AsyncMqttClient::onPublish(AsyncMqttClientInternals::OnPublishUserCallback callback) { publishCallback = callback; return *this; }
+
+bool AsyncMqttClient::connected() const {
+  return state == State::CONNECTED;
+}
+
+void AsyncMqttClient::connect() {
+  if (state != State::DISCONNECTED) {
+    return;
+  }
+  state = State::CONNECTING;
+}
+
+void AsyncMqttClient::disconnect(bool) {
+  if (state == State::DISCONNECTED) {
+    return;
+  }
+  state = State::DISCONNECTED;
+  pendingDisconnect = false;
+  subscriptions.clear();
+  handshaking = false;
+  std::vector<uint8_t>().swap(tlsBuffers);
+  if (disconnectCallback) {
+    disconnectCallback(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED);
+  }
+}
+
+uint16_t AsyncMqttClient::subscribe(const char *topic, uint8_t qos) {
+  if (state != State::CONNECTED) {
+    return 0;
+  }
+  subscriptions.push_back(topic);
+  for (auto &message : retained) {
+    if (topicMatches(topic, message.first)) {
+      inbox.push_back(Message{message.first, message.second, qos, true});
+    }
+  }
+  return nextPacketId++;
+}
+
+uint16_t AsyncMqttClient::unsubscribe(const char *topic) {
+  if (state != State::CONNECTED) {
+    return 0;
+  }
+  for (auto it = subscriptions.begin(); it != subscriptions.end(); ++it) {
+    if (*it == topic) {
+      subscriptions.erase(it);
+      break;
+    }
+  }
+  return nextPacketId++;
+}
+
+uint16_t AsyncMqttClient::publish(const char *topic, uint8_t qos, bool retain, const char *payload, size_t length, bool, uint16_t) {
+  if (state != State::CONNECTED) {
+    return 0;
+  }
+  if (payload == nullptr) {
+    payload = "";
+  }
+  if (length == 0) {
+    length = strlen(payload);
+  }
+
+  NativeSim::notifyPublish(topic, payload, length, qos, retain);
+
+  std::string body(payload, length);
+  if (retain) {
+    retained[topic] = body;
+  }
+  if (subscribed(topic)) {
+    inbox.push_back(Message{topic, body, qos, false});
+  }
+
+  if (qos == 0) {
+    return 1;
+  }
+  uint16_t packetId = nextPacketId++;
+  if (nextPacketId == 0) {
+    nextPacketId = 1;
+  }
+  pendingAcks.push_back(packetId);
+  return packetId;
+}
+
+void AsyncMqttClient::pump() {
+  if (state == State::CONNECTING) {
+    if (NativeSim::brokerReachable() && secure != NativeSim::brokerTls().enabled) {
+      // plain text on the TLS listener or the other way round
+      dropConnection(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED);
+    } else if (NativeSim::brokerReachable()) {
+      if (secure && !handshake()) {
+        return;
+      }
+      state = State::CONNECTED;
+      if (connectCallback) {
+        connectCallback(false);
+      }
+    } else {
+      dropConnection(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED);
+    }
+    return;
+  }
+
+  if (pendingDisconnect) {
+    pendingDisconnect = false;
+    dropConnection(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED);
+    return;
+  }
+
+  if (state != State::CONNECTED) {
+    return;
+  }
+
+  std::vector<uint16_t> acks;
+  acks.swap(pendingAcks);
+  for (uint16_t packetId : acks) {
+    if (publishCallback) {
+      publishCallback(packetId);
+    }
+  }
+
+  std::vector<Message> messages;
+  messages.swap(inbox);
+  for (auto &message : messages) {
+    if (!messageCallback) {
+      continue;
+    }
+    AsyncMqttClientMessageProperties properties = { message.qos, false, message.retain };
+    size_t total = message.payload.size();
+    size_t index = 0;
+    std::chrono::steady_clock::duration handling(0);
+    do {
+      size_t len = total - index < fragmentSize ? total - index : fragmentSize;
+      std::vector<char> topic(message.topic.begin(), message.topic.end());
+      topic.push_back('\0');
+      // The chunk is null terminated for safety only, the real client
+      // hands out a pointer into the TCP buffer without a terminator.
+      std::vector<char> chunk(message.payload.begin() + index, message.payload.begin() + index + len);
+      chunk.push_back('\0');
+      auto start = std::chrono::steady_clock::now();
+      messageCallback(topic.data(), chunk.data(), properties, len, index, total);
+      handling += std::chrono::steady_clock::now() - start;
+      index += len;
+    } while (index < total);
+    NativeSim::notifyHandled(message.topic.c_str(), std::chrono::duration_cast<std::chrono::microseconds>(handling).count());
+  }
+}
+
+bool AsyncMqttClient::handshake() {
+  const NativeSim::BrokerTls &tls = NativeSim::brokerTls();
+  unsigned long now = NativeSim::nowMicros() / 1000;
+  if (!handshaking) {
+    handshaking = true;
+    handshakeStart = now;
+    tlsBuffers.assign(tls.handshakeHeap, 0xA5);
+  }
+  if (now - handshakeStart < tls.handshakeMs) {
+    return false;
+  }
+  handshaking = false;
+
+  bool trusted = fingerprints.empty();
+  for (auto &fingerprint : fingerprints) {
+    trusted = trusted || memcmp(fingerprint.data(), tls.fingerprint, fingerprint.size()) == 0;
+  }
+  if (!trusted) {
+    dropConnection(AsyncMqttClientDisconnectReason::TLS_BAD_FINGERPRINT);
+    return false;
+  }
+  std::vector<uint8_t>(tls.sessionHeap, 0xA5).swap(tlsBuffers);
+  return true;
+}
+
+void AsyncMqttClient::dropConnection(AsyncMqttClientDisconnectReason reason) {
+  bool wasConnected = state == State::CONNECTED;
+  state = State::DISCONNECTED;
+  handshaking = false;
+  std::vector<uint8_t>().swap(tlsBuffers);
+  subscriptions.clear();
+  inbox.clear();
+  pendingAcks.clear();
+  if (wasConnected && !willTopic.empty()) {
+    if (willRetain) {
+      retained[willTopic] = willPayload;
+    }
+    NativeSim::notifyPublish(willTopic.c_str(), willPayload.c_str(), willPayload.size(), 1, willRetain);
+  }
+  if (disconnectCallback) {
+    disconnectCallback(reason);
+  }
+}
+
+bool AsyncMqttClient::subscribed(const std::string &topic) const {
+  for (auto &filter : subscriptions) {
+    if (topicMatches(filter, topic)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool AsyncMqttClient::topicMatches(const std::string &filter, const std::string &topic) {
+  size_t f = 0;
+  size_t t = 0;
+  while (f < filter.size()) {
+    if (filter[f] == '#') {
+      return true;
+    }
+    if (filter[f] == '+') {
+      while (t < topic.size() && topic[t] != '/') {
+        t++;
+      }
+      f++;
+      continue;
+    }
+    if (t >= topic.size() || filter[f] != topic[t]) {
+      return false;
+    }
+    f++;
+    t++;
+  }
+  return t == topic.size();
+}
+
+void AsyncMqttClient::nativeLinkChanged() {
+  if (instance && instance->state == State::CONNECTED && !NativeSim::brokerReachable()) {
+    instance->pendingDisconnect = true;
+  }
+}
+
+void AsyncMqttClient::nativeDeliver(const char *topic, const char *payload, size_t length) {
+  std::string body(payload, length);
+  if (instance && instance->state == State::CONNECTED && instance->subscribed(topic)) {
+    instance->inbox.push_back(Message{topic, body, 0, false});
+  }
+}
+
+void AsyncMqttClient::nativeSetFragmentSize(size_t size) {
+  fragmentSize = size > 0 ? size : 1;
+}
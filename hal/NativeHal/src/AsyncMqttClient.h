@@ -0,0 +1,122 @@
+// Host stand-in for https://github.com/marvinroger/async-mqtt-client
+//
+// The client talks to an in-process broker: publishes are reported through
+// NativeSim::onPublish(), QoS 1/2 publishes are acknowledged and messages
+// on subscribed topics are delivered on the next NativeSim::pump().
+
+#ifndef NATIVE_HAL_ASYNCMQTTCLIENT_H
+#define NATIVE_HAL_ASYNCMQTTCLIENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class AsyncMqttClientDisconnectReason : int8_t {
+  TCP_DISCONNECTED = 0,
+
+  MQTT_UNACCEPTABLE_PROTOCOL_VERSION = 1,
+  MQTT_IDENTIFIER_REJECTED = 2,
+  MQTT_SERVER_UNAVAILABLE = 3,
+  MQTT_MALFORMED_CREDENTIALS = 4,
+  MQTT_NOT_AUTHORIZED = 5,
+
+  ESP8266_NOT_ENOUGH_SPACE = 6,
+
+  TLS_BAD_FINGERPRINT = 7
+};
+
+struct AsyncMqttClientMessageProperties {
+  uint8_t qos;
+  bool dup;
+  bool retain;
+};
+
+namespace AsyncMqttClientInternals {
+  typedef std::function<void(bool sessionPresent)> OnConnectUserCallback;
+  typedef std::function<void(AsyncMqttClientDisconnectReason reason)> OnDisconnectUserCallback;
+  typedef std::function<void(uint16_t packetId, uint8_t qos)> OnSubscribeUserCallback;
+  typedef std::function<void(char *topic, char *payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total)> OnMessageUserCallback;
+  typedef std::function<void(uint16_t packetId)> OnPublishUserCallback;
+}
+
+class AsyncMqttClient {
+  public:
+    AsyncMqttClient();
+    ~AsyncMqttClient();
+
+    AsyncMqttClient &setKeepAlive(uint16_t keepAlive);
+    AsyncMqttClient &setClientId(const char *clientId);
+    AsyncMqttClient &setCleanSession(bool cleanSession);
+    AsyncMqttClient &setMaxTopicLength(uint16_t maxTopicLength);
+    AsyncMqttClient &setCredentials(const char *username, const char *password = nullptr);
+    AsyncMqttClient &setWill(const char *topic, uint8_t qos, bool retain, const char *payload = nullptr, size_t length = 0);
+    AsyncMqttClient &setServer(const char *host, uint16_t port);
+#if ASYNC_TCP_SSL_ENABLED
+    AsyncMqttClient &setSecure(bool secure);
+    AsyncMqttClient &addServerFingerprint(const uint8_t *fingerprint);
+#endif
+
+    AsyncMqttClient &onConnect(AsyncMqttClientInternals::OnConnectUserCallback callback);
+    AsyncMqttClient &onDisconnect(AsyncMqttClientInternals::OnDisconnectUserCallback callback);
+    AsyncMqttClient &onSubscribe(AsyncMqttClientInternals::OnSubscribeUserCallback callback);
+    AsyncMqttClient &onMessage(AsyncMqttClientInternals::OnMessageUserCallback callback);
+    AsyncMqttClient &onPublish(AsyncMqttClientInternals::OnPublishUserCallback callback);
+
+    bool connected() const;
+    void connect();
+    void disconnect(bool force = false);
+    uint16_t subscribe(const char *topic, uint8_t qos);
+    uint16_t unsubscribe(const char *topic);
+    uint16_t publish(const char *topic, uint8_t qos, bool retain, const char *payload = nullptr, size_t length = 0, bool dup = false, uint16_t message_id = 0);
+
+    // Simulator side, see NativeSim
+    static void nativeLinkChanged();
+    static void nativeDeliver(const char *topic, const char *payload, size_t length);
+    // Payloads longer than this are handed to onMessage in several chunks
+    static void nativeSetFragmentSize(size_t size);
+
+  private:
+    enum class State { DISCONNECTED, CONNECTING, CONNECTED };
+
+    struct Message {
+      std::string topic;
+      std::string payload;
+      uint8_t qos;
+      bool retain;
+    };
+
+    void pump();
+    void dropConnection(AsyncMqttClientDisconnectReason reason);
+    // false while the TLS handshake is still running
+    bool handshake();
+    bool subscribed(const std::string &topic) const;
+    static bool topicMatches(const std::string &filter, const std::string &topic);
+
+    State state;
+    uint16_t nextPacketId;
+    std::string willTopic;
+    std::string willPayload;
+    bool willRetain;
+
+    std::vector<std::string> subscriptions;
+    std::vector<Message> inbox;
+    std::vector<uint16_t> pendingAcks;
+    bool pendingDisconnect;
+
+    bool secure;
+    std::vector<std::array<uint8_t, 20>> fingerprints;
+    bool handshaking;
+    unsigned long handshakeStart;
+    std::vector<uint8_t> tlsBuffers;   // held on the heap like axTLS does
+
+    AsyncMqttClientInternals::OnConnectUserCallback connectCallback;
+    AsyncMqttClientInternals::OnDisconnectUserCallback disconnectCallback;
+    AsyncMqttClientInternals::OnSubscribeUserCallback subscribeCallback;
+    AsyncMqttClientInternals::OnMessageUserCallback messageCallback;
+    AsyncMqttClientInternals::OnPublishUserCallback publishCallback;
+};
+
+#endif // NATIVE_HAL_ASYNCMQTTCLIENT_H
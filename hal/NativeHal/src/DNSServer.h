@@ -0,0 +1,13 @@
+#ifndef NATIVE_HAL_DNSSERVER_H
+#define NATIVE_HAL_DNSSERVER_H
+
+#include "Arduino.h"
+
+class DNSServer {
+  public:
+    bool start(uint16_t, const String &, const IPAddress &) { return true; }
+    void processNextRequest() {}
+    void stop() {}
+};
+
+#endif // NATIVE_HAL_DNSSERVER_H
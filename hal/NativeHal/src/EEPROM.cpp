@@ -0,0 +1,70 @@
+#include "EEPROM.h"
+
+EEPROMClass EEPROM;
+
+namespace {
+  const char *sectorFile() {
+    const char *path = getenv("NATIVE_EEPROM_FILE");
+    return path ? path : "native_eeprom.bin";
+  }
+}
+
+void EEPROMClass::begin(size_t _size) {
+  if (_size == 0 || _size > 4096) {
+    return;
+  }
+  // Like the ESP8266, an erased sector reads as 0xFF
+  delete[] data;
+  size = (_size + 3) & ~3;
+  data = new uint8_t[size];
+  memset(data, 0xFF, size);
+  FILE *fp = fopen(sectorFile(), "rb");
+  if (fp) {
+    size_t n = fread(data, 1, size, fp);
+    (void)n;
+    fclose(fp);
+  }
+  dirty = false;
+}
+
+uint8_t EEPROMClass::read(int address) {
+  if (address < 0 || (size_t)address >= size) {
+    return 0;
+  }
+  return data[address];
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+  if (address < 0 || (size_t)address >= size) {
+    return;
+  }
+  if (data[address] != value) {
+    data[address] = value;
+    dirty = true;
+  }
+}
+
+bool EEPROMClass::commit() {
+  if (!data) {
+    return false;
+  }
+  if (!dirty) {
+    return true;
+  }
+  FILE *fp = fopen(sectorFile(), "wb");
+  if (!fp) {
+    return false;
+  }
+  bool ok = fwrite(data, 1, size, fp) == size;
+  fclose(fp);
+  dirty = !ok;
+  return ok;
+}
+
+bool EEPROMClass::end() {
+  bool ok = commit();
+  delete[] data;
+  data = NULL;
+  size = 0;
+  return ok;
+}
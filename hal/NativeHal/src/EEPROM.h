@@ -0,0 +1,48 @@
+// Host stand-in for the ESP8266 EEPROM emulation. The sector is kept in the
+// file named by NATIVE_EEPROM_FILE (default: ./native_eeprom.bin).
+
+#ifndef NATIVE_HAL_EEPROM_H
+#define NATIVE_HAL_EEPROM_H
+
+#include "Arduino.h"
+
+class EEPROMClass {
+  public:
+    EEPROMClass() : data(NULL), size(0), dirty(false) {}
+
+    void begin(size_t size);
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    bool commit();
+    bool end();
+
+    uint8_t *getDataPtr() { dirty = true; return data; }
+    const uint8_t *getConstDataPtr() const { return data; }
+    size_t length() const { return size; }
+
+    template<typename T>
+    T &get(int address, T &t) {
+      if (address >= 0 && address + sizeof(T) <= size) {
+        memcpy((uint8_t *)&t, data + address, sizeof(T));
+      }
+      return t;
+    }
+
+    template<typename T>
+    const T &put(int address, const T &t) {
+      if (address >= 0 && address + sizeof(T) <= size) {
+        memcpy(data + address, (const uint8_t *)&t, sizeof(T));
+        dirty = true;
+      }
+      return t;
+    }
+
+  private:
+    uint8_t *data;
+    size_t size;
+    bool dirty;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // NATIVE_HAL_EEPROM_H
@@ -0,0 +1,99 @@
+#include "ESP8266WebServer.h"
+
+void ESP8266WebServer::on(const String &uri, HTTPMethod method, THandlerFunction handler) {
+  Route route = { std::string(uri.c_str()), method, handler };
+  routes.push_back(route);
+}
+
+void ESP8266WebServer::handleClient() {
+  if (_currentStatus == HC_NONE) {
+    WiFiClient client = _server.available();
+    if (!client) {
+      return;
+    }
+    _currentClient = client;
+    _currentStatus = HC_WAIT_READ;
+    _statusChange = millis();
+  }
+  contentLength = CONTENT_LENGTH_NOT_SET;
+  response = NativeSim::HttpResponse();
+  finished = false;
+
+  if (!_currentClient.readRequest(currentPath)) {
+    response.dropped = true;
+    close();
+    return;
+  }
+  _currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
+
+  THandlerFunction handler = notFound;
+  for (const Route &route : routes) {
+    if (route.uri == currentPath && (route.method == HTTP_ANY || route.method == HTTP_GET)) {
+      handler = route.handler;
+      break;
+    }
+  }
+  if (handler) {
+    handler();
+  }
+  if (response.code == 0) {
+    send(404, "text/plain", "Not found");
+  }
+  // the connection is closed once the handler returns, unless the handler
+  // closed it already
+  if (!_currentClient.connected()) {
+    response.dropped = true;
+  }
+  response.complete = (!response.chunked || finished) && !response.dropped;
+  close();
+}
+
+void ESP8266WebServer::close() {
+  _currentClient.stop();
+  _currentClient = WiFiClient();
+  _currentStatus = HC_NONE;
+  NativeSim::notifyHttpResponse(currentPath.c_str(), response);
+}
+
+void ESP8266WebServer::sendBytes(const char *data, size_t size) {
+  if (!response.dropped && _currentClient.write(data, size) != size) {
+    response.dropped = true;
+  }
+}
+
+void ESP8266WebServer::send(int code, const char *contentType, const String &content) {
+  response.code = code;
+  response.type = contentType != NULL ? contentType : "text/html";
+  response.chunked = contentLength == CONTENT_LENGTH_UNKNOWN;
+  char header[160];
+  int length = snprintf(header, sizeof(header), "HTTP/1.1 %d\r\nContent-Type: %s\r\n%s\r\n\r\n", code,
+                        response.type.c_str(), response.chunked ? "Transfer-Encoding: chunked" : "Connection: close");
+  sendBytes(header, length);
+  sendBytes(content.c_str(), content.length());
+  if (!response.dropped) {
+    response.body.assign(content.c_str(), content.length());
+  }
+}
+
+void ESP8266WebServer::sendContent(const char *content, size_t size) {
+  if (finished || response.dropped) {
+    return;
+  }
+  if (response.chunked) {
+    // <size>\r\n<data>\r\n
+    char frame[12];
+    sendBytes(frame, snprintf(frame, sizeof(frame), "%zx\r\n", size));
+    sendBytes(content, size);
+    sendBytes("\r\n", 2);
+    if (size == 0) {
+      finished = !response.dropped;
+      return;
+    }
+  } else {
+    sendBytes(content, size);
+  }
+  if (!response.dropped) {
+    response.body.append(content, size);
+    response.chunks++;
+  }
+}
@@ -0,0 +1,79 @@
+// Host stand-in for the synchronous ESP8266WebServer. Requests come from
+// NativeSim::httpGet() and are served by handleClient(), one per call; the
+// response goes to NativeSim::notifyHttpResponse() once the handler returns.
+// With setContentLength(CONTENT_LENGTH_UNKNOWN) the body is sent in chunks,
+// each sendContent() is one chunk and an empty one ends the response.
+// Like the library, the client is accepted into _currentClient and its
+// request read with blocking reads under the client's timeout; the handler
+// runs with HTTP_MAX_SEND_WAIT as the timeout of its writes.
+
+#ifndef NATIVE_HAL_ESP8266WEBSERVER_H
+#define NATIVE_HAL_ESP8266WEBSERVER_H
+
+#include "Arduino.h"
+#include "ESP8266WiFi.h"
+#include "NativeSim.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
+#define CONTENT_LENGTH_NOT_SET ((size_t) -2)
+
+#define HTTP_MAX_SEND_WAIT 5000   // ms to wait for data chunk to be ACKed
+
+enum HTTPClientStatus { HC_NONE, HC_WAIT_READ, HC_WAIT_CLOSE };
+
+class ESP8266WebServer {
+  public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    explicit ESP8266WebServer(int port = 80) : _server(port) {}
+    void begin() { _server.begin(); }
+    void stop() { _server.close(); }
+    void handleClient();
+
+    void on(const String &uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+    void on(const String &uri, HTTPMethod method, THandlerFunction handler);
+    void onNotFound(THandlerFunction handler) { notFound = handler; }
+
+    String uri() const { return String(currentPath); }
+    HTTPMethod method() const { return HTTP_GET; }
+
+    void setContentLength(size_t length) { contentLength = length; }
+    void send(int code, const char *contentType = NULL, const String &content = String());
+    void sendContent(const char *content, size_t size);
+    void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+
+    WiFiClient &client() { return _currentClient; }
+
+  protected:
+    WiFiServer _server;
+    WiFiClient _currentClient;
+    HTTPClientStatus _currentStatus = HC_NONE;
+    unsigned long _statusChange = 0;
+
+  private:
+    struct Route {
+      std::string uri;
+      HTTPMethod method;
+      THandlerFunction handler;
+    };
+
+    void sendBytes(const char *data, size_t size);
+    void close();
+
+    std::vector<Route> routes;
+    THandlerFunction notFound;
+
+    // the request being served
+    std::string currentPath;
+    size_t contentLength = CONTENT_LENGTH_NOT_SET;
+    NativeSim::HttpResponse response;
+    bool finished = false;
+};
+
+#endif // NATIVE_HAL_ESP8266WEBSERVER_H
@@ -0,0 +1,223 @@
+#include "ESP8266WiFi.h"
+#include "NativeSim.h"
+
+ESP8266WiFiClass WiFi;
+
+namespace {
+  uint8_t simMac[6] = { 0x5C, 0xCF, 0x7F, 0xC0, 0xFF, 0xEE };
+  const int32_t simChannel = 6;
+  bool pumpHooked = false;
+
+  template<typename Event>
+  struct EventHandler : public WiFiEventHandlerOpaque {
+    explicit EventHandler(std::function<void(const Event &)> f) : callback(f) {}
+    std::function<void(const Event &)> callback;
+  };
+
+  template<typename Event>
+  void fire(std::vector<std::weak_ptr<WiFiEventHandlerOpaque>> &handlers, const Event &event) {
+    for (auto &weak : handlers) {
+      std::shared_ptr<WiFiEventHandlerOpaque> handler = weak.lock();
+      if (handler) {
+        static_cast<EventHandler<Event> *>(handler.get())->callback(event);
+      }
+    }
+  }
+}
+
+wl_status_t ESP8266WiFiClass::begin(const char *ssid, const char *passphrase, int32_t channel, const uint8_t *bssid, bool connect) {
+  station_config config = {};
+  strncpy((char *)config.ssid, ssid != NULL ? ssid : "", sizeof(config.ssid));
+  strncpy((char *)config.password, passphrase != NULL ? passphrase : "", sizeof(config.password));
+  // Joins only this access point from now on, until the config is replaced
+  config.bssid_set = bssid != NULL;
+  if (bssid != NULL) {
+    memcpy(config.bssid, bssid, sizeof(config.bssid));
+  }
+  nativeSetConfig(config, persistentConfig);
+  if (connect) {
+    startConnecting(bssid == NULL || channel == 0);
+  }
+  return status();
+}
+
+wl_status_t ESP8266WiFiClass::begin() {
+  // Joins with the config in RAM, there is nothing to join without an SSID
+  if (ramConfig.ssid[0] == 0) {
+    station = STA_IDLE;
+    return status();
+  }
+  startConnecting(true);
+  return status();
+}
+
+void ESP8266WiFiClass::startConnecting(bool scan) {
+  uint64_t now = NativeSim::nowMicros();
+  station = STA_CONNECTING;
+  associatedAt = now + (uint64_t)((scan ? NativeSim::wifiTiming().scan : 0) + NativeSim::wifiTiming().associate) * 1000;
+  gotIpAt = associatedAt + (staticIp ? 0 : (uint64_t)NativeSim::wifiTiming().dhcp * 1000);
+  if (!pumpHooked) {
+    pumpHooked = true;
+    NativeSim::addPumpHandler([]() { WiFi.nativePump(); });
+  }
+}
+
+void ESP8266WiFiClass::nativeSetConfig(const station_config &config, bool save) {
+  ramConfig = config;
+  if (save) {
+    flashConfig = config;
+  }
+}
+
+bool ESP8266WiFiClass::accessPointReachable() const {
+  // A locked BSSID that is not around is never found, like an access point
+  // that was replaced
+  return !ramConfig.bssid_set || memcmp(ramConfig.bssid, NativeSim::accessPointBssid(), sizeof(ramConfig.bssid)) == 0;
+}
+
+void ESP8266WiFiClass::nativePump() {
+  if (station == STA_IDLE) {
+    return;
+  }
+  bool replaced = station != STA_CONNECTING && memcmp(joinedBssid, NativeSim::accessPointBssid(), sizeof(joinedBssid)) != 0;
+  if (!NativeSim::wifiConnected() || replaced) {
+    if (station != STA_CONNECTING) {
+      // lost the access point, the SDK keeps trying the same one
+      startConnecting(false);
+    }
+    return;
+  }
+  uint64_t now = NativeSim::nowMicros();
+  if (station == STA_CONNECTING && accessPointReachable() && now >= associatedAt) {
+    station = STA_ASSOCIATED;
+    memcpy(joinedBssid, NativeSim::accessPointBssid(), sizeof(joinedBssid));
+    WiFiEventStationModeConnected event;
+    event.ssid = SSID();
+    memcpy(event.bssid, joinedBssid, sizeof(joinedBssid));
+    event.channel = simChannel;
+    fire(connectedHandlers, event);
+  }
+  if (station == STA_ASSOCIATED && now >= gotIpAt) {
+    station = STA_GOT_IP;
+    WiFiEventStationModeGotIP event;
+    event.ip = localIP();
+    event.mask = subnetMask();
+    event.gw = gatewayIP();
+    fire(gotIpHandlers, event);
+  }
+}
+
+WiFiEventHandler ESP8266WiFiClass::onStationModeConnected(std::function<void(const WiFiEventStationModeConnected &)> f) {
+  WiFiEventHandler handler = std::make_shared<EventHandler<WiFiEventStationModeConnected>>(f);
+  connectedHandlers.push_back(handler);
+  return handler;
+}
+
+WiFiEventHandler ESP8266WiFiClass::onStationModeGotIP(std::function<void(const WiFiEventStationModeGotIP &)> f) {
+  WiFiEventHandler handler = std::make_shared<EventHandler<WiFiEventStationModeGotIP>>(f);
+  gotIpHandlers.push_back(handler);
+  return handler;
+}
+
+bool ESP8266WiFiClass::config(IPAddress local_ip, IPAddress, IPAddress, IPAddress, IPAddress) {
+  staticIp = (uint32_t)local_ip != 0;
+  return true;
+}
+
+bool ESP8266WiFiClass::reconnect() {
+  startConnecting(false);
+  return true;
+}
+
+bool ESP8266WiFiClass::disconnect(bool) {
+  // The core sets an empty station config, the SSID and PSK are gone
+  station = STA_IDLE;
+  station_config config = {};
+  nativeSetConfig(config, persistentConfig);
+  return true;
+}
+
+wl_status_t ESP8266WiFiClass::status() {
+  return station == STA_GOT_IP && NativeSim::wifiConnected() ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+bool ESP8266WiFiClass::isConnected() {
+  return status() == WL_CONNECTED;
+}
+
+IPAddress ESP8266WiFiClass::localIP() {
+  return isConnected() ? IPAddress(192, 168, 1, 102) : IPAddress();
+}
+
+IPAddress ESP8266WiFiClass::gatewayIP() {
+  return IPAddress(192, 168, 1, 1);
+}
+
+IPAddress ESP8266WiFiClass::subnetMask() {
+  return IPAddress(255, 255, 255, 0);
+}
+
+uint8_t *ESP8266WiFiClass::macAddress(uint8_t *mac) {
+  memcpy(mac, simMac, sizeof(simMac));
+  return mac;
+}
+
+String ESP8266WiFiClass::macAddress() {
+  char buf[18];
+  snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X",
+           simMac[0], simMac[1], simMac[2], simMac[3], simMac[4], simMac[5]);
+  return String(buf);
+}
+
+int32_t ESP8266WiFiClass::RSSI() {
+  return isConnected() ? -57 - (int32_t)random(4) : 31;
+}
+
+IPAddress ESP8266WiFiClass::dnsIP(uint8_t) {
+  return IPAddress(192, 168, 1, 1);
+}
+
+String ESP8266WiFiClass::SSID() const {
+  char ssid[sizeof(ramConfig.ssid) + 1] = {};
+  memcpy(ssid, ramConfig.ssid, sizeof(ramConfig.ssid));
+  return String(ssid);
+}
+
+String ESP8266WiFiClass::psk() const {
+  char passphrase[sizeof(ramConfig.password) + 1] = {};
+  memcpy(passphrase, ramConfig.password, sizeof(ramConfig.password));
+  return String(passphrase);
+}
+
+uint8_t *ESP8266WiFiClass::BSSID() {
+  return joinedBssid;
+}
+
+int32_t ESP8266WiFiClass::channel() {
+  return simChannel;
+}
+
+bool wifi_station_disconnect() {
+  WiFi.nativeStationDisconnect();
+  return true;
+}
+
+bool wifi_station_get_config(struct station_config *config) {
+  WiFi.nativeGetConfig(config, false);
+  return true;
+}
+
+bool wifi_station_get_config_default(struct station_config *config) {
+  WiFi.nativeGetConfig(config, true);
+  return true;
+}
+
+bool wifi_station_set_config(struct station_config *config) {
+  WiFi.nativeSetConfig(*config, true);
+  return true;
+}
+
+bool wifi_station_set_config_current(struct station_config *config) {
+  WiFi.nativeSetConfig(*config, false);
+  return true;
+}
@@ -0,0 +1,133 @@
+// Host stand-in for the ESP8266 WiFi stack. The link state follows
+// NativeSim::setWiFiConnected(), association and DHCP take the time set by
+// NativeSim::setWiFiTiming(). Only the simulated access point's BSSID
+// (NativeSim::setAccessPoint(), channel 6) can be joined. The station
+// config is kept like the SDK does, in RAM and, unless persistent(false),
+// in flash: WiFi.disconnect() clears the SSID and PSK, begin() without
+// arguments joins with what is in RAM, BSSID lock included, and so does
+// the reconnect after a drop. wifi_station_disconnect() leaves it alone.
+// Flash lasts for the run, the config in RAM is loaded from it at boot.
+
+#ifndef NATIVE_HAL_ESP8266WIFI_H
+#define NATIVE_HAL_ESP8266WIFI_H
+
+#include "Arduino.h"
+
+#include <memory>
+#include <vector>
+
+typedef enum {
+  WL_NO_SHIELD = 255,
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum { WIFI_NONE_SLEEP = 0, WIFI_LIGHT_SLEEP = 1, WIFI_MODEM_SLEEP = 2 } WiFiSleepType_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } WiFiMode_t;
+
+// From user_interface.h of the SDK, the fields used here
+struct station_config {
+  uint8_t ssid[32];
+  uint8_t password[64];
+  uint8_t bssid_set;    // join only the access point with this BSSID
+  uint8_t bssid[6];
+};
+
+struct WiFiEventStationModeConnected {
+  String ssid;
+  uint8_t bssid[6];
+  uint8_t channel;
+};
+
+struct WiFiEventStationModeGotIP {
+  IPAddress ip;
+  IPAddress mask;
+  IPAddress gw;
+};
+
+// The handler stays registered as long as the returned object is alive
+struct WiFiEventHandlerOpaque {
+  virtual ~WiFiEventHandlerOpaque() {}
+};
+typedef std::shared_ptr<WiFiEventHandlerOpaque> WiFiEventHandler;
+
+class ESP8266WiFiClass {
+  public:
+    wl_status_t begin(const char *ssid, const char *passphrase = NULL, int32_t channel = 0, const uint8_t *bssid = NULL, bool connect = true);
+    wl_status_t begin();
+    bool config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress());
+    bool reconnect();
+    bool disconnect(bool wifioff = false);
+    bool mode(WiFiMode_t m) { currentMode = m; return true; }
+    WiFiMode_t getMode() const { return currentMode; }
+    bool setAutoReconnect(bool) { return true; }
+    bool setSleepMode(WiFiSleepType_t type, uint8_t listenInterval = 0) { (void)listenInterval; sleepMode = type; return true; }
+    WiFiSleepType_t getSleepMode() const { return sleepMode; }
+    void persistent(bool persistent) { persistentConfig = persistent; }
+
+    WiFiEventHandler onStationModeConnected(std::function<void(const WiFiEventStationModeConnected &)> f);
+    WiFiEventHandler onStationModeGotIP(std::function<void(const WiFiEventStationModeGotIP &)> f);
+
+    wl_status_t status();
+    bool isConnected();
+
+    IPAddress localIP();
+    IPAddress gatewayIP();
+    IPAddress subnetMask();
+    uint8_t *macAddress(uint8_t *mac);
+    String macAddress();
+    int32_t RSSI();
+    IPAddress dnsIP(uint8_t dns_no = 0);
+    String SSID() const;
+    String psk() const;
+    uint8_t *BSSID();
+    int32_t channel();
+
+    // simulator side
+    void nativePump();
+    void nativeStationDisconnect() { station = STA_IDLE; }
+    void nativeGetConfig(station_config *config, bool saved) const { *config = saved ? flashConfig : ramConfig; }
+    void nativeSetConfig(const station_config &config, bool save);
+
+  private:
+    enum StationState { STA_IDLE, STA_CONNECTING, STA_ASSOCIATED, STA_GOT_IP };
+
+    void startConnecting(bool scan);
+    bool accessPointReachable() const;
+
+    StationState station = STA_IDLE;
+    bool staticIp = false;
+    uint8_t joinedBssid[6] = {};
+    uint64_t associatedAt = 0;
+    uint64_t gotIpAt = 0;
+    std::vector<std::weak_ptr<WiFiEventHandlerOpaque>> connectedHandlers;
+    std::vector<std::weak_ptr<WiFiEventHandlerOpaque>> gotIpHandlers;
+
+    // The station config of the SDK
+    station_config flashConfig = { "native", "password", 0, {} };
+    station_config ramConfig = flashConfig;
+    bool persistentConfig = true;
+
+    WiFiMode_t currentMode = WIFI_STA;
+    WiFiSleepType_t sleepMode = WIFI_MODEM_SLEEP;
+};
+
+extern ESP8266WiFiClass WiFi;
+
+// From user_interface.h of the SDK
+bool wifi_station_disconnect();
+bool wifi_station_get_config(struct station_config *config);
+bool wifi_station_get_config_default(struct station_config *config);
+bool wifi_station_set_config(struct station_config *config);
+bool wifi_station_set_config_current(struct station_config *config);
+
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+
+#endif // NATIVE_HAL_ESP8266WIFI_H
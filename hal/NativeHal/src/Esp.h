@@ -0,0 +1,19 @@
+#ifndef NATIVE_HAL_ESP_H
+#define NATIVE_HAL_ESP_H
+
+#include <stdint.h>
+
+class EspClass {
+  public:
+    // Leaves the process with exit code 3 so scripts can tell a reboot apart
+    void restart();
+    uint32_t getChipId();
+    uint32_t getFreeHeap();
+    uint32_t getMaxFreeBlockSize();
+    uint8_t getHeapFragmentation();
+    uint32_t getCycleCount();
+};
+
+extern EspClass ESP;
+
+#endif // NATIVE_HAL_ESP_H
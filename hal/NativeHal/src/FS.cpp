@@ -0,0 +1,80 @@
+#include "FS.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+FS SPIFFS;
+
+size_t File::write(uint8_t c) {
+  return fp && fputc(c, fp) != EOF ? 1 : 0;
+}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  return fp ? fwrite(buffer, 1, size, fp) : 0;
+}
+
+int File::available() {
+  if (!fp) {
+    return 0;
+  }
+  long pos = ftell(fp);
+  return (int)(size() - pos);
+}
+
+int File::read() {
+  return fp ? fgetc(fp) : -1;
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+  return fp ? fread(buffer, 1, size, fp) : 0;
+}
+
+bool File::seek(uint32_t pos) {
+  return fp && fseek(fp, pos, SEEK_SET) == 0;
+}
+
+size_t File::size() const {
+  if (!fp) {
+    return 0;
+  }
+  struct stat st;
+  fflush(fp);
+  return fstat(fileno(fp), &st) == 0 ? st.st_size : 0;
+}
+
+void File::close() {
+  if (fp) {
+    fclose(fp);
+    fp = NULL;
+  }
+}
+
+bool FS::begin() {
+  const char *dir = getenv("NATIVE_SPIFFS_DIR");
+  root = dir ? dir : "native_spiffs";
+  mkdir(root.c_str(), 0755);
+  struct stat st;
+  return stat(root.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool FS::format() {
+  return true;
+}
+
+String FS::hostPath(const char *path) const {
+  return root + String(path);
+}
+
+bool FS::exists(const char *path) {
+  return access(hostPath(path).c_str(), F_OK) == 0;
+}
+
+bool FS::remove(const char *path) {
+  return unlink(hostPath(path).c_str()) == 0;
+}
+
+File FS::open(const char *path, const char *mode) {
+  String fopenMode(mode);
+  fopenMode += "b";
+  return File(fopen(hostPath(path).c_str(), fopenMode.c_str()));
+}
@@ -0,0 +1,48 @@
+// Host stand-in for the SPIFFS file system. Files live in the directory
+// named by NATIVE_SPIFFS_DIR (default: ./native_spiffs).
+
+#ifndef NATIVE_HAL_FS_H
+#define NATIVE_HAL_FS_H
+
+#include "Arduino.h"
+
+class File : public Print {
+  public:
+    File() : fp(NULL) {}
+    explicit File(FILE *f) : fp(f) {}
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+
+    int available();
+    int read();
+    size_t read(uint8_t *buffer, size_t size);
+    size_t readBytes(char *buffer, size_t length) { return read((uint8_t *)buffer, length); }
+    bool seek(uint32_t pos);
+    size_t size() const;
+    void close();
+
+    operator bool() const { return fp != NULL; }
+
+  private:
+    FILE *fp;
+};
+
+class FS {
+  public:
+    bool begin();
+    void end() {}
+    bool format();
+    bool exists(const char *path);
+    bool remove(const char *path);
+    File open(const char *path, const char *mode);
+
+  private:
+    String hostPath(const char *path) const;
+    String root;
+};
+
+extern FS SPIFFS;
+
+#endif // NATIVE_HAL_FS_H
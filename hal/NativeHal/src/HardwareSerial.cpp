@@ -0,0 +1,52 @@
+#include "Arduino.h"
+#include "NativeSim.h"
+
+namespace {
+  const uint64_t FIFO_SIZE = 128;
+}
+
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long baud) {
+  charMicros = baud > 0 ? (10000000UL + baud - 1) / baud : 87;
+  const char *env = getenv("NATIVE_SERIAL");
+  muted = (env != NULL) && (strcmp(env, "0") == 0);
+}
+
+int HardwareSerial::availableForWrite() {
+  uint64_t now = NativeSim::nowMicros();
+  uint64_t queued = busyUntil > now ? (busyUntil - now + charMicros - 1) / charMicros : 0;
+  return queued < FIFO_SIZE ? (int)(FIFO_SIZE - queued) : 0;
+}
+
+/* Queue count characters, waiting for room like the hardware does */
+void HardwareSerial::transmit(size_t count) {
+  while (count > 0) {
+    int room = availableForWrite();
+    if (room == 0) {
+      NativeSim::advanceMicros(charMicros);
+      NativeSim::serviceInterrupts();
+      continue;
+    }
+    size_t chunk = count < (size_t)room ? count : room;
+    uint64_t now = NativeSim::nowMicros();
+    busyUntil = (busyUntil > now ? busyUntil : now) + chunk * charMicros;
+    count -= chunk;
+  }
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  transmit(1);
+  if (!muted) {
+    fputc(c, stderr);
+  }
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  transmit(size);
+  if (!muted) {
+    fwrite(buffer, 1, size, stderr);
+  }
+  return size;
+}
@@ -0,0 +1,34 @@
+#ifndef NATIVE_HAL_HARDWARESERIAL_H
+#define NATIVE_HAL_HARDWARESERIAL_H
+
+#include "Print.h"
+
+// The UART is mapped to stderr, stdout is reserved for the simulator output.
+// Set NATIVE_SERIAL=0 in the environment to mute it while profiling.
+// The timing is the one of the hardware, muted or not: the 128 byte TX FIFO
+// drains at the baud rate and a write to a full FIFO waits in virtual time.
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud);
+    void end() {}
+    int available() { return 0; }
+    int read() { return -1; }
+    int availableForWrite();
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+
+    operator bool() const { return true; }
+
+  private:
+    void transmit(size_t count);
+
+    bool muted = false;
+    uint32_t charMicros = 87;   // 10 bits at 115200 baud
+    uint64_t busyUntil = 0;
+};
+
+extern HardwareSerial Serial;
+
+#endif // NATIVE_HAL_HARDWARESERIAL_H
@@ -0,0 +1,32 @@
+#ifndef NATIVE_HAL_IPADDRESS_H
+#define NATIVE_HAL_IPADDRESS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "WString.h"
+
+class IPAddress {
+  public:
+    IPAddress() : addr{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr{a, b, c, d} {}
+    explicit IPAddress(uint32_t v) : addr{(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)} {}
+
+    operator uint32_t() const {
+      return addr[0] | (addr[1] << 8) | (addr[2] << 16) | ((uint32_t)addr[3] << 24);
+    }
+    uint8_t operator[](int i) const { return addr[i]; }
+    uint8_t &operator[](int i) { return addr[i]; }
+    bool isSet() const { return (uint32_t)*this != 0; }
+
+    String toString() const {
+      char buf[16];
+      snprintf(buf, sizeof(buf), "%u.%u.%u.%u", addr[0], addr[1], addr[2], addr[3]);
+      return String(buf);
+    }
+
+  private:
+    uint8_t addr[4];
+};
+
+#endif // NATIVE_HAL_IPADDRESS_H
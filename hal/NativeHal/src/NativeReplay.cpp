@@ -0,0 +1,372 @@
+#include "NativeReplay.h"
+#include "NativeSim.h"
+#include "AsyncMqttClient.h"
+#include "Arduino.h"
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+  // Record types of include/EventTrace.h
+  enum Type {
+    KEY = 1,
+    MESSAGE,
+    MESSAGE_DATA,
+    CONNECT,
+    DISCONNECT,
+    CODE,
+    LEDS,
+    TYPE_COUNT
+  };
+
+  const char *typeNames[TYPE_COUNT] = { "", "key", "message", "", "connect", "disconnect", "", "" };
+
+  struct Event {
+    uint8_t type;
+    unsigned long time;
+    std::string topic;
+    std::string payload;   // message (all chunks), code digits or key
+    uint32_t checksum;
+  };
+
+  class Reader {
+    public:
+      explicit Reader(const std::vector<uint8_t> &_data) : data(_data), position(0), failed(false) {}
+
+      bool atEnd() const { return position >= data.size(); }
+      bool ok() const { return !failed; }
+
+      uint8_t byte() {
+        if (position >= data.size()) {
+          failed = true;
+          return 0;
+        }
+        return data[position++];
+      }
+
+      uint32_t varint() {
+        uint32_t value = 0;
+        for (uint8_t shift = 0; shift < 35; shift += 7) {
+          uint8_t b = byte();
+          value |= (uint32_t)(b & 0x7F) << shift;
+          if ((b & 0x80) == 0) {
+            break;
+          }
+        }
+        return value;
+      }
+
+      std::string bytes(size_t count) {
+        if (count > data.size() - position) {
+          failed = true;
+          count = data.size() - position;
+        }
+        std::string value(data.begin() + position, data.begin() + position + count);
+        position += count;
+        return value;
+      }
+
+    private:
+      const std::vector<uint8_t> &data;
+      size_t position;
+      bool failed;
+  };
+
+  bool load(const char *path, std::vector<Event> &events, unsigned long &ledHold, uint32_t &seed) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < 13 || memcmp(data.data(), "KPT", 3) != 0 || data[3] != 1) {
+      fprintf(stderr, "replay: %s is not an event trace\n", path);
+      return false;
+    }
+
+    Reader reader(data);
+    reader.bytes(4);
+    unsigned long time = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+      time |= (unsigned long)reader.byte() << (8 * i);
+    }
+    ledHold = reader.byte();
+    seed = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+      seed |= (uint32_t)reader.byte() << (8 * i);
+    }
+
+    Event *message = nullptr;
+    while (!reader.atEnd() && reader.ok()) {
+      Event event = Event();
+      event.type = reader.byte();
+      time += reader.varint();
+      event.time = time;
+      switch (event.type) {
+        case KEY:
+          event.payload = reader.bytes(1);
+          break;
+        case MESSAGE:
+          event.topic = reader.bytes(reader.varint());
+          reader.varint();   // total, the chunks tell
+          event.payload = reader.bytes(reader.varint());
+          break;
+        case MESSAGE_DATA:
+          if (message != nullptr) {
+            message->payload += reader.bytes(reader.varint());
+          } else {
+            reader.bytes(reader.varint());
+          }
+          continue;
+        case CONNECT:
+          break;
+        case DISCONNECT:
+          reader.byte();
+          break;
+        case CODE:
+          event.payload = reader.bytes(reader.varint());
+          break;
+        case LEDS:
+          for (uint8_t i = 0; i < 4; i++) {
+            event.checksum |= (uint32_t)reader.byte() << (8 * i);
+          }
+          break;
+        default:
+          fprintf(stderr, "replay: unknown record type %u\n", event.type);
+          return false;
+      }
+      if (!reader.ok()) {
+        fprintf(stderr, "replay: %s is truncated, replaying what is complete\n", path);
+        break;
+      }
+      events.push_back(event);
+      message = event.type == MESSAGE ? &events.back() : nullptr;
+    }
+    return true;
+  }
+
+  // EventTrace::frameChecksum() over the frame on the simulated strip
+  uint32_t frameChecksum(uint16_t leds) {
+    uint32_t hash = 2166136261u;
+    for (uint16_t i = 0; i < leds; i++) {
+      uint32_t color = NativeSim::ledColor(i);
+      for (int shift = 16; shift >= 0; shift -= 8) {
+        hash ^= (uint8_t)(color >> shift);
+        hash *= 16777619u;
+      }
+    }
+    return hash;
+  }
+
+  // The digits of a code payload, also in the traced form {"code":"1234",...}
+  std::string codeDigits(const char *payload, size_t length) {
+    std::string code(payload, length);
+    size_t field = code.find("\"code\":\"");
+    if (field == std::string::npos) {
+      return code;
+    }
+    size_t start = field + 8;
+    return code.substr(start, code.find('"', start) - start);
+  }
+
+  struct Output {
+    unsigned long time;
+    std::string code;
+    uint32_t checksum;
+  };
+
+  struct Costs {
+    std::vector<uint32_t> samples[TYPE_COUNT];
+
+    void report(uint8_t type) {
+      std::vector<uint32_t> &s = samples[type];
+      if (s.empty()) {
+        return;
+      }
+      std::sort(s.begin(), s.end());
+      fprintf(stderr, "replay cost %s: n=%u p50=%uus p99=%uus max=%uus\n", typeNames[type], (unsigned int)s.size(),
+              s[(s.size() - 1) * 50 / 100], s[(s.size() - 1) * 99 / 100], s.back());
+    }
+  };
+
+  // The simulator hooks cannot be removed, they follow the running replay
+  std::vector<Output> *publishedCodes = nullptr;
+  bool hooked = false;
+
+  void hook() {
+    if (hooked) {
+      return;
+    }
+    hooked = true;
+    NativeSim::onPublish([](const char *topic, const char *payload, size_t length, uint8_t, bool) {
+      size_t topicLength = strlen(topic);
+      if (publishedCodes && topicLength >= 5 && strcmp(topic + topicLength - 5, "/code") == 0) {
+        publishedCodes->push_back(Output{ millis(), codeDigits(payload, length), 0 });
+      }
+    });
+  }
+
+  int compareCodes(const std::vector<Output> &expected, const std::vector<Output> &seen, long &maxDrift) {
+    int mismatches = 0;
+    for (size_t i = 0; i < std::max(expected.size(), seen.size()); i++) {
+      if (i < expected.size() && i < seen.size() && expected[i].code == seen[i].code) {
+        maxDrift = std::max(maxDrift, std::abs((long)(seen[i].time - expected[i].time)));
+        continue;
+      }
+      if (mismatches++ < 5) {
+        fprintf(stderr, "replay: code %u: expected %s at %lu ms, got %s\n", (unsigned int)i,
+                i < expected.size() ? expected[i].code.c_str() : "nothing", i < expected.size() ? expected[i].time : 0,
+                i < seen.size() ? seen[i].code.c_str() : "nothing");
+      }
+    }
+    return mismatches;
+  }
+
+  // Every recorded frame has to show up, in order, within the tolerance.
+  // Extra frames in between do not count.
+  int compareFrames(const std::vector<Output> &expected, const std::vector<Output> &seen, unsigned long tolerance) {
+    int mismatches = 0;
+    size_t next = 0;
+    for (const Output &frame : expected) {
+      size_t i = next;
+      while (i < seen.size() && seen[i].time <= frame.time + tolerance
+             && (seen[i].checksum != frame.checksum || seen[i].time + tolerance < frame.time)) {
+        i++;
+      }
+      if (i < seen.size() && seen[i].time <= frame.time + tolerance) {
+        next = i + 1;
+      } else if (mismatches++ < 5) {
+        fprintf(stderr, "replay: LED frame %08x at %lu ms not shown\n", frame.checksum, frame.time);
+      }
+    }
+    return mismatches;
+  }
+
+}
+
+namespace NativeReplay {
+
+  bool run(const Options &options, std::function<void()> runLoop) {
+    std::vector<Event> events;
+    unsigned long ledHold = 0;
+    uint32_t seed = 0;
+    if (!load(options.path, events, ledHold, seed)) {
+      return false;
+    }
+    // The reconnect delays of the recording
+    randomSeed(seed);
+
+    std::vector<Output> expectedCodes;
+    std::vector<Output> expectedFrames;
+    for (const Event &event : events) {
+      if (event.type == CODE) {
+        expectedCodes.push_back(Output{ event.time, event.payload, 0 });
+      } else if (event.type == LEDS) {
+        expectedFrames.push_back(Output{ event.time, "", event.checksum });
+      }
+    }
+
+    std::vector<Output> seenCodes;
+    std::vector<Output> seenFrames;
+    hook();
+    publishedCodes = &seenCodes;
+
+    Costs costs;
+    uint8_t chargedType = 0;
+    unsigned long chargedUntil = 0;
+    uint32_t charged = 0;
+    unsigned long start = millis();
+    auto wallStart = std::chrono::steady_clock::now();
+    // The same rule as the recorder: frames held for ledHold ms, when replaced
+    uint32_t lastChecksum = frameChecksum(options.leds);
+    unsigned long lastSince = start;
+
+    auto step = [&]() {
+      auto loopStart = std::chrono::steady_clock::now();
+      runLoop();
+      uint32_t micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - loopStart).count();
+      if (chargedType != 0) {
+        charged += micros;
+      }
+      uint32_t checksum = frameChecksum(options.leds);
+      if (checksum != lastChecksum) {
+        if (millis() - lastSince >= ledHold) {
+          seenFrames.push_back(Output{ millis(), "", lastChecksum });
+        }
+        lastChecksum = checksum;
+        lastSince = millis();
+      }
+    };
+
+    auto closeCharge = [&]() {
+      if (chargedType != 0) {
+        costs.samples[chargedType].push_back(charged);
+        chargedType = 0;
+      }
+    };
+
+    auto runUntil = [&](unsigned long time) {
+      while ((long)(time - millis()) > 0) {
+        NativeSim::advance(1);
+        step();
+        if (chargedType != 0 && (long)(millis() - chargedUntil) >= 0) {
+          closeCharge();
+        }
+      }
+    };
+
+    for (const Event &event : events) {
+      if (event.type == CODE || event.type == LEDS) {
+        continue;
+      }
+      runUntil(event.time);
+      closeCharge();
+
+      switch (event.type) {
+        case KEY:
+          NativeSim::pressKey(event.payload[0]);
+          break;
+        case MESSAGE:
+          AsyncMqttClient::nativeDeliver(event.topic.c_str(), event.payload.data(), event.payload.size());
+          break;
+        case CONNECT:
+          // The firmware connects at its next attempt
+          NativeSim::setBrokerReachable(true);
+          break;
+        case DISCONNECT:
+          NativeSim::setBrokerReachable(false);
+          break;
+      }
+      chargedType = event.type;
+      chargedUntil = millis() + options.eventWindowMs;
+      charged = 0;
+      step();
+    }
+
+    // Let the last outputs appear
+    runUntil(millis() + options.eventWindowMs + options.ledToleranceMs);
+    closeCharge();
+    publishedCodes = nullptr;
+
+    long codeDrift = 0;
+    int codeMismatches = compareCodes(expectedCodes, seenCodes, codeDrift);
+    int frameMismatches = compareFrames(expectedFrames, seenFrames, options.ledToleranceMs);
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    unsigned long virtualMs = millis() - start;
+    fprintf(stderr, "replay %s: events=%u t=%lus codes=%u/%u (mismatches %d, drift max %ldms) frames=%u/%u (missing %d) "
+                    "wall=%.2fs %.0fx real time\n",
+            options.path, (unsigned int)events.size(), virtualMs / 1000, (unsigned int)seenCodes.size(),
+            (unsigned int)expectedCodes.size(), codeMismatches, codeDrift, (unsigned int)expectedFrames.size() - frameMismatches,
+            (unsigned int)expectedFrames.size(), frameMismatches, wallSeconds,
+            wallSeconds > 0 ? virtualMs / 1000.0 / wallSeconds : 0.0);
+    for (uint8_t type = 1; type < TYPE_COUNT; type++) {
+      costs.report(type);
+    }
+
+    return codeMismatches == 0 && frameMismatches == 0;
+  }
+
+}
@@ -0,0 +1,32 @@
+// Replay driver for the native build.
+//
+// Feeds an event trace recorded by the firmware (EVENT_TRACE, the format is
+// described in include/EventTrace.h) back through it in virtual time: the
+// key presses go through the simulated matrix, the messages through the
+// in-process broker and the connection changes make the broker reachable
+// or not. The codes published and the LED frames shown are checked against
+// the recorded ones. The wall clock time loop() spends on each input, until
+// the next one or for at most the event window, is reported per input type.
+
+#ifndef NATIVE_HAL_NATIVEREPLAY_H
+#define NATIVE_HAL_NATIVEREPLAY_H
+
+#include <stdint.h>
+#include <functional>
+
+namespace NativeReplay {
+
+  struct Options {
+    const char *path;
+    uint16_t leds;                   // pixels covered by the frame checksum
+    unsigned long ledToleranceMs;    // a frame may be shown that much earlier or later
+    unsigned long eventWindowMs;     // virtual time charged to an input
+  };
+
+  // runLoop runs one iteration of loop() and pumps the simulator.
+  // Returns false if the trace could not be read or an output differs.
+  bool run(const Options &options, std::function<void()> runLoop);
+
+}
+
+#endif // NATIVE_HAL_NATIVEREPLAY_H
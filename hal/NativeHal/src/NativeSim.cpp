@@ -0,0 +1,302 @@
+#include "NativeSim.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <deque>
+#include <vector>
+
+#include "AsyncMqttClient.h"
+
+namespace {
+  const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  uint64_t skippedMicros = 0;
+
+  struct KeyPress {
+    uint8_t rowPin;
+    uint8_t colPin;
+    uint64_t start;
+    uint64_t end;
+  };
+  std::deque<KeyPress> keyPresses;
+  std::string keyMap;
+  std::vector<uint8_t> keyRowPins;
+  std::vector<uint8_t> keyColPins;
+  uint64_t keyHoldMicros = 80000;
+  uint64_t keyGapMicros = 40000;
+  uint64_t keyBounceMicros = 0;
+  std::vector<std::function<void()>> pumpHandlers;
+  std::vector<std::function<void()>> interruptHandlers;
+  std::vector<NativeSim::PublishHook> publishHooks;
+  std::vector<NativeSim::HandledHook> handledHooks;
+  std::vector<NativeSim::HttpHook> httpHooks;
+  std::deque<NativeSim::HttpRequest> httpRequests;
+
+  bool wifiUp = true;
+  NativeSim::WiFiTiming wifiTimes = { 2000, 150, 800 };
+  uint8_t apBssid[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+  bool brokerUp = true;
+  NativeSim::BrokerTls brokerTlsConfig = NativeSim::BrokerTls();
+
+  // UART1 line, in tenths of us
+  const uint64_t UART1_CHAR_TIME = 25;
+  const uint64_t WS2812_LATCH_TIME = 500;
+  uint64_t uart1BusyUntil = 0;
+  std::vector<uint8_t> uart1Frame;
+  std::vector<uint8_t> ws2812Frame;   // GRB
+
+  NativeSim::Counters stats = {};
+
+  uint64_t nowTenths() {
+    return NativeSim::nowMicros() * 10;
+  }
+
+  // Decode the characters sent since the last latch into the frame
+  void ws2812Latch() {
+    if (uart1Frame.empty() || nowTenths() < uart1BusyUntil + WS2812_LATCH_TIME) {
+      return;
+    }
+    static const uint8_t symbols[4] = { 0x37, 0x07, 0x34, 0x04 };
+    ws2812Frame.assign(uart1Frame.size() / 4, 0);
+    for (size_t i = 0; i < ws2812Frame.size() * 4; i++) {
+      uint8_t pair = 0;
+      while (pair < 4 && symbols[pair] != uart1Frame[i]) {
+        pair++;
+      }
+      if (pair == 4) {
+        fprintf(stderr, "native: invalid WS2812 symbol 0x%02x\n", uart1Frame[i]);
+        pair = 0;
+      }
+      ws2812Frame[i / 4] |= pair << (6 - 2 * (i % 4));
+    }
+    uart1Frame.clear();
+  }
+}
+
+namespace NativeSim {
+
+  uint64_t nowMicros() {
+    auto elapsed = std::chrono::steady_clock::now() - startTime;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + skippedMicros;
+  }
+
+  void advance(unsigned long ms) {
+    skippedMicros += (uint64_t)ms * 1000;
+  }
+
+  void advanceMicros(uint64_t us) {
+    skippedMicros += us;
+  }
+
+  void pump() {
+    serviceInterrupts();
+    for (auto &handler : pumpHandlers) {
+      handler();
+    }
+  }
+
+  void addPumpHandler(std::function<void()> handler) {
+    pumpHandlers.push_back(handler);
+  }
+
+  void serviceInterrupts() {
+    for (auto &handler : interruptHandlers) {
+      handler();
+    }
+  }
+
+  void addInterruptHandler(std::function<void()> handler) {
+    interruptHandlers.push_back(handler);
+  }
+
+  void setKeyMatrix(const char *keymap, const uint8_t *rowPins, const uint8_t *colPins, uint8_t rows, uint8_t cols) {
+    keyMap.assign(keymap, rows * cols);
+    keyRowPins.assign(rowPins, rowPins + rows);
+    keyColPins.assign(colPins, colPins + cols);
+  }
+
+  void setKeyTiming(unsigned long hold, unsigned long gap, unsigned long bounce) {
+    keyHoldMicros = (uint64_t)hold * 1000;
+    keyGapMicros = (uint64_t)gap * 1000;
+    keyBounceMicros = (uint64_t)bounce * 1000;
+  }
+
+  void pressKey(char key) {
+    size_t index = keyMap.find(key);
+    if (index == std::string::npos) {
+      return;
+    }
+    uint64_t now = nowMicros();
+    uint64_t start = keyPresses.empty() ? now : keyPresses.back().end + keyGapMicros;
+    if (start < now) {
+      start = now;
+    }
+    size_t cols = keyColPins.size();
+    keyPresses.push_back(KeyPress{ keyRowPins[index / cols], keyColPins[index % cols], start, start + keyHoldMicros });
+    stats.keysPressed++;
+  }
+
+  size_t pendingKeys() {
+    uint64_t now = nowMicros();
+    while (!keyPresses.empty() && keyPresses.front().end <= now) {
+      keyPresses.pop_front();
+    }
+    return keyPresses.size();
+  }
+
+  bool keyClosed(uint8_t rowPin, uint8_t colPin) {
+    uint64_t now = nowMicros();
+    for (auto &press : keyPresses) {
+      if (press.start > now) {
+        break;
+      }
+      if (now >= press.end || press.rowPin != rowPin || press.colPin != colPin) {
+        continue;
+      }
+      uint64_t held = now - press.start;
+      // while bouncing the contact is open every other millisecond
+      return held >= keyBounceMicros || ((held / 1000) % 2) == 0;
+    }
+    return false;
+  }
+
+  void setWiFiConnected(bool connected) {
+    wifiUp = connected;
+    AsyncMqttClient::nativeLinkChanged();
+  }
+
+  bool wifiConnected() {
+    return wifiUp;
+  }
+
+  void setWiFiTiming(unsigned long scan, unsigned long associate, unsigned long dhcp) {
+    wifiTimes.scan = scan;
+    wifiTimes.associate = associate;
+    wifiTimes.dhcp = dhcp;
+  }
+
+  const WiFiTiming &wifiTiming() {
+    return wifiTimes;
+  }
+
+  void setAccessPoint(const uint8_t bssid[6]) {
+    memcpy(apBssid, bssid, sizeof(apBssid));
+  }
+
+  const uint8_t *accessPointBssid() {
+    return apBssid;
+  }
+
+  void setBrokerReachable(bool reachable) {
+    brokerUp = reachable;
+    AsyncMqttClient::nativeLinkChanged();
+  }
+
+  bool brokerReachable() {
+    return brokerUp && wifiUp;
+  }
+
+  void setBrokerTls(const BrokerTls &tls) {
+    brokerTlsConfig = tls;
+  }
+
+  const BrokerTls &brokerTls() {
+    return brokerTlsConfig;
+  }
+
+  void deliver(const char *topic, const char *payload) {
+    stats.delivered++;
+    AsyncMqttClient::nativeDeliver(topic, payload, strlen(payload));
+  }
+
+  void onPublish(PublishHook hook) {
+    publishHooks.push_back(hook);
+  }
+
+  void notifyPublish(const char *topic, const char *payload, size_t length, uint8_t qos, bool retain) {
+    stats.published++;
+    for (auto &hook : publishHooks) {
+      hook(topic, payload, length, qos, retain);
+    }
+  }
+
+  void httpGet(uint16_t port, const char *path, uint32_t sendMs, uint32_t readBytesPerMs) {
+    HttpRequest request = { port, std::string(path), sendMs, readBytesPerMs };
+    httpRequests.push_back(request);
+  }
+
+  bool takeHttpRequest(uint16_t port, HttpRequest &request) {
+    if (!wifiUp) {
+      return false;
+    }
+    for (auto it = httpRequests.begin(); it != httpRequests.end(); ++it) {
+      if (it->port == port) {
+        request = *it;
+        httpRequests.erase(it);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void onHttpResponse(HttpHook hook) {
+    httpHooks.push_back(hook);
+  }
+
+  void notifyHttpResponse(const char *path, const HttpResponse &response) {
+    for (auto &hook : httpHooks) {
+      hook(path, response);
+    }
+  }
+
+  void onHandled(HandledHook hook) {
+    handledHooks.push_back(hook);
+  }
+
+  void notifyHandled(const char *topic, uint32_t micros) {
+    for (auto &hook : handledHooks) {
+      hook(topic, micros);
+    }
+  }
+
+  void ledFrame(const uint8_t *grb, size_t length, uint32_t maskedMicros) {
+    ws2812Frame.assign(grb, grb + length);
+    stats.ledShows++;
+    stats.ledMaskedMicros += maskedMicros;
+    advanceMicros(maskedMicros);
+  }
+
+  uint8_t uart1FifoUsed() {
+    uint64_t now = nowTenths();
+    if (now >= uart1BusyUntil) {
+      return 0;
+    }
+    return (uint8_t)((uart1BusyUntil - now + UART1_CHAR_TIME - 1) / UART1_CHAR_TIME);
+  }
+
+  void uart1Write(uint8_t c) {
+    ws2812Latch();
+    uint64_t now = nowTenths();
+    if (uart1Frame.empty()) {
+      stats.ledShows++;
+    }
+    uart1Frame.push_back(c);
+    uart1BusyUntil = (uart1BusyUntil > now ? uart1BusyUntil : now) + UART1_CHAR_TIME;
+  }
+
+  uint32_t ledColor(uint16_t n) {
+    ws2812Latch();
+    if ((size_t)n * 3 + 2 >= ws2812Frame.size()) {
+      return 0;
+    }
+    const uint8_t *p = &ws2812Frame[n * 3];
+    return ((uint32_t)p[1] << 16) | ((uint32_t)p[0] << 8) | p[2];
+  }
+
+  Counters &counters() {
+    return stats;
+  }
+
+}
@@ -0,0 +1,150 @@
+// Control surface of the host simulator.
+//
+// The simulated devices (keypad, LED strip, WiFi, MQTT broker) are driven
+// from here by the native main() and by whatever harness links against the
+// native build. Nothing in src/ should include this header unless it is
+// guarded by NATIVE_BUILD.
+
+#ifndef NATIVE_HAL_NATIVESIM_H
+#define NATIVE_HAL_NATIVESIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <string>
+
+namespace NativeSim {
+
+  // Clock ----------------------------------------------------------------
+  // millis()/micros() follow the real monotonic clock plus every delay()
+  // and advance() skipped on the way, so a 3s delay() costs nothing on the
+  // host but the firmware still sees the time pass.
+  uint64_t nowMicros();
+  void advance(unsigned long ms);
+  void advanceMicros(uint64_t us);
+
+  // Deliver pending asynchronous events (MQTT acks and messages). Called by
+  // delay()/yield() exactly like the ESP8266 SYS context would run them.
+  void pump();
+  void addPumpHandler(std::function<void()> handler);
+  // Interrupt sources (timer1, GPIO) only, also serviced while the
+  // firmware busy-waits, e.g. on a full UART FIFO. pump() runs them first.
+  void serviceInterrupts();
+  void addInterruptHandler(std::function<void()> handler);
+
+  // Keypad ---------------------------------------------------------------
+  // The keypad is a switch matrix read through digitalRead(): a row pin
+  // reads LOW while a column pin driven LOW is connected to it by a closed
+  // switch. The wiring has to be declared before keys can be pressed.
+  void setKeyMatrix(const char *keymap, const uint8_t *rowPins, const uint8_t *colPins, uint8_t rows, uint8_t cols);
+  // hold: how long a key stays closed, gap: pause before the next queued
+  // press, bounce: the contact chatters for that long after closing.
+  void setKeyTiming(unsigned long hold, unsigned long gap, unsigned long bounce);
+  // Queue a press; it starts once the previous one is released
+  void pressKey(char key);
+  // Presses not released yet
+  size_t pendingKeys();
+  bool keyClosed(uint8_t rowPin, uint8_t colPin);
+
+  // Network --------------------------------------------------------------
+  // The access point is in range
+  void setWiFiConnected(bool connected);
+  bool wifiConnected();
+  // How long joining takes (ms): the scan is skipped when the BSSID and
+  // channel are given, DHCP when a static IP is configured
+  struct WiFiTiming {
+    unsigned long scan;
+    unsigned long associate;
+    unsigned long dhcp;
+  };
+  void setWiFiTiming(unsigned long scan, unsigned long associate, unsigned long dhcp);
+  const WiFiTiming &wifiTiming();
+  // The BSSID of the access point (02:00:00:00:00:01 unless set), a new one
+  // is like the access point being replaced: the station loses it
+  void setAccessPoint(const uint8_t bssid[6]);
+  const uint8_t *accessPointBssid();
+  void setBrokerReachable(bool reachable);
+  bool brokerReachable();
+
+  // TLS listener of the broker. A client has to match it (secure or not);
+  // a secure one holds handshakeHeap bytes for handshakeMs of virtual time,
+  // then sessionHeap bytes while connected. The certificate has the given
+  // SHA-1 fingerprint.
+  struct BrokerTls {
+    bool enabled;
+    unsigned long handshakeMs;
+    size_t handshakeHeap;
+    size_t sessionHeap;
+    uint8_t fingerprint[20];
+  };
+  void setBrokerTls(const BrokerTls &tls);
+  const BrokerTls &brokerTls();
+
+  // Message from the broker to the device
+  void deliver(const char *topic, const char *payload);
+
+  typedef std::function<void(const char *topic, const char *payload, size_t length, uint8_t qos, bool retain)> PublishHook;
+  // Called for every message the device publishes
+  void onPublish(PublishHook hook);
+  void notifyPublish(const char *topic, const char *payload, size_t length, uint8_t qos, bool retain);
+
+  typedef std::function<void(const char *topic, uint32_t micros)> HandledHook;
+  // Called after the device processed a message, with the wall clock time
+  // spent in its callback over all the chunks
+  void onHandled(HandledHook hook);
+  void notifyHandled(const char *topic, uint32_t micros);
+
+  // Local HTTP ------------------------------------------------------------
+  // A GET request from the LAN, accepted by the WiFiServer listening on the
+  // port (while the WiFi link is up). The client takes sendMs to send the
+  // whole request and reads the response at readBytesPerMs, 0 for at once.
+  struct HttpRequest {
+    uint16_t port;
+    std::string path;
+    uint32_t sendMs;
+    uint32_t readBytesPerMs;
+  };
+  void httpGet(uint16_t port, const char *path, uint32_t sendMs = 0, uint32_t readBytesPerMs = 0);
+  bool takeHttpRequest(uint16_t port, HttpRequest &request);
+
+  // The response as the client received it, the body with the chunked
+  // encoding removed
+  struct HttpResponse {
+    int code;
+    std::string type;
+    std::string body;
+    size_t chunks;
+    bool chunked;
+    bool complete;    // chunked and ended by the empty chunk, or not chunked
+    bool dropped;     // the server closed the connection on its timeout
+  };
+  typedef std::function<void(const char *path, const HttpResponse &response)> HttpHook;
+  void onHttpResponse(HttpHook hook);
+  void notifyHttpResponse(const char *path, const HttpResponse &response);
+
+  // LED strip -------------------------------------------------------------
+  // Adafruit_NeoPixel hands its frames over directly (GRB, 3 bytes a pixel)
+  // after the 30us a pixel it bit-bangs with the interrupts masked.
+  // Through UART1 (Ws2812Uart) the TX FIFO drains at 3.2 Mbaud, 2.5us per
+  // character; the frame is latched once the line stayed idle for 50us and
+  // decoded back from the WS2812 bit pairs, invalid characters are reported.
+  void ledFrame(const uint8_t *grb, size_t length, uint32_t maskedMicros);
+  uint8_t uart1FifoUsed();
+  void uart1Write(uint8_t c);
+  // Last frame on the strip, 0x00RRGGBB per pixel
+  uint32_t ledColor(uint16_t n);
+
+  // Statistics -----------------------------------------------------------
+  struct Counters {
+    uint32_t loops;
+    uint32_t ledShows;
+    uint32_t ledMaskedMicros;   // interrupts masked by the bit-banged show()
+    uint32_t published;
+    uint32_t delivered;
+    uint32_t keysPressed;
+  };
+  Counters &counters();
+
+}
+
+#endif // NATIVE_HAL_NATIVESIM_H
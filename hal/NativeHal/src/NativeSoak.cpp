@@ -0,0 +1,258 @@
+#include "NativeSoak.h"
+#include "NativeSim.h"
+#include "AsyncMqttClient.h"
+#include "Arduino.h"
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+  const char *COMMAND_TOPIC = "alarm/keypad/command";
+  const char *CODE_TOPIC = "alarm/keypad/code";
+  const size_t FULL_FRAGMENT = 1460;
+
+  struct Totals {
+    uint32_t commands;
+    uint32_t malformed;
+    uint32_t fragmented;
+    uint32_t codesSent;
+    uint32_t codesReceived;
+    uint32_t codesDropped;
+    uint32_t codesGarbled;
+    uint32_t maxLoopMicros;
+  };
+
+  // 1us buckets, allocated up front so the driver does not grow the heap
+  // it is measuring. Slower samples are counted in the last bucket.
+  struct Histogram {
+    static const uint32_t LIMIT = 20000;
+
+    Histogram() : counts(LIMIT + 1, 0), samples(0), max(0) {}
+
+    void add(uint32_t micros) {
+      counts[std::min<uint32_t>(micros, uint32_t(LIMIT))]++;
+      samples++;
+      max = std::max(max, micros);
+    }
+
+    uint32_t percentile(unsigned int pct) const {
+      uint64_t rank = (uint64_t)samples * pct / 100;
+      uint64_t seen = 0;
+      for (uint32_t us = 0; us <= LIMIT; us++) {
+        seen += counts[us];
+        if (seen > rank) {
+          return us;
+        }
+      }
+      return max;
+    }
+
+    void clear() {
+      std::fill(counts.begin(), counts.end(), 0);
+      samples = 0;
+      max = 0;
+    }
+
+    std::vector<uint32_t> counts;
+    uint64_t samples;
+    uint32_t max;
+  };
+
+  class Driver {
+    public:
+      explicit Driver(const NativeSoak::Options &_options)
+        : options(_options)
+        , rng(_options.seed)
+        , totals() {
+      }
+
+      // Next command payload; the kinds follow a fixed mix
+      std::string nextCommand(size_t &fragment) {
+        fragment = FULL_FRAGMENT;
+        unsigned int kind = rng() % 100;
+        if (kind < 40) {
+          return "{\"command\":\"brightness\",\"value\":" + std::to_string(rng() % 256) + "}";
+        } else if (kind < 50) {
+          return "{\"command\":\"unlock\"}";
+        } else if (kind < 52) {
+          return "{\"command\":\"state\"}";
+        } else if (kind < 60) {
+          return "{\"command\":\"selfdestruct\",\"value\":1}";
+        } else if (kind < 75) {
+          totals.malformed++;
+          return malformed();
+        } else if (kind < 80) {
+          // longer than the assembler arena
+          totals.malformed++;
+          return "{\"command\":\"brightness\",\"pad\":\"" + std::string(300 + rng() % 200, 'x') + "\"}";
+        } else {
+          totals.fragmented++;
+          fragment = 1 + rng() % 16;
+          return "{\"command\":\"brightness\",\"value\":" + std::to_string(rng() % 256) + ",\"pad\":\"" + std::string(rng() % 64, 'y') + "\"}";
+        }
+      }
+
+      std::string malformed() {
+        switch (rng() % 5) {
+          case 0:
+            return "{";
+          case 1:
+            return "not json";
+          case 2:
+            return "{\"command\":}";
+          case 3:
+            return "{\"command\":\"brightness\",\"value\":\"abc\"}";
+          default: {
+            std::string junk(1 + rng() % 100, ' ');
+            for (auto &c : junk) {
+              c = (char)(1 + rng() % 255);
+            }
+            return junk;
+          }
+        }
+      }
+
+      void typeCode() {
+        std::string code;
+        for (int i = 0; i < 4; i++) {
+          code += (char)('0' + rng() % 10);
+        }
+        for (char key : code) {
+          NativeSim::pressKey(key);
+        }
+        NativeSim::pressKey('#');
+        expected.push_back(code);
+        totals.codesSent++;
+      }
+
+      void codePublished(const char *payload, size_t length) {
+        std::string code(payload, length);
+        totals.codesReceived++;
+        auto found = std::find(expected.begin(), expected.end(), code);
+        if (found == expected.end()) {
+          totals.codesGarbled++;
+          return;
+        }
+        // the codes before it never made it
+        totals.codesDropped += found - expected.begin();
+        expected.erase(expected.begin(), found + 1);
+      }
+
+      void report(const char *label, unsigned long now, const Histogram &samples, uint32_t heapStart) {
+        uint32_t heap = ESP.getFreeHeap();
+        fprintf(stderr, "soak %s: t=%lus commands=%u (malformed %u, fragmented %u) handled p50=%uus p99=%uus max=%uus "
+                        "codes=%u/%u dropped=%u garbled=%u heap_delta=%ld loop_max=%uus\n",
+                label, now / 1000, totals.commands, totals.malformed, totals.fragmented,
+                samples.percentile(50), samples.percentile(99), samples.max,
+                totals.codesReceived, totals.codesSent, totals.codesDropped, totals.codesGarbled,
+                (long)heap - (long)heapStart, totals.maxLoopMicros);
+      }
+
+      const NativeSoak::Options &options;
+      std::mt19937 rng;
+      Totals totals;
+      std::deque<std::string> expected;
+      Histogram handled;     // whole run
+      Histogram interval;    // since the last report
+  };
+
+  // The simulator hooks cannot be removed, they follow the running driver
+  Driver *active = nullptr;
+  bool hooked = false;
+
+  void hook() {
+    if (hooked) {
+      return;
+    }
+    hooked = true;
+    NativeSim::onHandled([](const char *topic, uint32_t micros) {
+      if (active && strcmp(topic, COMMAND_TOPIC) == 0) {
+        active->handled.add(micros);
+        active->interval.add(micros);
+      }
+    });
+    NativeSim::onPublish([](const char *topic, const char *payload, size_t length, uint8_t, bool) {
+      if (active && strcmp(topic, CODE_TOPIC) == 0) {
+        active->codePublished(payload, length);
+      }
+    });
+  }
+
+}
+
+namespace NativeSoak {
+
+  bool run(const Options &options, std::function<void()> runLoop) {
+    Driver driver(options);
+    hook();
+    active = &driver;
+
+    uint32_t heapStart = ESP.getFreeHeap();
+    unsigned long start = millis();
+    unsigned long nextReport = start + options.reportEveryMs;
+    unsigned long nextCode = start;
+    unsigned long codeEvery = options.codesPerMinute > 0 ? 60000 / options.codesPerMinute : 0;
+    unsigned long credit = 0;
+    unsigned long last = start;
+    auto wallStart = std::chrono::steady_clock::now();
+
+    while (millis() - start < options.durationMs) {
+      NativeSim::advance(1);
+
+      // loop() moves the clock on its own when it sleeps
+      unsigned long now = millis();
+      credit += (now - last) * options.commandsPerSecond;
+      last = now;
+      while (credit >= 1000) {
+        credit -= 1000;
+        size_t fragment;
+        std::string payload = driver.nextCommand(fragment);
+        AsyncMqttClient::nativeSetFragmentSize(fragment);
+        NativeSim::deliver(COMMAND_TOPIC, payload.c_str());
+        driver.totals.commands++;
+      }
+
+      if (codeEvery > 0 && (long)(millis() - nextCode) >= 0 && NativeSim::pendingKeys() == 0) {
+        driver.typeCode();
+        nextCode = millis() + codeEvery;
+      }
+
+      auto loopStart = std::chrono::steady_clock::now();
+      runLoop();
+      uint32_t loopMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - loopStart).count();
+      driver.totals.maxLoopMicros = std::max(driver.totals.maxLoopMicros, loopMicros);
+
+      if (options.reportEveryMs > 0 && (long)(millis() - nextReport) >= 0) {
+        driver.report("progress", millis() - start, driver.interval, heapStart);
+        driver.interval.clear();
+        nextReport += options.reportEveryMs;
+      }
+    }
+
+    // let the last code go out
+    unsigned long drainEnd = millis() + 1000;
+    while (NativeSim::pendingKeys() > 0 || (long)(millis() - drainEnd) < 0) {
+      NativeSim::advance(1);
+      runLoop();
+    }
+    AsyncMqttClient::nativeSetFragmentSize(FULL_FRAGMENT);
+
+    active = nullptr;
+    driver.totals.codesDropped += driver.expected.size();
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    driver.report("total", millis() - start, driver.handled, heapStart);
+    fprintf(stderr, "soak throughput: %.0f commands/s wall clock, %.1fx real time\n",
+            wallSeconds > 0 ? driver.totals.commands / wallSeconds : 0.0,
+            wallSeconds > 0 ? (millis() - start) / 1000.0 / wallSeconds : 0.0);
+
+    return driver.totals.codesDropped == 0 && driver.totals.codesGarbled == 0;
+  }
+
+}
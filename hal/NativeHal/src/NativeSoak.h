@@ -0,0 +1,31 @@
+// Load and soak driver for the native build.
+//
+// Runs the firmware in virtual time while the in-process broker delivers a
+// stream of commands (valid, unknown, malformed, oversized and fragmented)
+// and the keypad types codes in bursts. Reports the handling time of the
+// messages (wall clock), codes lost or garbled on the way to the broker,
+// heap growth and the longest loop() iteration, periodically and at the end.
+
+#ifndef NATIVE_HAL_NATIVESOAK_H
+#define NATIVE_HAL_NATIVESOAK_H
+
+#include <stdint.h>
+#include <functional>
+
+namespace NativeSoak {
+
+  struct Options {
+    unsigned long durationMs;        // virtual time to run
+    unsigned long commandsPerSecond;
+    unsigned long codesPerMinute;
+    unsigned long reportEveryMs;     // virtual time between progress lines
+    uint32_t seed;
+  };
+
+  // runLoop runs one iteration of loop() and pumps the simulator.
+  // Returns false if codes were dropped or garbled.
+  bool run(const Options &options, std::function<void()> runLoop);
+
+}
+
+#endif // NATIVE_HAL_NATIVESOAK_H
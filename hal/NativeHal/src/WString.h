@@ -0,0 +1,40 @@
+#ifndef NATIVE_HAL_WSTRING_H
+#define NATIVE_HAL_WSTRING_H
+
+#include <stdlib.h>
+#include <string>
+
+// A thin Arduino String on top of std::string. Heap usage on the host is
+// not representative of the ESP8266, it is only here to keep the sketch
+// compiling unmodified.
+class String {
+  public:
+    String() {}
+    String(const char *s) : str(s ? s : "") {}
+    String(const std::string &s) : str(s) {}
+    explicit String(char c) : str(1, c) {}
+    explicit String(int n) : str(std::to_string(n)) {}
+    explicit String(unsigned int n) : str(std::to_string(n)) {}
+    explicit String(long n) : str(std::to_string(n)) {}
+    explicit String(unsigned long n) : str(std::to_string(n)) {}
+
+    const char *c_str() const { return str.c_str(); }
+    unsigned int length() const { return str.length(); }
+    char operator[](unsigned int i) const { return str[i]; }
+
+    bool operator==(const String &rhs) const { return str == rhs.str; }
+    bool operator!=(const String &rhs) const { return str != rhs.str; }
+    bool equals(const char *s) const { return str == s; }
+
+    String &operator+=(const String &rhs) { str += rhs.str; return *this; }
+    String &operator+=(const char *rhs) { str += rhs; return *this; }
+    String &operator+=(char c) { str += c; return *this; }
+    friend String operator+(const String &lhs, const String &rhs) { return String(lhs.str + rhs.str); }
+
+    int toInt() const { return atoi(str.c_str()); }
+
+  private:
+    std::string str;
+};
+
+#endif // NATIVE_HAL_WSTRING_H
@@ -0,0 +1,56 @@
+#include "WiFiClient.h"
+
+// TCP_SND_BUF of lwIP, two segments
+static const uint32_t SEND_BUFFER = 2 * 1460;
+
+WiFiClient::WiFiClient(const NativeSim::HttpRequest &request) : connection(std::make_shared<Connection>()) {
+  uint64_t now = NativeSim::nowMicros();
+  connection->request = request;
+  connection->completeAt = now + (uint64_t)request.sendMs * 1000;
+  connection->drainedAt = now;
+  connection->closed = false;
+}
+
+void WiFiClient::stop() {
+  if (connection != nullptr) {
+    connection->closed = true;
+  }
+}
+
+bool WiFiClient::wait(uint64_t until) {
+  uint64_t now = NativeSim::nowMicros();
+  if (until <= now) {
+    return true;
+  }
+  uint64_t limit = now + (uint64_t)timeout * 1000;
+  NativeSim::advanceMicros((until < limit ? until : limit) - now);
+  return until <= limit;
+}
+
+bool WiFiClient::readRequest(std::string &path) {
+  if (!connected()) {
+    return false;
+  }
+  path = connection->request.path;
+  return wait(connection->completeAt);
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+  if (!connected()) {
+    return 0;
+  }
+  uint32_t rate = connection->request.readBytesPerMs;
+  if (rate == 0) {
+    return size;
+  }
+  // Blocks until what the client has not read yet and the data fit the buffer
+  uint64_t now = NativeSim::nowMicros();
+  uint64_t drainedAt = (connection->drainedAt > now ? connection->drainedAt : now) + (uint64_t)size * 1000 / rate;
+  uint64_t buffered = (uint64_t)SEND_BUFFER * 1000 / rate;
+  if (drainedAt > now + buffered && !wait(drainedAt - buffered)) {
+    connection->closed = true;
+    return 0;
+  }
+  connection->drainedAt = drainedAt;
+  return size;
+}
@@ -0,0 +1,54 @@
+// Host stand-in for a TCP connection accepted by WiFiServer, the client
+// being a NativeSim::httpGet(). Reads and writes block the way the SDK's
+// do, on the virtual clock and for at most the timeout of the client
+// (5000 ms unless set): the request is complete sendMs after the connect,
+// and the response fills the send buffer as fast as the client drains it.
+// A write that times out closes the connection.
+
+#ifndef NATIVE_HAL_WIFICLIENT_H
+#define NATIVE_HAL_WIFICLIENT_H
+
+#include "Arduino.h"
+#include "NativeSim.h"
+
+#include <memory>
+#include <string>
+
+class WiFiClient {
+  public:
+    WiFiClient() {}
+    explicit WiFiClient(const NativeSim::HttpRequest &request);
+
+    operator bool() const { return connection != nullptr; }
+    uint8_t connected() const { return connection != nullptr && !connection->closed; }
+    // The request is in pieces from the connect on
+    int available() const { return connected() ? 1 : 0; }
+    void stop();
+
+    void setTimeout(unsigned long ms) { timeout = ms; }
+    unsigned long getTimeout() const { return timeout; }
+
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+
+    // Native: reads the request line like readStringUntil('\r'), false if it
+    // is not complete within the timeout (the path is set anyway, for the
+    // report of the dropped request)
+    bool readRequest(std::string &path);
+
+  private:
+    struct Connection {
+      NativeSim::HttpRequest request;
+      uint64_t completeAt;   // us, the last byte of the request is in
+      uint64_t drainedAt;    // us, the client has read everything written
+      bool closed;
+    };
+
+    // Blocks for the time, false if that is past the timeout
+    bool wait(uint64_t until);
+
+    std::shared_ptr<Connection> connection;
+    unsigned long timeout = 5000;
+};
+
+#endif // NATIVE_HAL_WIFICLIENT_H
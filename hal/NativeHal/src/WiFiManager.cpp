@@ -0,0 +1,42 @@
+#include "WiFiManager.h"
+#include "NativeSim.h"
+
+WiFiManagerParameter::WiFiManagerParameter(const char *custom)
+  : id(NULL)
+  , placeholder(custom)
+  , value(NULL)
+  , length(0) {
+}
+
+WiFiManagerParameter::WiFiManagerParameter(const char *_id, const char *_placeholder, const char *defaultValue, int _length)
+  : id(_id)
+  , placeholder(_placeholder)
+  , value(new char[_length + 1]())
+  , length(_length) {
+  if (defaultValue != NULL) {
+    strncpy(value, defaultValue, length);
+  }
+}
+
+WiFiManagerParameter::~WiFiManagerParameter() {
+  delete[] value;
+}
+
+bool WiFiManager::autoConnect(const char *, const char *) {
+  // Join with the credentials stored by the SDK, scanning for the AP.
+  // Without them the portal opens, and times out here.
+  if (WiFi.SSID().length() == 0) {
+    Serial.println("*WM: no saved credentials, the portal timed out");
+    return false;
+  }
+  WiFi.begin();
+  unsigned long start = millis();
+  while (WiFi.status() != WL_CONNECTED && millis() - start < 30000) {
+    delay(1);
+  }
+  return WiFi.status() == WL_CONNECTED;
+}
+
+bool WiFiManager::startConfigPortal(const char *apName, const char *apPassword) {
+  return autoConnect(apName, apPassword);
+}
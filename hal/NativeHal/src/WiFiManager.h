@@ -0,0 +1,43 @@
+// Host stand-in for https://github.com/tzapu/WiFiManager
+// autoConnect() joins the simulated access point, the portal returns at
+// once as if it timed out without a new configuration.
+
+#ifndef NATIVE_HAL_WIFIMANAGER_H
+#define NATIVE_HAL_WIFIMANAGER_H
+
+#include "Arduino.h"
+#include "ESP8266WiFi.h"
+
+class WiFiManagerParameter {
+  public:
+    explicit WiFiManagerParameter(const char *custom);
+    WiFiManagerParameter(const char *id, const char *placeholder, const char *defaultValue, int length);
+    ~WiFiManagerParameter();
+
+    const char *getID() const { return id; }
+    const char *getValue() const { return value; }
+    const char *getPlaceholder() const { return placeholder; }
+    int getValueLength() const { return length; }
+
+  private:
+    const char *id;
+    const char *placeholder;
+    char *value;
+    int length;
+};
+
+class WiFiManager {
+  public:
+    bool autoConnect(const char *apName, const char *apPassword = NULL);
+    bool startConfigPortal(const char *apName, const char *apPassword = NULL);
+    void resetSettings() {}
+    void setTimeout(unsigned long seconds) { (void)seconds; }
+    void setMinimumSignalQuality(int quality = 8) { (void)quality; }
+    void setSaveConfigCallback(void (*func)(void)) { saveCallback = func; }
+    void addParameter(WiFiManagerParameter *p) { (void)p; }
+
+  private:
+    void (*saveCallback)(void) = NULL;
+};
+
+#endif // NATIVE_HAL_WIFIMANAGER_H
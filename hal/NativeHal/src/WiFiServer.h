@@ -0,0 +1,30 @@
+// Host stand-in for WiFiServer, accepting the NativeSim::httpGet() requests
+// to its port.
+
+#ifndef NATIVE_HAL_WIFISERVER_H
+#define NATIVE_HAL_WIFISERVER_H
+
+#include "NativeSim.h"
+#include "WiFiClient.h"
+
+class WiFiServer {
+  public:
+    explicit WiFiServer(uint16_t port) : port(port) {}
+    void begin() { listening = true; }
+    void close() { listening = false; }
+    void stop() { close(); }
+
+    WiFiClient available() {
+      NativeSim::HttpRequest request;
+      if (!listening || !NativeSim::takeHttpRequest(port, request)) {
+        return WiFiClient();
+      }
+      return WiFiClient(request);
+    }
+
+  private:
+    uint16_t port;
+    bool listening = false;
+};
+
+#endif // NATIVE_HAL_WIFISERVER_H
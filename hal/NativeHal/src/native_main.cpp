@@ -0,0 +1,265 @@
+// Entry point of the native build: runs setup() once, then loop() while
+// feeding the simulated devices from a script read on stdin.
+//
+//   key <keys>             press the keys one after another, e.g. "key 1234#"
+//   keytiming <hold> <gap> <bounce>  how long a press lasts, the pause
+//                          between presses and the contact bounce (ms)
+//   msg <topic> <payload>  the broker delivers a message to the device
+//   fragment <bytes>       deliver payloads in chunks of at most that size
+//   wait <ms>              let the virtual clock run, loop() keeps spinning
+//   loops <n>              run loop() n times
+//   leds                   print the frame on the strip as "LEDS <rrggbb>..."
+//   wifi up|down           change the WiFi link state
+//   ap <bssid>             replace the access point by one with this BSSID
+//                          (same SSID), e.g. "ap 02:00:00:00:00:02"
+//   broker up|down         change the broker reachability
+//   tls <handshake ms> <handshake heap> <session heap> [sha1 fingerprint]
+//                          the broker only takes TLS from now on, "tls off"
+//                          goes back to plain text
+//   soak <s> [cmd/s] [codes/min] [report s] [seed]
+//                          load/soak run for <s> seconds of virtual time
+//                          (defaults 100 commands/s, 6 codes/min, report
+//                          every 600 s), see NativeSoak.h
+//   http <path> [port] [send ms] [read bytes/ms]
+//                          GET from the device's web server (port 80), runs
+//                          loop() until it answers, at most for 1 s. A slow
+//                          client takes <send ms> for the request and reads
+//                          the response at <read bytes/ms> (0: at once)
+//   replay <file> [led tolerance ms]
+//                          feed an event trace through the firmware and
+//                          check its outputs, see NativeReplay.h
+//   quit                   stop here
+//
+// Every publish of the device is printed on stdout as "PUB <topic> <payload>",
+// every HTTP response as "HTTP <path> <code> <type> <bytes> <chunks>" and its body,
+// the Serial output goes to stderr. "-q" silences the PUB lines, "-n <n>"
+// runs <n> extra iterations after the script, e.g. for perf/valgrind.
+// "-w <scan>,<associate>,<dhcp>" sets how long joining WiFi takes at boot (ms).
+// "-b <bssid>" boots next to an access point with this BSSID instead of
+// 02:00:00:00:00:01, e.g. one that replaced the AP of the last run.
+// "-t <file>" appends what the device publishes on its trace topic to the
+// file, i.e. the event trace dumped by the "trace" command.
+
+#include "Arduino.h"
+#include "NativeSim.h"
+#include "AsyncMqttClient.h"
+#include "NativeSoak.h"
+#include "NativeReplay.h"
+
+#include <string>
+#include <iostream>
+
+namespace {
+
+  // Wiring of the simulated board, the same as described in README.md
+  const char boardKeymap[] = "123456789*0#";
+  const uint8_t boardRowPins[] = { D1, D6, D5, D3 };
+#if defined(LED_BACKEND) && LED_BACKEND == 1
+  // LED_BACKEND_UART1 takes D4 for the strip
+  const uint8_t boardColPins[] = { D2, D0, D7 };
+#else
+  const uint8_t boardColPins[] = { D2, D0, D4 };
+#endif
+  const uint16_t boardLeds = 4;
+
+  bool soakFailed = false;
+  uint32_t httpResponses = 0;
+  FILE *traceFile = nullptr;
+
+  bool parseBssid(const char *text, uint8_t bssid[6]) {
+    unsigned int octets[6];
+    if (sscanf(text, "%x:%x:%x:%x:%x:%x", &octets[0], &octets[1], &octets[2], &octets[3], &octets[4], &octets[5]) != 6) {
+      return false;
+    }
+    for (int i = 0; i < 6; i++) {
+      bssid[i] = (uint8_t)octets[i];
+    }
+    return true;
+  }
+
+  void runLoop() {
+    loop();
+    NativeSim::counters().loops++;
+    NativeSim::pump();
+  }
+
+  void runFor(unsigned long ms) {
+    unsigned long end = millis() + ms;
+    while ((long)(end - millis()) > 0) {
+      NativeSim::advance(1);
+      runLoop();
+    }
+  }
+
+  bool execute(const std::string &line) {
+    size_t split = line.find(' ');
+    std::string command = line.substr(0, split);
+    std::string args = split == std::string::npos ? "" : line.substr(split + 1);
+
+    if (command.empty() || command[0] == ';') {
+      return true;
+    } else if (command == "key") {
+      for (char key : args) {
+        NativeSim::pressKey(key);
+      }
+      while (NativeSim::pendingKeys() > 0) {
+        runFor(1);
+      }
+      runFor(50);
+    } else if (command == "keytiming") {
+      unsigned long hold = 80, gap = 40, bounce = 0;
+      sscanf(args.c_str(), "%lu %lu %lu", &hold, &gap, &bounce);
+      NativeSim::setKeyTiming(hold, gap, bounce);
+    } else if (command == "msg") {
+      size_t space = args.find(' ');
+      std::string topic = args.substr(0, space);
+      std::string payload = space == std::string::npos ? "" : args.substr(space + 1);
+      NativeSim::deliver(topic.c_str(), payload.c_str());
+      runLoop();
+    } else if (command == "fragment") {
+      AsyncMqttClient::nativeSetFragmentSize(strtoul(args.c_str(), NULL, 10));
+    } else if (command == "wait") {
+      runFor(strtoul(args.c_str(), NULL, 10));
+    } else if (command == "loops") {
+      for (unsigned long n = strtoul(args.c_str(), NULL, 10); n > 0; n--) {
+        runLoop();
+      }
+    } else if (command == "leds") {
+      printf("LEDS");
+      for (uint16_t i = 0; i < boardLeds; i++) {
+        printf(" %06x", NativeSim::ledColor(i));
+      }
+      printf("\n");
+    } else if (command == "wifi") {
+      NativeSim::setWiFiConnected(args == "up");
+      runLoop();
+    } else if (command == "ap") {
+      uint8_t bssid[6];
+      if (parseBssid(args.c_str(), bssid)) {
+        NativeSim::setAccessPoint(bssid);
+      }
+      runLoop();
+    } else if (command == "broker") {
+      NativeSim::setBrokerReachable(args == "up");
+      runLoop();
+    } else if (command == "tls") {
+      NativeSim::BrokerTls tls = NativeSim::BrokerTls();
+      char fingerprint[64] = "";
+      tls.enabled = args != "off";
+      sscanf(args.c_str(), "%lu %zu %zu %63s", &tls.handshakeMs, &tls.handshakeHeap, &tls.sessionHeap, fingerprint);
+      size_t n = 0;
+      for (const char *c = fingerprint; *c != 0 && c[1] != 0 && n < sizeof(tls.fingerprint); c++) {
+        if (*c != ':' && sscanf(c, "%2hhx", &tls.fingerprint[n]) == 1) {
+          n++;
+          c++;
+        }
+      }
+      NativeSim::setBrokerTls(tls);
+    } else if (command == "soak") {
+      unsigned long seconds = 60, commands = 100, codes = 6, report = 600, seed = 1;
+      sscanf(args.c_str(), "%lu %lu %lu %lu %lu", &seconds, &commands, &codes, &report, &seed);
+      NativeSoak::Options options = { seconds * 1000, commands, codes, report * 1000, (uint32_t)seed };
+      if (!NativeSoak::run(options, runLoop)) {
+        soakFailed = true;
+      }
+    } else if (command == "http") {
+      char path[256] = "/";
+      unsigned int port = 80;
+      unsigned long sendMs = 0;
+      unsigned long readRate = 0;
+      sscanf(args.c_str(), "%255s %u %lu %lu", path, &port, &sendMs, &readRate);
+      uint32_t answered = httpResponses;
+      NativeSim::httpGet(port, path, sendMs, readRate);
+      for (int ms = 0; ms < 1000 && httpResponses == answered; ms++) {
+        runFor(1);
+      }
+      if (httpResponses == answered) {
+        printf("HTTP %s no answer\n", path);
+      }
+    } else if (command == "replay") {
+      char path[256] = "";
+      unsigned long tolerance = 100;
+      sscanf(args.c_str(), "%255s %lu", path, &tolerance);
+      NativeReplay::Options options = { path, boardLeds, tolerance, 100 };
+      if (!NativeReplay::run(options, runLoop)) {
+        soakFailed = true;
+      }
+    } else if (command == "quit") {
+      return false;
+    } else {
+      fprintf(stderr, "native: unknown command: %s\n", line.c_str());
+    }
+    return true;
+  }
+
+}
+
+int main(int argc, char **argv) {
+  bool quiet = false;
+  unsigned long extraLoops = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-q") == 0) {
+      quiet = true;
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      extraLoops = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+      unsigned long scan = 0, associate = 0, dhcp = 0;
+      sscanf(argv[++i], "%lu,%lu,%lu", &scan, &associate, &dhcp);
+      NativeSim::setWiFiTiming(scan, associate, dhcp);
+    } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      uint8_t bssid[6];
+      if (parseBssid(argv[++i], bssid)) {
+        NativeSim::setAccessPoint(bssid);
+      }
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      traceFile = fopen(argv[++i], "ab");
+    }
+  }
+
+  if (!quiet) {
+    NativeSim::onPublish([](const char *topic, const char *payload, size_t length, uint8_t, bool) {
+      printf("PUB %s %.*s\n", topic, (int)length, payload);
+    });
+  }
+
+  NativeSim::onHttpResponse([quiet](const char *path, const NativeSim::HttpResponse &response) {
+    httpResponses++;
+    if (response.dropped) {
+      printf("HTTP %s dropped by the server after %zu bytes\n", path, response.body.size());
+    } else if (!quiet) {
+      printf("HTTP %s %d %s %zu bytes, %zu chunks%s\n%s%s", path, response.code, response.type.c_str(),
+             response.body.size(), response.chunks, response.complete ? "" : ", not ended",
+             response.body.c_str(), !response.body.empty() && response.body.back() != '\n' ? "\n" : "");
+    }
+  });
+
+  if (traceFile != nullptr) {
+    NativeSim::onPublish([](const char *topic, const char *payload, size_t length, uint8_t, bool) {
+      size_t topicLength = strlen(topic);
+      if (topicLength >= 6 && strcmp(topic + topicLength - 6, "/trace") == 0) {
+        fwrite(payload, 1, length, traceFile);
+        fflush(traceFile);
+      }
+    });
+  }
+
+  NativeSim::setKeyMatrix(boardKeymap, boardRowPins, boardColPins, 4, 3);
+
+  setup();
+
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    if (!execute(line)) {
+      break;
+    }
+  }
+
+  while (extraLoops-- > 0) {
+    runLoop();
+  }
+
+  NativeSim::Counters &stats = NativeSim::counters();
+  fprintf(stderr, "native: loops=%u led_shows=%u led_masked_us=%u published=%u delivered=%u keys=%u uptime=%lums\n",
+          stats.loops, stats.ledShows, stats.ledMaskedMicros, stats.published, stats.delivered, stats.keysPressed, millis());
+  return soakFailed ? 1 : 0;
+}
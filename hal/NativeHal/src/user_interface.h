@@ -0,0 +1,9 @@
+// Host stand-in for the SDK's user_interface.h, the calls are declared
+// with the WiFi stack in ESP8266WiFi.h
+
+#ifndef NATIVE_HAL_USER_INTERFACE_H
+#define NATIVE_HAL_USER_INTERFACE_H
+
+#include "ESP8266WiFi.h"
+
+#endif // NATIVE_HAL_USER_INTERFACE_H
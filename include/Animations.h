@@ -0,0 +1,15 @@
+#ifndef ANIMATIONS_H
+#define ANIMATIONS_H
+
+#include "Animator.h"
+
+// The LED sequences of the keypad, keyframe tables in flash
+extern const Animation ANIM_BOOT;      // white while initializing
+extern const Animation ANIM_WAITING;   // blue scanner until the broker is connected
+extern const Animation ANIM_OFFLINE;   // amber scanner while the WiFi link is down
+extern const Animation ANIM_LOCK;      // red, one LED after the other goes out over the lock
+extern const Animation ANIM_ACCEPT;    // green, then fades out
+extern const Animation ANIM_REJECT;    // three red flashes
+extern const Animation ANIM_QUEUED;    // amber, then fades out: held until the broker is back
+
+#endif // ANIMATIONS_H
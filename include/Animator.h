@@ -0,0 +1,79 @@
+#ifndef ANIMATOR_H
+#define ANIMATOR_H
+
+#include <Arduino.h>
+
+#include "LedCompositor.h"
+
+// A point of an animation, stored in PROGMEM. The level is interpolated
+// linearly up to the next keyframe, two keyframes 1ms apart make a step.
+struct Keyframe {
+  uint16_t time;    // ms since the start, ascending, the first one at 0
+  uint8_t level;    // 0..255, scales the colour of the animation
+};
+
+// How the keyframes are laid over the pixels
+enum AnimationFlags {
+  ANIM_LOOP = 0x01,     // start over after the last keyframe
+  ANIM_HOLD = 0x02,     // keep the last frame when done, else the layer is released
+  ANIM_SWEEP = 0x04,    // a pixel every step ms, there and back (loops)
+  ANIM_STAGGER = 0x08   // the pixels one after the other, last pixel first, step ms apart
+};
+
+// An animation, stored in PROGMEM
+struct Animation {
+  const Keyframe *frames;
+  uint8_t count;
+  uint8_t flags;
+  uint16_t step;        // ms between two pixels for ANIM_SWEEP and ANIM_STAGGER
+  uint32_t color;       // at level 255
+};
+
+/*
+ * Plays keyframe animations on the layers of the compositor. A layer is
+ * only rendered again when its next frame is due: at the next keyframe for
+ * a steady level, every ANIMATION_FRAME_MS while the level moves.
+ * Driven from loop().
+ */
+class Animator {
+  public:
+    explicit Animator(LedCompositor &leds);
+
+    // Activate the layer with the animation, stretched to length ms if
+    // given. Replaces what the layer was playing.
+    void play(LedCompositor::Layer layer, const Animation *animation, uint32_t length = 0);
+    // Release the layer
+    void stop(LedCompositor::Layer layer);
+    bool isPlaying(LedCompositor::Layer layer) const { return tracks[layer].playing; }
+
+    // Render the layers which are due
+    void update(uint32_t now);
+
+    // ms until the next frame, at most cap
+    uint32_t timeUntilNext(uint32_t now, uint32_t cap) const;
+
+    // Frames rendered since boot
+    uint32_t renders() const { return renderCount; }
+
+  private:
+    struct Track {
+      Animation animation;   // copied out of PROGMEM
+      uint32_t start;
+      uint32_t length;       // ms as played
+      uint32_t natural;      // ms of the keyframes
+      uint32_t due;
+      bool playing;
+    };
+
+    void render(LedCompositor::Layer layer, uint32_t now);
+    uint8_t pixelLevel(const Animation &animation, uint8_t pixel, uint32_t t, uint32_t natural,
+                       uint32_t &wait, bool &moving) const;
+    static uint8_t sample(const Animation &animation, uint32_t t, uint32_t &wait, bool &moving);
+    static uint32_t naturalLength(const Animation &animation);
+
+    LedCompositor &leds;
+    Track tracks[LedCompositor::LAYER_COUNT];
+    uint32_t renderCount;
+};
+
+#endif // ANIMATOR_H
@@ -0,0 +1,40 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <stdint.h>
+
+#include "JsonWriter.h"
+
+/*
+ * When each boot phase completed, in ms since power on. Published once with
+ * the first state document to follow the time until the keypad is usable.
+ */
+class BootTimeline {
+  public:
+    enum Phase {
+      PHASE_CONFIG = 0,   // configuration loaded
+      PHASE_WIFI,         // associated with the access point
+      PHASE_IP,           // address obtained (DHCP or static)
+      PHASE_MQTT,         // connected to the broker
+      PHASE_COUNT
+    };
+
+    BootTimeline();
+
+    // Only the first completion of a phase is kept, safe from the SDK callbacks
+    void mark(Phase phase, uint32_t now);
+    // The cached access point was joined without the WiFiManager
+    void setFastPath(bool fast) { fastPath = fast; }
+
+    // Not published yet
+    bool isPending() const { return !published; }
+    // Write the phases, once
+    void write(JsonWriter &json);
+
+  private:
+    volatile uint32_t times[PHASE_COUNT];
+    bool fastPath;
+    bool published;
+};
+
+#endif // BOOT_TIMELINE_H
@@ -0,0 +1,61 @@
+#ifndef CODE_CACHE_H
+#define CODE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "Sha256.h"
+
+/*
+ * Local list of the valid codes, to give feedback on the keypad before the
+ * alarm answers. The codes arrive as salted hashes on a retained topic:
+ *
+ *   {"salt":"<hex>","codes":["<hex16>", ...]}
+ *
+ * where each code is the first 8 bytes of HMAC-SHA256(key, salt bytes +
+ * code digits). With 4 digit codes a plain hash is reversed by trying them
+ * all, the key (CODE_CACHE_KEY, known to the device and the publisher only)
+ * keeps the list useless to anyone else reading the topic. Without a key
+ * no list is taken.
+ * They are kept as a sorted array of 8 byte hashes. A check always hashes
+ * once and compares against every slot, so its duration does not depend on
+ * the code or on where it is stored.
+ * This is a hint for the user only, the alarm still decides on the code
+ * published upstream.
+ */
+class CodeCache {
+  public:
+    static const size_t BYTES_PER_CODE = sizeof(uint64_t);
+
+    CodeCache();
+
+    // Set the key from hex, false if it is missing or invalid
+    bool setKey(const char *hex);
+    bool hasKey() const { return keyed; }
+
+    // Replace the cache from a document parsed in place, an empty payload
+    // clears it. Returns false (and clears) if the document is invalid.
+    bool load(char *payload);
+    void clear();
+
+    bool isLoaded() const { return count > 0; }
+    uint8_t size() const { return count; }
+
+    bool verify(const char *code, size_t length) const;
+
+  private:
+    uint64_t hash(const char *code, size_t length) const;
+
+    // HMAC states with the padded key already hashed
+    Sha256 inner;
+    Sha256 outer;
+    bool keyed;
+
+    uint8_t salt[CODE_CACHE_SALT_SIZE];
+    uint8_t saltLength;
+    uint64_t codes[CODE_CACHE_MAX];
+    uint8_t count;
+};
+
+#endif // CODE_CACHE_H
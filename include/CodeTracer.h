@@ -0,0 +1,58 @@
+#ifndef CODE_TRACER_H
+#define CODE_TRACER_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "JsonWriter.h"
+#include "LatencyHistogram.h"
+
+/*
+ * Follows a code from the keypad to the reaction of the alarm. Each traced
+ * code gets an ID which is published with it. Three latencies are kept:
+ *   entry: first key press to '#', the time the user needed
+ *   ack:   code queued to the PUBACK of the broker
+ *   state: code queued to the next change of the alarm state
+ * The alarm does not echo the ID, the oldest pending code is taken as the
+ * cause of a state change. Codes without a change are dropped after
+ * CODE_TRACE_TIMEOUT.
+ */
+class CodeTracer {
+  public:
+    CodeTracer();
+
+    // The ID the next traced code gets
+    uint16_t nextId() const { return nextTraceId; }
+
+    // The code with nextId() was queued as outbox message seq
+    void begin(uint32_t entryMs, uint32_t seq, uint32_t now);
+    // The broker acknowledged the outbox message seq
+    void acknowledged(uint32_t seq, uint32_t now);
+    // A live message on the alarm state topic
+    void stateChanged(uint32_t now);
+
+    // Write the histograms and counters
+    void write(JsonWriter &json, uint32_t now);
+
+    uint32_t lastStateLatency() const { return stateLatency.last(); }
+
+  private:
+    struct Trace {
+      bool active;
+      bool acked;
+      uint16_t id;
+      uint32_t seq;
+      uint32_t queuedAt;
+    };
+
+    void expire(uint32_t now);
+
+    Trace pending[CODE_TRACE_PENDING];
+    uint16_t nextTraceId;
+    uint32_t unmatched;
+    LatencyHistogram entryLatency;
+    LatencyHistogram ackLatency;
+    LatencyHistogram stateLatency;
+};
+
+#endif // CODE_TRACER_H
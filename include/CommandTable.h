@@ -0,0 +1,54 @@
+#ifndef COMMAND_TABLE_H
+#define COMMAND_TABLE_H
+
+#include <stddef.h>
+#include <string.h>
+
+#include <ArduinoJson.h>
+
+// A command received on the command topic, e.g. {"command":"lock","duration":20}.
+// The handler gets the whole document to read its arguments from.
+typedef void (*CommandHandler)(JsonObject &args);
+
+struct Command {
+  const char *name;
+  CommandHandler handler;
+};
+
+// compile-time helpers to check that a table is sorted by name
+constexpr bool commandNameLess(const char *a, const char *b) {
+  return (*a == *b) ? (*a != 0 && commandNameLess(a + 1, b + 1)) : (*a < *b);
+}
+
+template<size_t N>
+constexpr bool commandsSorted(const Command (&table)[N], size_t i = 1) {
+  return i >= N || (commandNameLess(table[i - 1].name, table[i].name) && commandsSorted(table, i + 1));
+}
+
+// Binary search in a table sorted by name, NULL if the command is unknown
+template<size_t N>
+const Command *findCommand(const Command (&table)[N], const char *name) {
+  size_t low = 0;
+  size_t high = N;
+  while (low < high) {
+    size_t mid = (low + high) / 2;
+    int cmp = strcmp(name, table[mid].name);
+    if (cmp == 0) {
+      return &table[mid];
+    }
+    if (cmp < 0) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+  return NULL;
+}
+
+// Typed argument with a default when it is missing
+template<typename T>
+T commandArgument(JsonObject &args, const char *key, T defaultValue) {
+  return args.containsKey(key) ? args[key].as<T>() : defaultValue;
+}
+
+#endif // COMMAND_TABLE_H
@@ -0,0 +1,62 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+
+#include "config.h"
+
+// The settings entered in the configuration portal
+struct DeviceConfig {
+  char mqttServer[CONFIG_MQTT_SERVER_LEN + 1];
+  char mqttPort[CONFIG_MQTT_PORT_LEN + 1];
+  char mqttLogin[CONFIG_MQTT_LOGIN_LEN + 1];
+  char mqttPassword[CONFIG_MQTT_PASSWORD_LEN + 1];
+};
+
+// Copy a string into a fixed field, truncated and always terminated
+template<size_t N>
+void copyConfigField(char (&field)[N], const char *value) {
+  if (value == NULL) {
+    value = "";
+  }
+  strncpy(field, value, N - 1);
+  field[N - 1] = 0;
+}
+
+/*
+ * Keeps the configuration as a fixed-layout binary record in the EEPROM
+ * sector: a header (magic, schema version, payload size), the DeviceConfig
+ * fields and a CRC32. Loading is a copy and a checksum, no file system and
+ * no JSON parser are needed at boot.
+ * When there is no valid record the legacy /config.json is read once,
+ * written as a record and removed.
+ */
+class ConfigStore {
+  public:
+    enum Source {
+      SOURCE_DEFAULTS = 0,   // nothing stored, config left untouched
+      SOURCE_RECORD,         // the binary record
+      SOURCE_JSON            // migrated from /config.json
+    };
+
+    ConfigStore();
+
+    Source load(DeviceConfig &config);
+    bool save(const DeviceConfig &config);
+
+    // Cost of the last load()
+    uint32_t loadTime() const { return loadMicros; }   // us
+    uint32_t loadHeap() const { return heapUsed; }     // bytes no longer free afterwards
+    Source source() const { return loadedFrom; }
+    static const char *sourceName(Source source);
+
+  private:
+    bool readRecord(DeviceConfig &config);
+    bool readJson(DeviceConfig &config);
+
+    uint32_t loadMicros;
+    uint32_t heapUsed;
+    Source loadedFrom;
+};
+
+#endif // CONFIG_STORE_H
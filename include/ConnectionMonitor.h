@@ -0,0 +1,69 @@
+#ifndef CONNECTION_MONITOR_H
+#define CONNECTION_MONITOR_H
+
+#include <stdint.h>
+
+#include "JsonWriter.h"
+
+/*
+ * Follows the WiFi link and the broker session while the keypad keeps
+ * working offline. Measures the WiFi outages and the time to get back to
+ * the broker once the link is up, tells when to rescan for the access
+ * point and when the device has been offline long enough to restart.
+ * Driven from loop().
+ */
+class ConnectionMonitor {
+  public:
+    ConnectionMonitor(uint32_t rescanPeriod, uint32_t restartTimeout);
+
+    // Poll the current state. Returns true when the WiFi link just came back.
+    bool update(uint32_t now, bool wifiUp, bool brokerUp);
+
+    bool isWiFiUp() const { return wifiUp; }
+    bool isOnline() const { return brokerUp; }
+    // ms without the broker (0 while connected)
+    uint32_t offlineFor(uint32_t now) const { return brokerUp ? 0 : now - offlineSince; }
+
+    // True once per rescan period while the link is down
+    bool shouldRescan(uint32_t now);
+    // True when the device has been offline for the restart timeout
+    bool shouldRestart(uint32_t now) const { return restartTimeout != 0 && offlineFor(now) >= restartTimeout; }
+
+    // A code was entered while offline, or expired before it could be sent
+    void codeBuffered() { buffered++; }
+    void codesExpired(uint32_t count) { expired += count; }
+
+    // Statistics, since boot
+    uint32_t outages() const { return outageCount; }              // WiFi link lost
+    uint32_t lastOutage() const { return lastOutageTime; }        // ms, link lost to link up
+    uint32_t maxOutage() const { return maxOutageTime; }
+    uint32_t lastRecovery() const { return lastRecoveryTime; }    // ms, link up to broker connected
+    uint32_t bufferedCodes() const { return buffered; }
+    uint32_t expiredCodes() const { return expired; }
+
+    // Anything to report: an outage happened or codes were held
+    bool hasHistory() const { return outageCount > 0 || buffered > 0; }
+    // The statistics as fields of the state document
+    void write(JsonWriter &json) const;
+
+  private:
+    const uint32_t rescanPeriod;
+    const uint32_t restartTimeout;
+
+    bool wifiUp;
+    bool brokerUp;
+    bool recovering;      // the link is back, the broker not yet
+    uint32_t wifiLostAt;
+    uint32_t wifiUpAt;
+    uint32_t offlineSince;
+    uint32_t lastRescan;
+
+    uint32_t outageCount;
+    uint32_t lastOutageTime;
+    uint32_t maxOutageTime;
+    uint32_t lastRecoveryTime;
+    uint32_t buffered;
+    uint32_t expired;
+};
+
+#endif // CONNECTION_MONITOR_H
@@ -0,0 +1,21 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32 (IEEE), bitwise: only used on small records read once per boot.
+// Chain blocks by passing the previous result as crc.
+inline uint32_t computeCrc32(const void *data, size_t length, uint32_t crc = 0) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  crc = ~crc;
+  while (length--) {
+    crc ^= *bytes++;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+#endif // CRC32_H
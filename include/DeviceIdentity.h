@@ -0,0 +1,50 @@
+#ifndef DEVICE_IDENTITY_H
+#define DEVICE_IDENTITY_H
+
+#include <Arduino.h>
+
+#include "config.h"
+
+/*
+ * What sets this keypad apart in a fleet: its MQTT topics, optionally
+ * prefixed with the chip ID, and a hash of the MAC used to spread the
+ * periodic work of the devices over time.
+ */
+class DeviceIdentity {
+  public:
+    DeviceIdentity();
+
+    // Read the chip ID and the MAC, build the topics. Called once from setup().
+    void begin();
+
+    const char *stateTopic() const { return topicState; }
+    const char *codeTopic() const { return topicCode; }
+    const char *commandTopic() const { return topicCommand; }
+    const char *metricsTopic() const { return topicMetrics; }
+    const char *statusTopic() const { return topicStatus; }
+    const char *deltaTopic() const { return topicDelta; }
+    const char *codesTopic() const { return topicCodes; }
+    const char *logTopic() const { return topicLog; }
+    const char *latencyTopic() const { return topicLatency; }
+    const char *traceTopic() const { return topicTrace; }
+
+    // A stable offset in [0, period) that differs from device to device
+    uint32_t phase(uint32_t period) const { return period > 0 ? hash % period : 0; }
+
+  private:
+    void buildTopic(char *topic, const char *prefix, const char *suffix);
+
+    uint32_t hash;
+    char topicState[MQTT_TOPIC_SIZE];
+    char topicCode[MQTT_TOPIC_SIZE];
+    char topicCommand[MQTT_TOPIC_SIZE];
+    char topicMetrics[MQTT_TOPIC_SIZE];
+    char topicStatus[MQTT_TOPIC_SIZE];
+    char topicDelta[MQTT_TOPIC_SIZE];
+    char topicCodes[MQTT_TOPIC_SIZE];
+    char topicLog[MQTT_TOPIC_SIZE];
+    char topicLatency[MQTT_TOPIC_SIZE];
+    char topicTrace[MQTT_TOPIC_SIZE];
+};
+
+#endif // DEVICE_IDENTITY_H
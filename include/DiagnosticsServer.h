@@ -0,0 +1,99 @@
+#ifndef DIAGNOSTICS_SERVER_H
+#define DIAGNOSTICS_SERVER_H
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+
+#include "config.h"
+
+// How a value is exported
+enum DiagnosticType {
+  DIAG_GAUGE = 0,
+  DIAG_COUNTER,     // "_total" is appended for Prometheus
+  DIAG_TEXT,        // a label of keypad_info for Prometheus
+  DIAG_SIGNED       // a gauge below zero, read as int32_t cast to uint32_t
+};
+
+// A value of the diagnostics endpoint, the tables are stored in PROGMEM
+struct DiagnosticField {
+  char name[24];    // JSON key, "keypad_" + name for Prometheus
+  char help[48];
+  uint8_t type;
+  uint8_t id;       // passed to the reader
+};
+
+// Read the value of a field by its id. Text is formatted into the buffer
+// or returned directly if it is already in RAM.
+typedef uint32_t (*DiagnosticNumber)(uint8_t id);
+typedef const char *(*DiagnosticText)(uint8_t id, char *buffer, size_t size);
+
+// ESP8266WebServer reads a request with blocking reads under the timeout of
+// the client, 5 s unless set, from loop(). This one accepts the client
+// itself to give it a short timeout before the first read.
+class DiagnosticsWebServer : public ESP8266WebServer {
+  public:
+    DiagnosticsWebServer(uint16_t port, uint32_t timeout) : ESP8266WebServer(port), timeout(timeout) {}
+    // Returns whether a client was served, dropped or waited for
+    bool handleClient();
+
+  private:
+    uint32_t timeout;
+};
+
+/*
+ * Local HTTP endpoint for monitoring without the broker:
+ *   GET /status   the fields as one flat JSON object
+ *   GET /metrics  the same in the Prometheus text format
+ * Responses are streamed with chunked transfer encoding out of a fixed
+ * buffer, the field names and help texts come from flash. Nothing is built
+ * up in a String. Driven from loop(), one request per call; a client that
+ * takes longer than DIAG_HTTP_TIMEOUT ms to send its request, or to read
+ * the response, is dropped.
+ */
+class DiagnosticsServer {
+  public:
+    DiagnosticsServer(uint16_t port, const DiagnosticField *fields, size_t count,
+                      DiagnosticNumber number, DiagnosticText text);
+
+    void begin();
+    // Close the port, e.g. for the configuration portal
+    void stop();
+    // Serve a waiting request, if any
+    void handle();
+
+    // Statistics
+    uint32_t requests() const { return requestCount; }
+    uint32_t lastServeTime() const { return lastServe; }   // us, dropped clients included
+    uint32_t maxServeTime() const { return maxServe; }
+
+  private:
+    void serveStatus();
+    void serveMetrics();
+    void serveNotFound();
+
+    void beginResponse(const char *type);
+    void endResponse();
+    void write(const char *data, size_t length);
+    void writeP(const char *text);   // from flash
+    void writeNumber(uint32_t value, bool isSigned);
+    void writeEscaped(const char *text);
+    void flush();
+
+    DiagnosticsWebServer server;
+    const DiagnosticField *fields;
+    size_t count;
+    DiagnosticNumber number;
+    DiagnosticText text;
+
+    char chunk[DIAG_HTTP_CHUNK_SIZE];
+    size_t chunkLength;
+    bool aborted;     // the client is gone, the rest of the response is skipped
+    unsigned long responseStart;   // ms
+    bool running;
+
+    uint32_t requestCount;
+    uint32_t lastServe;
+    uint32_t maxServe;
+};
+
+#endif // DIAGNOSTICS_SERVER_H
@@ -0,0 +1,90 @@
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+
+/*
+ * Records what the keypad went through, for a replay in virtual time on the
+ * host (hal/NativeHal/src/NativeReplay.cpp). Inputs (key presses, messages
+ * from the broker, connection changes) are replayed, outputs (codes, LED
+ * frames) are what the replay checks against.
+ *
+ * The format is a byte stream:
+ *
+ *   header  'K' 'P' 'T' version  start time (4 bytes, little endian, ms)
+ *           LED hold (1 byte, ms)  random seed (4 bytes)
+ *   record  type  delta (ms since the previous record)  body
+ *
+ * Lengths and numbers are unsigned LEB128 varints, so most records take
+ * 3 to 7 bytes. Recording stops at the first record that does not fit,
+ * the trace is always a complete prefix.
+ * Only LED frames that stayed on the strip for the LED hold time are
+ * recorded, when they are replaced: the steps of a fade depend on the ms
+ * they were rendered at and would not compare. The seed of random() is
+ * recorded for the reconnect delays to repeat.
+ * The codes are not recorded: every digit of a key press or a code is
+ * written as MASKED_KEY, '*' and '#' are kept. The replay enters the
+ * masked code and gets the same masked code back.
+ */
+class EventTrace {
+  public:
+    static const uint8_t VERSION = 1;
+    static const uint8_t HEADER_SIZE = 13;
+    static const char MASKED_KEY = '0';
+
+    enum Type {
+      KEY = 1,       // key                     contact closed
+      MESSAGE,       // topic, total, chunk     first chunk of a message
+      MESSAGE_DATA,  // chunk                   next chunk of that message
+      CONNECT,       //                         connected to the broker
+      DISCONNECT,    // reason (1 byte)
+      CODE,          // digits                  code queued for publishing
+      LEDS           // checksum (4 bytes, LE)  a held frame was replaced
+    };
+
+    EventTrace();
+
+    // Clear the buffer and record from now on, followed by a leds() call
+    // for the frame on the strip. seed was just given to randomSeed().
+    void start(uint32_t now, uint32_t seed);
+    void stop() { recording = false; }
+    bool isRecording() const { return recording; }
+
+    void key(uint32_t time, char key);
+    void message(uint32_t now, const char *topic, const char *chunk, size_t length, size_t index, size_t total);
+    void connected(uint32_t now);
+    void disconnected(uint32_t now, uint8_t reason);
+    void code(uint32_t now, const char *digits, size_t length);
+    // A new frame went to the strip
+    void leds(uint32_t now, uint32_t checksum);
+
+    const uint8_t *data() const { return buffer; }
+    size_t size() const { return length; }
+    // Recording stopped because the buffer ran out
+    bool isFull() const { return full; }
+
+    // FNV-1a over the R, G, B bytes of every pixel, the replay computes the
+    // same over the decoded frame
+    static uint32_t frameChecksum(const uint32_t *colors, uint8_t count);
+
+  private:
+    static char mask(char key);
+    // Write the record header if size more bytes fit after it
+    bool begin(Type type, uint32_t time, size_t size);
+    void putVarint(uint32_t value);
+    void putBytes(const void *bytes, size_t count);
+    static size_t varintSize(uint32_t value);
+
+    uint8_t buffer[EVENT_TRACE_SIZE];
+    size_t length;
+    uint32_t lastTime;
+    uint32_t frame;        // checksum of the frame on the strip
+    uint32_t frameSince;
+    bool recording;
+    bool full;
+};
+
+#endif // EVENT_TRACE_H
@@ -0,0 +1,56 @@
+#ifndef IDLE_MANAGER_H
+#define IDLE_MANAGER_H
+
+#include <Arduino.h>
+
+#include "KeyScanner.h"
+
+/*
+ * Puts the keypad to sleep after a period without key presses: the scan
+ * stops until a row interrupt, WiFi drops to light sleep between beacons
+ * (the association and the MQTT session are kept) and loop() may wait
+ * longer between iterations. The LEDs are blanked by the caller.
+ * Driven from loop().
+ */
+class IdleManager {
+  public:
+    IdleManager(KeyScanner &keypad, uint32_t timeout);
+
+    // A key press was handled, measures the wake latency if it woke us
+    void keyRegistered(uint32_t now);
+
+    // Enter or leave the idle mode. canSleep is false while something is
+    // shown or pending, it keeps the device awake.
+    void update(uint32_t now, bool canSleep);
+
+    bool isIdle() const { return idle; }
+
+    // Time waited in delay() while idle
+    void slept(uint32_t ms) { if (idle) { asleep += ms; } }
+
+    // Statistics
+    uint32_t wakeups() const { return wakeCount; }                 // by a key, since boot
+    uint32_t lastWakeLatency() const { return lastLatency; }       // wake interrupt to key registered, ms
+    uint32_t maxWakeLatency() const { return maxLatency; }
+    // Share of the time spent asleep since the last call, in percent
+    uint8_t asleepPercent(uint32_t now);
+
+  private:
+    void checkWake(uint32_t now);
+    void enter(uint32_t now);
+    void leave();
+
+    KeyScanner &keypad;
+    uint32_t timeout;
+    bool idle;
+    bool wakePending;     // woken by a key, waiting for it to be registered
+    uint32_t lastActivity;
+
+    uint32_t wakeCount;
+    uint32_t lastLatency;
+    uint32_t maxLatency;
+    uint32_t asleep;
+    uint32_t intervalStart;
+};
+
+#endif // IDLE_MANAGER_H
@@ -0,0 +1,121 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Writes a flat JSON object straight into a caller supplied buffer,
+ * without building a document tree first.
+ * Once the buffer overflows every call is ignored and end() returns 0.
+ */
+class JsonWriter {
+  public:
+    JsonWriter(char *_buffer, size_t _size) : buffer(_buffer), size(_size), length(0), fields(0), overflow(false) {
+      append("{", 1);
+    }
+
+    // Copy a preformatted fragment of fields ("key":value,...) without braces
+    void addRaw(const char *fragment, size_t len) {
+      if (len == 0) {
+        return;
+      }
+      separator();
+      append(fragment, len);
+    }
+
+    void add(const char *key, const char *value) {
+      beginField(key);
+      append("\"", 1);
+      for (const char *c = value; *c != 0 && !overflow; c++) {
+        if ((uint8_t)*c < 0x20) {
+          // control characters are not allowed in a JSON string
+          char escaped[7];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned int)*c);
+          append(escaped, 6);
+          continue;
+        }
+        if (*c == '"' || *c == '\\') {
+          append("\\", 1);
+        }
+        append(c, 1);
+      }
+      append("\"", 1);
+    }
+
+    void add(const char *key, long value) {
+      char number[24];    // a 64-bit long on the native build
+      int len = snprintf(number, sizeof(number), "%ld", value);
+      beginField(key);
+      append(number, len);
+    }
+
+    void add(const char *key, unsigned long value) {
+      char number[24];    // a 64-bit long on the native build
+      int len = snprintf(number, sizeof(number), "%lu", value);
+      beginField(key);
+      append(number, len);
+    }
+
+    void add(const char *key, int value) { add(key, (long)value); }
+    void add(const char *key, unsigned int value) { add(key, (unsigned long)value); }
+
+    void addArray(const char *key, const uint32_t *values, size_t count) {
+      char number[12];
+      beginField(key);
+      append("[", 1);
+      for (size_t i = 0; i < count; i++) {
+        int len = snprintf(number, sizeof(number), i ? ",%lu" : "%lu", (unsigned long)values[i]);
+        append(number, len);
+      }
+      append("]", 1);
+    }
+
+    void add(const char *key, bool value) {
+      beginField(key);
+      append(value ? "true" : "false", value ? 4 : 5);
+    }
+
+    // Close the object. Returns its length, 0 if it did not fit.
+    size_t end() {
+      append("}", 1);
+      if (overflow || length >= size) {
+        return 0;
+      }
+      buffer[length] = 0;
+      return length;
+    }
+
+  private:
+    void separator() {
+      if (fields++ > 0) {
+        append(",", 1);
+      }
+    }
+
+    void beginField(const char *key) {
+      separator();
+      append("\"", 1);
+      append(key, strlen(key));
+      append("\":", 2);
+    }
+
+    void append(const char *data, size_t len) {
+      if (overflow || length + len >= size) {
+        overflow = true;
+        return;
+      }
+      memcpy(buffer + length, data, len);
+      length += len;
+    }
+
+    char *buffer;
+    size_t size;
+    size_t length;
+    uint16_t fields;
+    bool overflow;
+};
+
+#endif // JSON_WRITER_H
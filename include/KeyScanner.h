@@ -0,0 +1,86 @@
+#ifndef KEY_SCANNER_H
+#define KEY_SCANNER_H
+
+#include <Arduino.h>
+
+#include "SpscQueue.h"
+
+struct KeyEvent {
+  char key;
+  uint32_t time;   // millis() when the contact closed
+};
+
+/*
+ * Scans the keypad matrix from the timer1 interrupt, debounces it and
+ * queues key presses with their timestamp for the main loop.
+ * The scan rate is fast while a code is being entered and slow when idle.
+ * There can only be one scanner since it owns timer1.
+ * While asleep the timer is stopped and all the columns are held low, the
+ * first key press pulls its row low and the row interrupt restarts the scan.
+ *
+ * Row interrupt modes:
+ *   awake          none, the timer scans
+ *   sleep()        each row low level with the GPIO wakeup, the SDK turns
+ *                  the FALLING edge of attachInterrupt() into that; only a
+ *                  level brings the CPU out of light sleep
+ *   first entry    the ISR turns the rows' interrupts off, a level one would
+ *                  fire again for as long as the key is held
+ *   wake()         detached, the GPIO wakeup disabled
+ */
+class KeyScanner {
+  public:
+    KeyScanner(const char *keymap, const byte *rowPins, const byte *colPins, byte rows, byte cols);
+
+    // Configure the pins and start the timer
+    void begin();
+
+    // Ask for the fast scan rate, e.g. while a code is being entered
+    void setFastScan(bool fast) { fastRequested = fast; }
+
+    // Take the next key press, returns false if there is none
+    bool getEvent(KeyEvent &event) { return events.pop(event); }
+    bool hasEvents() const { return !events.isEmpty(); }
+
+    // Stop scanning until a key is pressed
+    void sleep();
+    // Resume scanning, also releases the row interrupts after a key wake
+    void wake();
+    bool isSleeping() const { return sleeping; }
+    // millis() of the key press that ended the last sleep
+    uint32_t wokeAt() const { return wakeTime; }
+
+    uint32_t droppedEvents() const { return events.droppedCount(); }
+    uint32_t scanCount() const { return scans; }
+    uint32_t lastActivity() const { return changedAt; }
+
+  private:
+    static void onTimer();
+    static void onRowInterrupt();
+    void disarmRows();
+    void scan();
+    void startTimer();
+    void releaseColumns();
+    void setPeriod(uint16_t ms);
+
+    const char *keymap;
+    const byte *rowPins;
+    const byte *colPins;
+    byte rows;
+    byte cols;
+
+    SpscQueue<KeyEvent, 16> events;
+
+    volatile bool fastRequested;
+    uint16_t period;      // current scan period in ms
+    uint16_t raw;         // last sample, one bit per key
+    uint16_t debounced;   // stable state
+    volatile uint32_t changedAt;
+    volatile uint32_t scans;
+    volatile bool sleeping;
+    bool rowInterrupts;   // the row interrupts are attached
+    volatile uint32_t wakeTime;
+
+    static KeyScanner *instance;
+};
+
+#endif // KEY_SCANNER_H
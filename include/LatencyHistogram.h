@@ -0,0 +1,40 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "JsonWriter.h"
+
+/*
+ * Rolling histogram of a latency in ms. The buckets are halved once they
+ * hold LATENCY_WINDOW samples, so the older samples fade out and the
+ * percentiles follow the recent ones.
+ */
+class LatencyHistogram {
+  public:
+    static const uint8_t BUCKETS = 11;
+
+    LatencyHistogram();
+
+    void add(uint32_t ms);
+
+    // Upper bound of the bucket holding the given percentile, 0 when empty
+    uint32_t percentile(uint8_t pct) const;
+    uint32_t last() const { return lastValue; }
+    uint32_t samples() const { return count; }
+
+    // <name>_ms: [last, p50, p90, max], <name>_hist: the buckets
+    void write(JsonWriter &json, const char *name) const;
+
+    static uint32_t bucketLimit(uint8_t bucket);
+
+  private:
+    uint32_t buckets[BUCKETS];
+    uint32_t total;     // in the buckets, after the halving
+    uint32_t count;     // since boot
+    uint32_t lastValue;
+    uint32_t maxValue;
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,79 @@
+#ifndef LED_COMPOSITOR_H
+#define LED_COMPOSITOR_H
+
+#include "config.h"
+
+// The strip driver, chosen with LED_BACKEND
+#if LED_BACKEND == LED_BACKEND_UART1
+#include "Ws2812Uart.h"
+typedef Ws2812Uart LedStrip;
+#else
+#include <Adafruit_NeoPixel.h>
+typedef Adafruit_NeoPixel LedStrip;
+#endif
+
+/*
+ * Composes the LED strip out of layers and pushes a frame to the strip only
+ * when the composed result differs from what is already shown.
+ * The highest active layer owns the whole strip.
+ * A frame the strip is not ready for yet is pushed by a later update().
+ * Colours are gamma corrected and scaled by the brightness on the way out
+ * through a lookup table.
+ */
+class LedCompositor {
+  public:
+    // Layers in ascending priority
+    enum Layer {
+      LAYER_CODE = 0,   // progress of the code being entered
+      LAYER_FEEDBACK,   // the entered code was accepted/rejected locally
+      LAYER_WAITING,    // waiting for the connection to the broker
+      LAYER_ERROR,      // error or locked keypad
+      LAYER_IDLE,       // blank while the keypad sleeps
+      LAYER_BOOT,       // initialization in progress
+      LAYER_COUNT
+    };
+
+    explicit LedCompositor(LedStrip &strip);
+
+    void setPixel(Layer layer, uint8_t n, uint32_t color);
+    void fill(Layer layer, uint32_t color);
+    void setActive(Layer layer, bool active);
+    bool isActive(Layer layer) const { return active[layer]; }
+
+    // 0..255, applied to every layer from the next frame
+    void setBrightness(uint8_t brightness);
+
+    // Resolve the layers and show the frame if it changed. Called once per loop.
+    void update();
+    // Show the composed frame regardless of the dirty state.
+    void forceShow();
+
+    // Colour of pixel n in the last composed frame, as sent to the strip
+    uint32_t outputColor(uint8_t n) const;
+
+    // Profiling counters
+    uint32_t framesShown() const { return frames; }
+    uint32_t updates() const { return updateCount; }
+    // Time spent in the strip's show(), us
+    uint32_t lastShowTime() const { return lastShow; }
+    uint32_t maxShowTime() const { return maxShow; }
+
+  private:
+    bool compose();
+    void push();
+
+    LedStrip &strip;
+    uint32_t layers[LAYER_COUNT][DIGITS];
+    bool active[LAYER_COUNT];
+    uint32_t shown[DIGITS];
+    uint8_t correction[256];   // gamma and brightness
+    bool dirty;
+    bool pending;     // composed but not shown yet
+
+    uint32_t frames;
+    uint32_t updateCount;
+    uint32_t lastShow;
+    uint32_t maxShow;
+};
+
+#endif // LED_COMPOSITOR_H
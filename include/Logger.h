@@ -0,0 +1,91 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+#include "config.h"
+#include "RingBuffer.h"
+
+/*
+ * Deferred serial log. A line is formatted into a fixed queue when it is
+ * logged and written out later by drain(), only as much as the UART FIFO
+ * takes without blocking. Tags and formats stay in flash.
+ * Lines below LOG_LEVEL are removed at compile time by the LOG_* macros,
+ * their arguments are not even evaluated.
+ * A sink, e.g. the MQTT log topic, can get the lines from a given level.
+ */
+class Logger {
+  public:
+    typedef void (*Sink)(const char *line, size_t length);
+
+    Logger();
+
+    // tag and format in PROGMEM, use the LOG_* macros
+    void write(uint8_t level, const char *tag, const char *format, ...) __attribute__ ((format (printf, 4, 5)));
+    void vwrite(uint8_t level, const char *tag, const char *format, va_list args);
+
+    // Write what the UART takes without waiting, called when loop() is idle
+    void drain();
+    // Write everything, waiting for the UART, e.g. before a restart
+    void flush();
+    // Write each line right away, while setup() runs
+    void setBlocking(bool _blocking) { blocking = _blocking; if (blocking) { flush(); } }
+
+    // Lines up to this level go to the serial port (at most LOG_LEVEL)
+    void setLevel(uint8_t _level) { level = _level; }
+    uint8_t getLevel() const { return level; }
+    // Also hand the lines up to sinkLevel to the sink, LOG_LEVEL_NONE stops it
+    void setSink(Sink _sink, uint8_t _sinkLevel) { sink = _sink; sinkLevel = _sinkLevel; }
+    uint8_t getSinkLevel() const { return sinkLevel; }
+
+    uint32_t droppedLines() const { return dropped; }
+    size_t queuedLines() const { return lines.count(); }
+
+  private:
+    struct Line {
+      uint8_t level;
+      uint8_t length;
+      char text[LOG_LINE_SIZE];
+    };
+
+    bool writeFront(bool wait);
+
+    RingBuffer<Line, LOG_QUEUE_SIZE> lines;
+    uint8_t sent;          // bytes of the front line already written
+    bool frontSunk;        // the front line went to the sink
+    uint8_t level;
+    bool blocking;
+    Sink sink;
+    uint8_t sinkLevel;
+    uint32_t dropped;
+    uint32_t droppedReported;
+};
+
+extern Logger logger;
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(tag, format, ...) logger.write(LOG_LEVEL_ERROR, PSTR(tag), PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_ERROR(tag, format, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(tag, format, ...) logger.write(LOG_LEVEL_WARN, PSTR(tag), PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_WARN(tag, format, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(tag, format, ...) logger.write(LOG_LEVEL_INFO, PSTR(tag), PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_INFO(tag, format, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(tag, format, ...) logger.write(LOG_LEVEL_DEBUG, PSTR(tag), PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(tag, format, ...) do {} while (0)
+#endif
+
+#endif // LOGGER_H
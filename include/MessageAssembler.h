@@ -0,0 +1,67 @@
+#ifndef MESSAGE_ASSEMBLER_H
+#define MESSAGE_ASSEMBLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Reassembles an MQTT payload delivered in several chunks (the len, index
+// and total arguments of AsyncMqttClient::onMessage) into a fixed arena.
+// Payloads longer than N are rejected on the first chunk without copying.
+template<size_t N>
+class MessageAssembler {
+  public:
+    MessageAssembler () : received(0), expected(0), skipping(false), rejected(0) {}
+
+    // add a chunk. returns the complete null-terminated payload when the
+    // last chunk arrived, NULL otherwise. The payload stays valid (and may be
+    // modified in place) until the next call.
+    char *feed (const char *payload, size_t len, size_t index, size_t total) {
+      if (index == 0) {
+        // a new message
+        received = 0;
+        expected = total;
+        skipping = total > N;
+        if (skipping) {
+          rejected++;
+        }
+      } else if (skipping || index != received || total != expected) {
+        // the rest of a rejected message or a chunk out of sequence
+        if (!skipping) {
+          rejected++;
+          skipping = true;
+        }
+        return NULL;
+      }
+
+      if (skipping) {
+        return NULL;
+      }
+      if (len > expected - received) {
+        // more data than announced, expected is at most N here
+        rejected++;
+        skipping = true;
+        return NULL;
+      }
+
+      memcpy(arena + received, payload, len);
+      received += len;
+      if (received < expected) {
+        return NULL;
+      }
+      arena[received] = 0;
+      return arena;
+    }
+
+    size_t length () const { return received; }
+    uint32_t rejectedCount () const { return rejected; }
+
+  private:
+    char arena[N + 1];
+    size_t received;
+    size_t expected;
+    bool skipping;
+    uint32_t rejected;
+};
+
+#endif // MESSAGE_ASSEMBLER_H
@@ -0,0 +1,114 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+
+#include "config.h"
+#include "JsonWriter.h"
+
+/*
+ * Runtime performance counters, published on the metrics topic together
+ * with the state. Interval values (histogram, max stall, latencies) are
+ * reset after each publish.
+ * With METRICS_ENABLED set to 0 the hot path calls compile to nothing.
+ */
+class Metrics {
+  public:
+    // Loop duration histogram, upper bounds of the buckets in us
+    static const uint8_t LOOP_BUCKETS = 8;
+
+    Metrics();
+
+    inline void loopBegin() {
+#if METRICS_ENABLED
+      loopStart = micros();
+#endif
+    }
+
+    inline void loopEnd() {
+#if METRICS_ENABLED
+      uint32_t duration = micros() - loopStart;
+      loops++;
+      if (duration > maxLoop) {
+        maxLoop = duration;
+      }
+      uint8_t bucket = 0;
+      while (bucket < LOOP_BUCKETS - 1 && duration >= bucketLimit(bucket)) {
+        bucket++;
+      }
+      loopHistogram[bucket]++;
+      if ((loops & 0xFF) == 0) {
+        sampleHeap();
+      }
+#endif
+    }
+
+    // Key press to code publish, ms
+    inline void codeLatency(uint32_t ms) {
+#if METRICS_ENABLED
+      lastCodeLatency = ms;
+      if (ms > maxCodeLatency) {
+        maxCodeLatency = ms;
+      }
+#else
+      (void)ms;
+#endif
+    }
+
+    // Heap taken by connecting to the broker (TLS buffers): free heap at the
+    // attempt against the lowest seen until connected
+    inline void connectBegin() {
+#if METRICS_ENABLED
+      connectHeapBase = ESP.getFreeHeap();
+      connectHeapLow = connectHeapBase;
+      connecting = true;
+#endif
+    }
+
+    inline void connectSample() {
+#if METRICS_ENABLED
+      if (connecting) {
+        uint32_t freeHeap = ESP.getFreeHeap();
+        if (freeHeap < connectHeapLow) {
+          connectHeapLow = freeHeap;
+        }
+      }
+#endif
+    }
+
+    inline void connectEnd() {
+#if METRICS_ENABLED
+      connectSample();
+      if (connecting) {
+        connecting = false;
+        lastConnectHeap = connectHeapBase - connectHeapLow;
+      }
+#endif
+    }
+
+    // Write the local counters and reset the interval ones
+    void write(JsonWriter &json);
+
+    // Since boot, not reset by write()
+    uint32_t minHeap() const { return minFreeHeap; }
+    uint32_t connectHeap() const { return lastConnectHeap; }
+
+    static uint32_t bucketLimit(uint8_t bucket);
+
+  private:
+    void sampleHeap();
+
+    uint32_t loopStart;
+    uint32_t loops;
+    uint32_t maxLoop;
+    uint32_t loopHistogram[LOOP_BUCKETS];
+    uint32_t minFreeHeap;
+    uint32_t lastCodeLatency;
+    uint32_t maxCodeLatency;
+    uint32_t connectHeapBase;
+    uint32_t connectHeapLow;
+    uint32_t lastConnectHeap;
+    bool connecting;
+};
+
+#endif // METRICS_H
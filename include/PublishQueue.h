@@ -0,0 +1,89 @@
+#ifndef PUBLISH_QUEUE_H
+#define PUBLISH_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+
+class AsyncMqttClient;
+
+/*
+ * Store-and-forward pipeline for outbound MQTT messages.
+ *
+ * Messages are copied into a fixed pool of buffers and sent in order by
+ * flush() when the client is connected. QoS 1 messages stay in the pool
+ * until the broker acknowledges them and are sent again after a reconnect,
+ * so nothing entered on the keypad is lost while offline. No heap is used.
+ * Topics are stored by pointer and must outlive the message (the topics
+ * of DeviceIdentity).
+ */
+class PublishQueue {
+  public:
+    PublishQueue();
+
+    // Copy a message into the pool. Returns false if it had to be dropped.
+    bool publish(const char *topic, uint8_t qos, bool retain, const char *payload, size_t length);
+
+    // Get a buffer of PUBLISH_PAYLOAD_SIZE bytes to format a message in
+    // place, then submit() or cancel() it. A queued retained message on the
+    // same topic is replaced instead of taking another buffer.
+    char *acquire(const char *topic, uint8_t qos, bool retain);
+    void submit(size_t length);
+    void cancel();
+    // Submission number of the last submitted message
+    uint32_t lastSubmitted() const { return nextSeq - 1; }
+
+    // Send what is queued, called from loop(). The connection is closed
+    // when an ack is overdue, messages are only sent again after it.
+    void flush(AsyncMqttClient &client, uint32_t now);
+    // The broker acknowledged a QoS 1 message (AsyncMqttClient::onPublish).
+    // Returns false for an unknown packet id, else lastAcked() is its
+    // submission number.
+    bool acknowledged(uint16_t packetId, uint32_t now);
+    // The connection is gone, messages waiting for an ack are sent again.
+    void connectionLost();
+    // Drop the messages on the topic queued more than maxAge ms ago and not
+    // sent yet. Returns how many were dropped.
+    uint32_t expire(const char *topic, uint32_t maxAge, uint32_t now);
+
+    // Statistics
+    size_t depth() const;                       // queued and in flight
+    size_t inFlight() const;
+    uint32_t droppedCount() const { return dropped; }
+    uint32_t sentCount() const { return sent; }
+    uint32_t lastAckTime() const { return lastRtt; }  // publish to PUBACK, ms
+    uint32_t maxAckTime() const { return maxRtt; }
+    uint32_t lastAcked() const { return lastAckedSeq; }
+
+  private:
+    enum State { FREE, RESERVED, QUEUED, IN_FLIGHT };
+
+    struct Slot {
+      State state;
+      const char *topic;
+      uint8_t qos;
+      bool retain;
+      uint16_t length;
+      uint16_t packetId;
+      uint32_t seq;       // submission order
+      uint32_t queuedAt;
+      uint32_t sentAt;
+      char payload[PUBLISH_PAYLOAD_SIZE];
+    };
+
+    Slot *findFree();
+    Slot *oldest(State state, bool qos0Only = false);
+
+    Slot slots[PUBLISH_QUEUE_SIZE];
+    Slot *reserved;
+    uint32_t nextSeq;
+
+    uint32_t dropped;
+    uint32_t sent;
+    uint32_t lastRtt;
+    uint32_t maxRtt;
+    uint32_t lastAckedSeq;
+};
+
+#endif // PUBLISH_QUEUE_H
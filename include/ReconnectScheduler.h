@@ -0,0 +1,60 @@
+#ifndef RECONNECT_SCHEDULER_H
+#define RECONNECT_SCHEDULER_H
+
+#include <stdint.h>
+
+/*
+ * Decides when to try to connect to the broker again. Driven from loop(),
+ * the MQTT callbacks only report what happened.
+ * The delay between attempts doubles from minDelay up to maxDelay and is
+ * randomized ("equal jitter": half fixed, half random) so a fleet of
+ * keypads does not reconnect in lockstep after a broker restart.
+ */
+class ReconnectScheduler {
+  public:
+    ReconnectScheduler(uint32_t minDelay, uint32_t maxDelay, uint32_t attemptTimeout);
+
+    // Connection lost (or never established), start the backoff.
+    void disconnected(uint32_t now);
+    // The broker accepted the connection.
+    void connected(uint32_t now);
+    // The network is back: the next attempt is not left to the backoff,
+    // which has grown while there was no network.
+    void networkRestored(uint32_t now);
+
+    // True if an attempt should be started now. The attempt is counted.
+    bool shouldConnect(uint32_t now, bool networkUp);
+
+    bool isConnected() const { return state == CONNECTED; }
+
+    // Statistics
+    uint32_t attempts() const { return totalAttempts; }          // since boot
+    uint32_t lastAttempts() const { return outageAttempts; }     // to recover from the last outage
+    uint32_t reconnects() const { return reconnectCount; }      // not counting the first connection
+    uint32_t lastReconnectTime() const { return reconnectTime; } // ms from disconnect to connected
+    uint32_t lastConnectTime() const { return connectTime; }     // ms from the attempt to connected
+
+  private:
+    enum State { CONNECTED, WAITING, CONNECTING };
+
+    void scheduleNext(uint32_t now);
+
+    const uint32_t minDelay;
+    const uint32_t maxDelay;
+    const uint32_t attemptTimeout;
+
+    State state;
+    uint32_t delay;         // current backoff base
+    uint32_t nextAttempt;
+    uint32_t attemptStart;
+    uint32_t disconnectedAt;
+
+    uint32_t totalAttempts;
+    uint32_t outageAttempts;
+    uint32_t reconnectCount;
+    uint32_t reconnectTime;
+    uint32_t connectTime;
+    bool everConnected;
+};
+
+#endif // RECONNECT_SCHEDULER_H
@@ -0,0 +1,165 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+
+// Fixed capacity FIFO stored inline, no heap is touched.
+// All operations are O(1) except copyTo() which is O(count).
+template<typename T, size_t N>
+class RingBuffer {
+  public:
+    RingBuffer ();
+
+    // add an item at the tail, fails when the buffer is full.
+    bool push (const T &item);
+
+    // add an item at the tail, the oldest item is dropped when the buffer is full.
+    void pushOverwrite (const T &item);
+
+    // remove the item at the head.
+    bool pop (T &item);
+
+    // remove the item at the tail (the most recently added one).
+    bool popBack (T &item);
+
+    // get the item at the head, the buffer must not be empty.
+    const T &front () const;
+
+    // get the item at the tail, the buffer must not be empty.
+    const T &back () const;
+
+    // copy the items from head to tail into a contiguous array.
+    // returns the number of items copied, at most max.
+    size_t copyTo (T *dst, size_t max) const;
+
+    // drop all items.
+    void clear ();
+
+    bool isEmpty () const;
+    bool isFull () const;
+    size_t count () const;
+    static constexpr size_t capacity () { return N; }
+
+  private:
+    static size_t next (size_t i) { return (i + 1 == N) ? 0 : i + 1; }
+    size_t tailIndex () const;
+
+    T contents[N];
+    size_t head;   // index of the oldest item.
+    size_t items;  // the number of items in the buffer.
+};
+
+
+template<typename T, size_t N>
+RingBuffer<T, N>::RingBuffer () : contents(), head(0), items(0) {
+  static_assert(N > 0, "RingBuffer capacity must not be zero");
+}
+
+
+template<typename T, size_t N>
+bool RingBuffer<T, N>::push (const T &item) {
+  if (isFull()) {
+    return false;
+  }
+  size_t tail = head + items;
+  if (tail >= N) {
+    tail -= N;
+  }
+  contents[tail] = item;
+  items++;
+  return true;
+}
+
+
+template<typename T, size_t N>
+void RingBuffer<T, N>::pushOverwrite (const T &item) {
+  if (isFull()) {
+    // the slot of the oldest item becomes the new tail.
+    contents[head] = item;
+    head = next(head);
+  } else {
+    push(item);
+  }
+}
+
+
+template<typename T, size_t N>
+bool RingBuffer<T, N>::pop (T &item) {
+  if (isEmpty()) {
+    return false;
+  }
+  item = contents[head];
+  head = next(head);
+  items--;
+  return true;
+}
+
+
+template<typename T, size_t N>
+bool RingBuffer<T, N>::popBack (T &item) {
+  if (isEmpty()) {
+    return false;
+  }
+  item = contents[tailIndex()];
+  items--;
+  return true;
+}
+
+
+template<typename T, size_t N>
+const T &RingBuffer<T, N>::front () const {
+  return contents[head];
+}
+
+
+template<typename T, size_t N>
+const T &RingBuffer<T, N>::back () const {
+  return contents[tailIndex()];
+}
+
+
+template<typename T, size_t N>
+size_t RingBuffer<T, N>::copyTo (T *dst, size_t max) const {
+  size_t n = items < max ? items : max;
+  size_t i = head;
+  for (size_t c = 0; c < n; c++) {
+    dst[c] = contents[i];
+    i = next(i);
+  }
+  return n;
+}
+
+
+template<typename T, size_t N>
+void RingBuffer<T, N>::clear () {
+  head = 0;
+  items = 0;
+}
+
+
+template<typename T, size_t N>
+bool RingBuffer<T, N>::isEmpty () const {
+  return items == 0;
+}
+
+
+template<typename T, size_t N>
+bool RingBuffer<T, N>::isFull () const {
+  return items == N;
+}
+
+
+template<typename T, size_t N>
+size_t RingBuffer<T, N>::count () const {
+  return items;
+}
+
+
+template<typename T, size_t N>
+size_t RingBuffer<T, N>::tailIndex () const {
+  size_t tail = head + items - 1;
+  return tail >= N ? tail - N : tail;
+}
+
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,58 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+typedef void (*TaskCallback)(void);
+
+// millis() extended to 64 bit so deadlines survive the 49 day rollover.
+// Has to be called at least once every 49 days, the scheduler does it.
+uint64_t millis64();
+
+/*
+ * Cooperative deadline scheduler. Tasks are kept in a min-heap ordered by
+ * their next deadline, run() only looks at the top of it.
+ * A task is identified by its callback: scheduling a callback again
+ * replaces its deadline.
+ */
+class Scheduler {
+  public:
+    Scheduler();
+
+    // Run the callback every period ms, the first time after firstDelay ms.
+    bool every(uint32_t period, TaskCallback callback, uint32_t firstDelay);
+    bool every(uint32_t period, TaskCallback callback) { return every(period, callback, period); }
+    // Run the callback once after delay ms.
+    bool after(uint32_t delay, TaskCallback callback);
+
+    void cancel(TaskCallback callback);
+    bool isScheduled(TaskCallback callback) const;
+
+    // Run the tasks which are due, called from loop().
+    void run();
+
+    // ms until the next deadline, at most cap.
+    uint32_t timeUntilNext(uint32_t cap) const;
+
+  private:
+    struct Task {
+      TaskCallback callback;
+      uint64_t due;
+      uint32_t period;   // 0 for one-shot tasks
+    };
+
+    bool schedule(TaskCallback callback, uint64_t due, uint32_t period);
+    int8_t find(TaskCallback callback) const;
+    void remove(uint8_t position);
+    void siftUp(uint8_t position);
+    void siftDown(uint8_t position);
+    bool earlier(uint8_t a, uint8_t b) const { return heap[a].due < heap[b].due; }
+    void swap(uint8_t a, uint8_t b);
+
+    Task heap[SCHEDULER_MAX_TASKS];
+    uint8_t size;
+};
+
+#endif // SCHEDULER_H
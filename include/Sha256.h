@@ -0,0 +1,26 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// SHA-256 (FIPS 180-4), incremental. Small and portable, used to hash the
+// codes of the local code cache.
+class Sha256 {
+  public:
+    static const size_t DIGEST_SIZE = 32;
+
+    Sha256();
+
+    void update(const void *data, size_t length);
+    void finish(uint8_t digest[DIGEST_SIZE]);
+
+  private:
+    void compress(const uint8_t block[64]);
+
+    uint32_t state[8];
+    uint8_t buffer[64];
+    uint64_t bytes;    // total length hashed
+};
+
+#endif // SHA256_H
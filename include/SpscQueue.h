@@ -0,0 +1,55 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free single-producer/single-consumer queue with inline storage.
+// The producer may be an interrupt handler, the consumer is the main loop.
+// Only the producer writes head, only the consumer writes tail, so neither
+// side has to disable interrupts. N must be a power of two.
+template<typename T, size_t N>
+class SpscQueue {
+  public:
+    SpscQueue () : head(0), tail(0), dropped(0) {
+      static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+      static_assert(N <= 128, "SpscQueue indices are 8 bit");
+    }
+
+    // producer side. returns false and counts the item as dropped when full.
+    bool push (const T &item) {
+      uint8_t h = head;
+      if ((uint8_t)(h - tail) == N) {
+        dropped++;
+        return false;
+      }
+      contents[h & (N - 1)] = item;
+      __sync_synchronize();
+      head = h + 1;
+      return true;
+    }
+
+    // consumer side.
+    bool pop (T &item) {
+      uint8_t t = tail;
+      if (t == head) {
+        return false;
+      }
+      item = contents[t & (N - 1)];
+      __sync_synchronize();
+      tail = t + 1;
+      return true;
+    }
+
+    bool isEmpty () const { return head == tail; }
+    size_t count () const { return (uint8_t)(head - tail); }
+    uint32_t droppedCount () const { return dropped; }
+
+  private:
+    T contents[N];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+    volatile uint32_t dropped;
+};
+
+#endif // SPSC_QUEUE_H
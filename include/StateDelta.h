@@ -0,0 +1,39 @@
+#ifndef STATE_DELTA_H
+#define STATE_DELTA_H
+
+#include <stdint.h>
+
+#include "JsonWriter.h"
+
+// The fields of the state document followed in delta mode
+struct StateSnapshot {
+  int32_t rssi;
+  uint32_t ip;
+  uint32_t mqttAttempts;
+  uint32_t mqttReconnects;
+  uint32_t publishDropped;
+};
+
+/*
+ * Delta mode of the state: remembers what was last published and writes
+ * only the fields that moved since. The RSSI counts only past a threshold so
+ * that the normal jitter of the signal does not trigger a publish.
+ */
+class StateDelta {
+  public:
+    explicit StateDelta(int32_t rssiThreshold);
+
+    // A full document with these values was published
+    void published(const StateSnapshot &state);
+    bool hasBaseline() const { return baseline; }
+
+    // Write the fields that changed and remember them, returns how many
+    uint8_t write(JsonWriter &json, const StateSnapshot &state);
+
+  private:
+    int32_t rssiThreshold;
+    bool baseline;
+    StateSnapshot last;
+};
+
+#endif // STATE_DELTA_H
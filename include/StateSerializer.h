@@ -0,0 +1,29 @@
+#ifndef STATE_SERIALIZER_H
+#define STATE_SERIALIZER_H
+
+#include <stdint.h>
+
+#include "JsonWriter.h"
+
+/*
+ * Keeps the slow changing fields of the state document preformatted.
+ * The MAC address and the firmware version are formatted once, the IP
+ * address only when it changes. The caller adds the volatile fields.
+ */
+class StateSerializer {
+  public:
+    StateSerializer();
+
+    // Write the cached fields, ip is the current address of the station
+    void writeFixed(JsonWriter &json, uint32_t ip);
+
+  private:
+    void format();
+
+    bool initialized;
+    uint32_t cachedIp;
+    char fixed[96];
+    uint8_t fixedLength;
+};
+
+#endif // STATE_SERIALIZER_H
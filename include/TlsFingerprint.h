@@ -0,0 +1,53 @@
+#ifndef TLS_FINGERPRINT_H
+#define TLS_FINGERPRINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// SHA-1 fingerprint of the broker certificate, what ESPAsyncTCP checks
+#define TLS_FINGERPRINT_SIZE 20
+
+/*
+ * Parse a fingerprint as printed by
+ *   openssl x509 -noout -fingerprint -sha1 -in broker.crt
+ * "AB:CD:..." or "abcd...", ':' and ' ' are skipped. Returns false unless
+ * there are exactly 20 bytes.
+ */
+inline bool parseTlsFingerprint(const char *text, uint8_t (&fingerprint)[TLS_FINGERPRINT_SIZE]) {
+  size_t digits = 0;
+  for (const char *c = text; *c != 0; c++) {
+    if (*c == ':' || *c == ' ') {
+      continue;
+    }
+    int8_t value;
+    if (*c >= '0' && *c <= '9') {
+      value = *c - '0';
+    } else if (*c >= 'a' && *c <= 'f') {
+      value = *c - 'a' + 10;
+    } else if (*c >= 'A' && *c <= 'F') {
+      value = *c - 'A' + 10;
+    } else {
+      return false;
+    }
+    if (digits >= 2 * TLS_FINGERPRINT_SIZE) {
+      return false;
+    }
+    if (digits % 2 == 0) {
+      fingerprint[digits / 2] = value << 4;
+    } else {
+      fingerprint[digits / 2] |= value;
+    }
+    digits++;
+  }
+  return digits == 2 * TLS_FINGERPRINT_SIZE;
+}
+
+// The same check at compile time, for MQTT_TLS_FINGERPRINT
+constexpr bool tlsFingerprintValid(const char *text, size_t digits = 0) {
+  return *text == 0 ? digits == 2 * TLS_FINGERPRINT_SIZE
+       : (*text == ':' || *text == ' ') ? tlsFingerprintValid(text + 1, digits)
+       : ((*text >= '0' && *text <= '9') || (*text >= 'a' && *text <= 'f') || (*text >= 'A' && *text <= 'F'))
+         && tlsFingerprintValid(text + 1, digits + 1);
+}
+
+#endif // TLS_FINGERPRINT_H
@@ -0,0 +1,50 @@
+#ifndef WIFI_CACHE_H
+#define WIFI_CACHE_H
+
+#include <Arduino.h>
+
+/*
+ * Remembers the access point (BSSID, channel) and the DHCP lease of the last
+ * connection in the EEPROM sector, so that the next boot can join it
+ * directly instead of scanning, and optionally skip DHCP.
+ * The SSID and passphrase stay where the SDK stores them, the BSSID is
+ * never saved there and only locked while the cached access point is tried.
+ */
+class WiFiCache {
+  public:
+    WiFiCache();
+
+    // Read the record, false if there is none or it is corrupt
+    bool load();
+
+    // Join the cached access point, waiting up to timeout ms.
+    // Returns false if nothing is cached or the association failed.
+    bool connect(uint32_t timeout);
+
+    // Remember the current connection, flash is written only on a change
+    void store();
+
+    bool isValid() const { return valid; }
+
+  private:
+    struct Record {
+      uint32_t magic;
+      uint8_t bssid[6];
+      uint8_t channel;
+      uint8_t reserved;
+      uint32_t ip;
+      uint32_t gateway;
+      uint32_t mask;
+      uint32_t dns;
+      uint32_t crc;     // of the fields above
+    };
+
+    static uint32_t recordCrc(const Record &record);
+    // Let the SDK join any access point with the SSID again
+    static void unlockAccessPoint(bool save);
+
+    Record record;
+    bool valid;
+};
+
+#endif // WIFI_CACHE_H
@@ -0,0 +1,46 @@
+#ifndef WS2812_UART_H
+#define WS2812_UART_H
+
+#include <Arduino.h>
+
+/*
+ * WS2812 output through the UART1 transmitter (TX on GPIO2/D4), a drop-in
+ * for the parts of Adafruit_NeoPixel the firmware uses.
+ * The line runs at 3.2 Mbaud, 6N1, inverted: one UART character is 8 bit
+ * times of 312.5ns and carries two WS2812 bits. The whole frame fits in the
+ * 128 byte TX FIFO, so show() only fills the FIFO and returns, the hardware
+ * shifts it out with the interrupts left enabled.
+ */
+class Ws2812Uart {
+  public:
+    static const uint8_t BYTES_PER_PIXEL = 12;   // 24 bits, 2 per character
+    static const uint8_t FIFO_SIZE = 128;
+    static const uint16_t MAX_PIXELS = FIFO_SIZE / BYTES_PER_PIXEL;
+    static const uint16_t LATCH_US = 300;        // low time ending a frame
+
+    explicit Ws2812Uart(uint16_t n);
+
+    void begin();
+    // Queue the frame, dropped if the previous one is still being sent
+    void show();
+    // The previous frame is sent and latched
+    bool canShow() const;
+    void clear();
+    void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+    void setPixelColor(uint16_t n, uint32_t c);
+    void setBrightness(uint8_t b) { brightness = b; }
+    uint16_t numPixels() const { return numLEDs; }
+
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+      return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+    }
+
+  private:
+    uint16_t numLEDs;
+    uint8_t brightness;
+    uint8_t pixels[MAX_PIXELS * 3];   // wire order, GRB
+    uint32_t frameMicros;             // frame plus latch time
+    uint32_t shownAt;
+};
+
+#endif // WS2812_UART_H
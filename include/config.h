@@ -3,16 +3,204 @@
 
 #define DIGITS 4
 
+// Keypad scanning (ms)
+#define KEYPAD_SCAN_FAST_MS 5        // while keys are pressed or a code is entered
+#define KEYPAD_SCAN_IDLE_MS 25
+#define KEYPAD_SCAN_FAST_HOLD_MS 3000 // stay fast that long after the last activity
+#define KEYPAD_DEBOUNCE_MS 20
+
 #define INTERVAL_PUBLISH_STATE 600000 // 10min
+// The periodic publish runs at a per-device phase derived from the MAC, the
+// state after a (re)connection is delayed by up to STATE_CONNECT_SPREAD ms
+#define STATE_CONNECT_SPREAD 5000
+// Delta mode: the periodic publish only sends the fields that changed (on
+// MQTT_SUFFIX_DELTA, not retained) and the full retained state every
+// STATE_HEARTBEAT_INTERVAL
+#ifndef STATE_DELTA_MODE
+#define STATE_DELTA_MODE 0
+#endif
+#define STATE_HEARTBEAT_INTERVAL 3600000 // 1h
+#define STATE_RSSI_THRESHOLD 5           // dBm
+
+// LED strip driver. LED_BACKEND_NEOPIXEL bit-bangs the data pin with the
+// interrupts disabled for the whole frame, LED_BACKEND_UART1 loads the frame
+// into the UART1 FIFO and returns. UART1 transmits on D4: the strip moves
+// there and the keypad column C3 to D7, see README.
+#define LED_BACKEND_NEOPIXEL 0
+#define LED_BACKEND_UART1 1
+#ifndef LED_BACKEND
+#define LED_BACKEND LED_BACKEND_NEOPIXEL
+#endif
+
+// Serial log, see Logger.h. Lines above LOG_LEVEL are compiled out,
+// LOG_MQTT_LEVEL is where the MQTT log topic starts at boot (NONE: off).
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#ifndef LOG_MQTT_LEVEL
+#define LOG_MQTT_LEVEL LOG_LEVEL_NONE
+#endif
+#define LOG_QUEUE_SIZE 16
+#define LOG_LINE_SIZE 96
+
+// Frame period of the LED animations while a level fades
+#define ANIMATION_FRAME_MS 20
+
+// Scheduler
+#define SCHEDULER_MAX_TASKS 8
+#define LOOP_MAX_IDLE_MS 10  // longest sleep between loop iterations
+
+// Idle mode, entered after IDLE_TIMEOUT ms without a key press: LEDs off,
+// keypad woken by its row interrupts, WiFi light sleep
+#define IDLE_TIMEOUT 60000
+#define IDLE_LOOP_MAX_MS 250     // longest sleep between loop iterations when idle
+#define IDLE_LISTEN_INTERVAL 3   // DTIM periods between two beacons listened to
+
+// TLS to the broker. AsyncMqttClient runs it through ESPAsyncTCP and axTLS,
+// built with ASYNC_TCP_SSL_ENABLED=1 (the d1_mini_tls environment). The
+// certificate is pinned by its SHA-1 fingerprint, "AB:CD:..." (20 bytes).
+// The build fails without it, the device never connects unpinned.
+#ifndef MQTT_TLS
+#define MQTT_TLS 0
+#endif
+#ifndef MQTT_TLS_FINGERPRINT
+#define MQTT_TLS_FINGERPRINT ""
+#endif
+// A handshake needs a large contiguous block, no attempt is started without it
+#define MQTT_TLS_MIN_BLOCK 20000
+#if MQTT_TLS
+#define MQTT_DEFAULT_PORT "8883"
+#else
+#define MQTT_DEFAULT_PORT "1883"
+#endif
+
+// Delay between attempts to connect to the broker, doubles up to the max (ms)
+#define MQTT_RECONNECT_MIN_DELAY 1000
+#define MQTT_RECONNECT_MAX_DELAY 60000
+#define MQTT_CONNECT_TIMEOUT 10000
+
+// Offline mode: the keypad keeps taking codes without WiFi or broker and
+// sends them once back, unless they are older than OFFLINE_CODE_MAX_AGE.
+// The SDK rejoins the same access point, a full scan is started every
+// WIFI_RESCAN_PERIOD while the link is down. The device restarts only after
+// OFFLINE_RESTART_TIMEOUT without the broker (0 never).
+#define OFFLINE_CODE_MAX_AGE 120000    // ms
+#define WIFI_RESCAN_PERIOD 60000       // ms
+#define OFFLINE_RESTART_TIMEOUT 3600000 // ms
+
+// Loop timing and latency counters on the metrics topic, 0 to compile them out
+#ifndef METRICS_ENABLED
+#define METRICS_ENABLED 1
+#endif
 
-#define MQTT_TOPIC_STATE "alarm/keypad"
-#define MQTT_TOPIC_CODE "alarm/keypad/code"
-#define MQTT_TOPIC_COMMAND "alarm/keypad/command"
+// Local HTTP diagnostics endpoint (/status, /metrics), unauthenticated and
+// served from loop(): off unless built with -DDIAG_HTTP=1
+#ifndef DIAG_HTTP
+#define DIAG_HTTP 0
+#endif
+#define DIAG_HTTP_PORT 80
+#define DIAG_HTTP_CHUNK_SIZE 256   // bytes per chunk of a response
+#define DIAG_HTTP_TIMEOUT 100      // ms for a client to send its request, and to read the response
+
+// Outbound messages buffered while offline
+#define PUBLISH_QUEUE_SIZE 8
+#define PUBLISH_PAYLOAD_SIZE 640   // the metrics document takes ~500 bytes
+#define PUBLISH_MAX_IN_FLIGHT 4
+#define PUBLISH_ACK_TIMEOUT 30000 // ms, then the connection is closed
+
+// Longest accepted command payload and its JSON document capacity
+#define COMMAND_PAYLOAD_SIZE 256
+#define COMMAND_JSON_SIZE JSON_OBJECT_SIZE(8)
+
+// Code latency tracing: each code is published as JSON with a trace ID and
+// the alarm state topic is followed to see when the alarm reacted.
+// 0 publishes the bare digits, as the alarm integration expects by default.
+#ifndef CODE_TRACE
+#define CODE_TRACE 0
+#endif
+#ifndef ALARM_STATE_TOPIC
+#define ALARM_STATE_TOPIC "home/alarm"
+#endif
+#define CODE_TRACE_TIMEOUT 30000 // ms without a state change, the code is not traced further
+#define CODE_TRACE_PENDING 4
+#define LATENCY_WINDOW 64        // samples, the histograms are halved when full
+
+// Event trace for a replay on the host, see EventTrace.h. Recording starts
+// at boot and stops when the buffer is full, the "trace" command restarts
+// it or publishes it on MQTT_SUFFIX_TRACE.
+// The digits are masked, but the trace still tells when and how many keys
+// were pressed and holds the messages from the broker as they came: anyone
+// who may send the command or read the trace topic sees them.
+#ifndef EVENT_TRACE
+#define EVENT_TRACE 0
+#endif
+#ifndef EVENT_TRACE_SIZE
+#define EVENT_TRACE_SIZE 2048
+#endif
+#define EVENT_TRACE_DUMP_PERIOD 50 // ms between two chunks of a dump
+#define EVENT_TRACE_LED_HOLD 50    // ms a frame has to stay on the strip to be recorded
+
+// Local code cache for the instant feedback on '#', see CodeCache.h
+#define CODE_CACHE_MAX 16
+#define CODE_CACHE_SALT_SIZE 32
+// Key of the code hashes in hex, shared with the publisher of the list only.
+// Without it the list is ignored. Also restrict the codes topic with broker
+// ACLs: a leaked key and list give the codes away in 10^4 tries.
+#ifndef CODE_CACHE_KEY
+#define CODE_CACHE_KEY ""
+#endif
+#define CODE_CACHE_KEY_MIN 16   // bytes
+#define CODE_CACHE_KEY_SIZE 64
+#define CODE_CACHE_PAYLOAD_SIZE 512
+#define CODE_CACHE_JSON_SIZE (JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(CODE_CACHE_MAX))
+#define CODE_FEEDBACK_MS 1500 // how long the accept/reject colour is shown
+
+// Topics are MQTT_TOPIC_PREFIX, followed by "/<chip id>" with
+// MQTT_TOPIC_PER_DEVICE, followed by the suffix. The state has no suffix.
+#define MQTT_TOPIC_PREFIX "alarm/keypad"
+#ifndef MQTT_TOPIC_PER_DEVICE
+#define MQTT_TOPIC_PER_DEVICE 0
+#endif
+#define MQTT_TOPIC_SIZE 64
+#define MQTT_SUFFIX_CODE "/code"
+#define MQTT_SUFFIX_COMMAND "/command"
+#define MQTT_SUFFIX_METRICS "/metrics"
+#define MQTT_SUFFIX_STATUS "/status"
+#define MQTT_SUFFIX_DELTA "/delta"
+#define MQTT_SUFFIX_CODES "/codes"
+#define MQTT_SUFFIX_LOG "/log"
+#define MQTT_SUFFIX_LATENCY "/latency"
+#define MQTT_SUFFIX_TRACE "/trace"
 
-#define MQTT_TOPIC_STATUS "alarm/keypad/status"
 #define MQTT_STATUS_PAYLOAD_ON "online"
 #define MQTT_STATUS_PAYLOAD_OFF "offline"
 
+// EEPROM sector layout, every record is written back on each commit
+#define EEPROM_SIZE 512
+#define CONFIG_ADDRESS 0
+#define WIFI_CACHE_ADDRESS 256
+
+// Configuration record in the EEPROM sector. Field lengths exclude the
+// terminating zero and match the configuration portal.
+#define CONFIG_VERSION 1
+#define CONFIG_MQTT_SERVER_LEN 40
+#define CONFIG_MQTT_PORT_LEN 5
+#define CONFIG_MQTT_LOGIN_LEN 64
+#define CONFIG_MQTT_PASSWORD_LEN 64
+
+// Boot fast path: join the last access point directly (BSSID and channel,
+// no scan) before falling back to the WiFiManager
+#define WIFI_FAST_CONNECT_TIMEOUT 5000 // ms
+// Also reuse the last DHCP lease as a static IP, skipping DHCP
+#ifndef WIFI_CACHE_STATIC_IP
+#define WIFI_CACHE_STATIC_IP 0
+#endif
+
 #define WIFI_AP_NAME "AlarmKeypad"
 #define WIFI_AP_PASS "123456789"
 
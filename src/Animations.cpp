@@ -0,0 +1,37 @@
+#include "Animations.h"
+
+// Steps are two keyframes 1ms apart
+#define FRAMES(table) table, sizeof(table) / sizeof(table[0])
+
+static const Keyframe BOOT_FRAMES[] PROGMEM = {
+  { 0, 255 }
+};
+const Animation ANIM_BOOT PROGMEM = { FRAMES(BOOT_FRAMES), ANIM_HOLD, 0, 0xFFFFFF };
+
+// Each LED is lit for one step of 100ms, there and back
+static const Keyframe WAITING_FRAMES[] PROGMEM = {
+  { 0, 255 }, { 99, 255 }, { 100, 0 }
+};
+const Animation ANIM_WAITING PROGMEM = { FRAMES(WAITING_FRAMES), ANIM_SWEEP, 100, 0x0000FF };
+const Animation ANIM_OFFLINE PROGMEM = { FRAMES(WAITING_FRAMES), ANIM_SWEEP, 100, 0xFFA000 };
+
+// A slot per LED, stretched to the lock duration
+static const Keyframe LOCK_FRAMES[] PROGMEM = {
+  { 0, 255 }, { 700, 255 }, { 1000, 0 }
+};
+const Animation ANIM_LOCK PROGMEM = { FRAMES(LOCK_FRAMES), ANIM_STAGGER, 1000, 0xFF0000 };
+
+static const Keyframe ACCEPT_FRAMES[] PROGMEM = {
+  { 0, 255 }, { 1000, 255 }, { 1500, 0 }
+};
+const Animation ANIM_ACCEPT PROGMEM = { FRAMES(ACCEPT_FRAMES), 0, 0, 0x00FF00 };
+
+static const Keyframe REJECT_FRAMES[] PROGMEM = {
+  { 0, 255 }, { 250, 255 }, { 251, 0 }, { 500, 0 },
+  { 501, 255 }, { 750, 255 }, { 751, 0 }, { 1000, 0 },
+  { 1001, 255 }, { 1250, 255 }, { 1500, 0 }
+};
+const Animation ANIM_REJECT PROGMEM = { FRAMES(REJECT_FRAMES), 0, 0, 0xFF0000 };
+
+// Same timing as ANIM_ACCEPT
+const Animation ANIM_QUEUED PROGMEM = { FRAMES(ACCEPT_FRAMES), 0, 0, 0xFFA000 };
@@ -0,0 +1,181 @@
+#include "Animator.h"
+
+namespace {
+  inline uint32_t scaleColor(uint32_t color, uint8_t level) {
+    uint16_t factor = level + 1;
+    uint8_t r = ((uint8_t)(color >> 16) * factor) >> 8;
+    uint8_t g = ((uint8_t)(color >> 8) * factor) >> 8;
+    uint8_t b = ((uint8_t)color * factor) >> 8;
+    return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+  }
+
+  // Keyframe time to played time and back
+  inline uint32_t stretch(uint32_t t, uint32_t from, uint32_t to) {
+    return from == to || from == 0 ? t : (uint32_t)((uint64_t)t * to / from);
+  }
+
+  inline void shorten(uint32_t &wait, uint32_t value) {
+    if (value < wait) {
+      wait = value;
+    }
+  }
+}
+
+Animator::Animator(LedCompositor &_leds)
+  : leds(_leds)
+  , tracks()
+  , renderCount(0) {
+}
+
+uint32_t Animator::naturalLength(const Animation &animation) {
+  uint32_t last = pgm_read_word(&animation.frames[animation.count - 1].time);
+  if (animation.flags & ANIM_SWEEP) {
+    return DIGITS > 1 ? 2UL * (DIGITS - 1) * animation.step : animation.step;
+  }
+  if (animation.flags & ANIM_STAGGER) {
+    return last + (DIGITS - 1UL) * animation.step;
+  }
+  return last;
+}
+
+void Animator::play(LedCompositor::Layer layer, const Animation *animation, uint32_t length) {
+  Track &track = tracks[layer];
+  memcpy_P(&track.animation, animation, sizeof(Animation));
+  track.natural = naturalLength(track.animation);
+  track.length = length > 0 ? length : track.natural;
+  track.start = millis();
+  track.due = track.start;
+  track.playing = true;
+  leds.setActive(layer, true);
+}
+
+void Animator::stop(LedCompositor::Layer layer) {
+  tracks[layer].playing = false;
+  leds.setActive(layer, false);
+}
+
+/*
+ * Level of the keyframes at t (keyframe time). wait is how long it stays
+ * valid, moving is set while the level is changing.
+ */
+uint8_t Animator::sample(const Animation &animation, uint32_t t, uint32_t &wait, bool &moving) {
+  const Keyframe *frames = animation.frames;
+  uint8_t k = 0;
+  while (k + 1 < animation.count && pgm_read_word(&frames[k + 1].time) <= t) {
+    k++;
+  }
+  uint8_t level = pgm_read_byte(&frames[k].level);
+  if (k + 1 == animation.count) {
+    return level;
+  }
+
+  uint16_t from = pgm_read_word(&frames[k].time);
+  uint16_t to = pgm_read_word(&frames[k + 1].time);
+  uint8_t next = pgm_read_byte(&frames[k + 1].level);
+  shorten(wait, to - t);
+  if (next == level) {
+    return level;
+  }
+  moving = true;
+  return level + (int32_t)(next - level) * (int32_t)(t - from) / (to - from);
+}
+
+uint8_t Animator::pixelLevel(const Animation &animation, uint8_t pixel, uint32_t t, uint32_t natural,
+                             uint32_t &wait, bool &moving) const {
+  if (animation.flags & ANIM_SWEEP) {
+    // Reached on the way there and on the way back
+    uint32_t there = (t + natural - (uint32_t)pixel * animation.step % natural) % natural;
+    uint32_t back = (t + natural - (2UL * (DIGITS - 1) - pixel) * animation.step % natural) % natural;
+    uint32_t waitThere = natural - there;
+    uint32_t waitBack = natural - back;
+    uint8_t levelThere = sample(animation, there, waitThere, moving);
+    uint8_t levelBack = sample(animation, back, waitBack, moving);
+    shorten(wait, waitThere);
+    shorten(wait, waitBack);
+    return levelThere > levelBack ? levelThere : levelBack;
+  }
+
+  if (animation.flags & ANIM_STAGGER) {
+    uint32_t offset = (uint32_t)(DIGITS - 1 - pixel) * animation.step;
+    if (t < offset) {
+      shorten(wait, offset - t);
+      return pgm_read_byte(&animation.frames[0].level);
+    }
+    t -= offset;
+  }
+  if (animation.flags & ANIM_LOOP) {
+    shorten(wait, natural - t);
+  }
+  return sample(animation, t, wait, moving);
+}
+
+void Animator::render(LedCompositor::Layer layer, uint32_t now) {
+  Track &track = tracks[layer];
+  const Animation &animation = track.animation;
+  uint32_t elapsed = now - track.start;
+
+  bool done = false;
+  if (!(animation.flags & (ANIM_LOOP | ANIM_SWEEP)) && elapsed >= track.length) {
+    if (!(animation.flags & ANIM_HOLD)) {
+      stop(layer);
+      return;
+    }
+    elapsed = track.length;
+    done = true;
+  }
+
+  // Position in keyframe time
+  uint32_t t = stretch(elapsed, track.length, track.natural);
+  if (t > track.natural) {
+    t = track.natural;
+  }
+  if (animation.flags & (ANIM_LOOP | ANIM_SWEEP)) {
+    t = track.natural > 0 ? t % track.natural : 0;
+  }
+
+  uint32_t wait = UINT32_MAX;
+  bool moving = false;
+  for (uint8_t i = 0; i < DIGITS; i++) {
+    uint8_t level = pixelLevel(animation, i, t, track.natural, wait, moving);
+    leds.setPixel(layer, i, scaleColor(animation.color, level));
+  }
+  renderCount++;
+
+  if (done) {
+    track.playing = false;
+    return;
+  }
+  if (moving) {
+    track.due = now + ANIMATION_FRAME_MS;
+  } else if (wait == UINT32_MAX) {
+    // Steady until the end
+    track.due = track.start + track.length;
+  } else {
+    uint32_t ms = stretch(wait, track.natural, track.length);
+    track.due = now + (ms > 0 ? ms : 1);
+  }
+}
+
+void Animator::update(uint32_t now) {
+  for (uint8_t l = 0; l < LedCompositor::LAYER_COUNT; l++) {
+    if (tracks[l].playing && (int32_t)(now - tracks[l].due) >= 0) {
+      render((LedCompositor::Layer)l, now);
+    }
+  }
+}
+
+uint32_t Animator::timeUntilNext(uint32_t now, uint32_t cap) const {
+  for (uint8_t l = 0; l < LedCompositor::LAYER_COUNT; l++) {
+    if (!tracks[l].playing) {
+      continue;
+    }
+    int32_t remaining = (int32_t)(tracks[l].due - now);
+    if (remaining <= 0) {
+      return 0;
+    }
+    if ((uint32_t)remaining < cap) {
+      cap = remaining;
+    }
+  }
+  return cap;
+}
@@ -0,0 +1,31 @@
+#include "BootTimeline.h"
+
+namespace {
+  const char *const phaseFields[BootTimeline::PHASE_COUNT] = {
+    "boot_config_ms", "boot_wifi_ms", "boot_ip_ms", "boot_mqtt_ms"
+  };
+}
+
+BootTimeline::BootTimeline()
+  : times()
+  , fastPath(false)
+  , published(false) {
+}
+
+void BootTimeline::mark(Phase phase, uint32_t now) {
+  if (times[phase] == 0) {
+    // 0 means "not yet", a phase done at 0 ms is reported as 1 ms
+    times[phase] = now != 0 ? now : 1;
+  }
+}
+
+void BootTimeline::write(JsonWriter &json) {
+  if (published) {
+    return;
+  }
+  json.add("boot_wifi", fastPath ? "fast" : "manager");
+  for (uint8_t phase = 0; phase < PHASE_COUNT; phase++) {
+    json.add(phaseFields[phase], (uint32_t)times[phase]);
+  }
+  published = true;
+}
@@ -0,0 +1,164 @@
+#include "CodeCache.h"
+
+#include <string.h>
+
+#include <ArduinoJson.h>
+
+namespace {
+  int8_t hexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+      return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+      return c - 'A' + 10;
+    }
+    return -1;
+  }
+
+  // Decode hex into at most max bytes, returns the byte count or -1
+  int decodeHex(const char *hex, uint8_t *out, size_t max) {
+    size_t length = strlen(hex);
+    if (length % 2 != 0 || length / 2 > max) {
+      return -1;
+    }
+    for (size_t i = 0; i < length / 2; i++) {
+      int8_t high = hexDigit(hex[2 * i]);
+      int8_t low = hexDigit(hex[2 * i + 1]);
+      if (high < 0 || low < 0) {
+        return -1;
+      }
+      out[i] = (uint8_t)((high << 4) | low);
+    }
+    return (int)(length / 2);
+  }
+}
+
+CodeCache::CodeCache()
+  : inner()
+  , outer()
+  , keyed(false)
+  , salt()
+  , saltLength(0)
+  , codes()
+  , count(0) {
+}
+
+bool CodeCache::setKey(const char *hex) {
+  // RFC 2104 with a key shorter than the block
+  const size_t BLOCK_SIZE = 64;
+  uint8_t key[BLOCK_SIZE];
+  memset(key, 0, sizeof(key));
+  int length = decodeHex(hex, key, CODE_CACHE_KEY_SIZE);
+  keyed = length >= CODE_CACHE_KEY_MIN;
+  if (!keyed) {
+    return false;
+  }
+
+  uint8_t pad[BLOCK_SIZE];
+  for (size_t i = 0; i < BLOCK_SIZE; i++) {
+    pad[i] = key[i] ^ 0x36;
+  }
+  inner = Sha256();
+  inner.update(pad, sizeof(pad));
+  for (size_t i = 0; i < BLOCK_SIZE; i++) {
+    pad[i] = key[i] ^ 0x5c;
+  }
+  outer = Sha256();
+  outer.update(pad, sizeof(pad));
+  memset(key, 0, sizeof(key));
+  return true;
+}
+
+void CodeCache::clear() {
+  memset(codes, 0, sizeof(codes));
+  count = 0;
+  saltLength = 0;
+}
+
+bool CodeCache::load(char *payload) {
+  clear();
+  if (payload[0] == 0) {
+    // the retained message was deleted
+    return true;
+  }
+  if (!keyed) {
+    return false;
+  }
+
+  StaticJsonBuffer<CODE_CACHE_JSON_SIZE> jsonBuffer;
+  JsonObject& json = jsonBuffer.parseObject(payload);
+  if (!json.success()) {
+    return false;
+  }
+
+  const char *saltHex = json["salt"];
+  int length = saltHex != NULL ? decodeHex(saltHex, salt, sizeof(salt)) : -1;
+  if (length <= 0) {
+    return false;
+  }
+  saltLength = length;
+
+  JsonArray& list = json["codes"];
+  if (!list.success() || list.size() > CODE_CACHE_MAX) {
+    clear();
+    return false;
+  }
+  for (size_t i = 0; i < list.size(); i++) {
+    const char *entry = list[i];
+    uint8_t bytes[BYTES_PER_CODE];
+    if (entry == NULL || decodeHex(entry, bytes, sizeof(bytes)) != (int)sizeof(bytes)) {
+      clear();
+      return false;
+    }
+    uint64_t value = 0;
+    for (uint8_t b = 0; b < sizeof(bytes); b++) {
+      value = (value << 8) | bytes[b];
+    }
+
+    // insertion sort, duplicates are dropped
+    uint8_t position = count;
+    while (position > 0 && codes[position - 1] > value) {
+      position--;
+    }
+    if (position > 0 && codes[position - 1] == value) {
+      continue;
+    }
+    memmove(&codes[position + 1], &codes[position], (count - position) * sizeof(codes[0]));
+    codes[position] = value;
+    count++;
+  }
+  return true;
+}
+
+uint64_t CodeCache::hash(const char *code, size_t length) const {
+  Sha256 sha = inner;
+  sha.update(salt, saltLength);
+  sha.update(code, length);
+  uint8_t digest[Sha256::DIGEST_SIZE];
+  sha.finish(digest);
+  sha = outer;
+  sha.update(digest, sizeof(digest));
+  sha.finish(digest);
+
+  uint64_t value = 0;
+  for (uint8_t b = 0; b < BYTES_PER_CODE; b++) {
+    value = (value << 8) | digest[b];
+  }
+  return value;
+}
+
+bool CodeCache::verify(const char *code, size_t length) const {
+  uint64_t candidate = hash(code, length);
+
+  // Every slot is compared, used or not, without an early exit
+  uint8_t found = 0;
+  for (uint8_t i = 0; i < CODE_CACHE_MAX; i++) {
+    uint64_t diff = codes[i] ^ candidate;
+    uint8_t used = i < count;
+    found |= (uint8_t)(diff == 0) & used;
+  }
+  return found != 0;
+}
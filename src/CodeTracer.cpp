@@ -0,0 +1,83 @@
+#include "CodeTracer.h"
+#include "Logger.h"
+
+CodeTracer::CodeTracer()
+  : pending()
+  , nextTraceId(1)
+  , unmatched(0) {
+}
+
+void CodeTracer::expire(uint32_t now) {
+  for (Trace &trace : pending) {
+    if (trace.active && now - trace.queuedAt >= CODE_TRACE_TIMEOUT) {
+      trace.active = false;
+      unmatched++;
+      LOG_WARN("Trace", "code %u: no state change", trace.id);
+    }
+  }
+}
+
+void CodeTracer::begin(uint32_t entryMs, uint32_t seq, uint32_t now) {
+  expire(now);
+  entryLatency.add(entryMs);
+
+  // The oldest trace makes room
+  Trace *slot = &pending[0];
+  for (Trace &trace : pending) {
+    if (!trace.active) {
+      slot = &trace;
+      break;
+    }
+    if ((int32_t)(trace.queuedAt - slot->queuedAt) < 0) {
+      slot = &trace;
+    }
+  }
+  if (slot->active) {
+    unmatched++;
+  }
+
+  slot->active = true;
+  slot->acked = false;
+  slot->id = nextTraceId++;
+  slot->seq = seq;
+  slot->queuedAt = now;
+  if (nextTraceId == 0) {
+    nextTraceId = 1;
+  }
+}
+
+void CodeTracer::acknowledged(uint32_t seq, uint32_t now) {
+  for (Trace &trace : pending) {
+    if (trace.active && !trace.acked && trace.seq == seq) {
+      trace.acked = true;
+      ackLatency.add(now - trace.queuedAt);
+      LOG_DEBUG("Trace", "code %u: PUBACK after %u ms", trace.id, now - trace.queuedAt);
+      return;
+    }
+  }
+}
+
+void CodeTracer::stateChanged(uint32_t now) {
+  expire(now);
+  Trace *oldest = NULL;
+  for (Trace &trace : pending) {
+    if (trace.active && (oldest == NULL || (int32_t)(trace.queuedAt - oldest->queuedAt) < 0)) {
+      oldest = &trace;
+    }
+  }
+  if (oldest == NULL) {
+    return;
+  }
+  oldest->active = false;
+  stateLatency.add(now - oldest->queuedAt);
+  LOG_INFO("Trace", "code %u: state change after %u ms", oldest->id, now - oldest->queuedAt);
+}
+
+void CodeTracer::write(JsonWriter &json, uint32_t now) {
+  expire(now);
+  json.add("traced", (unsigned int)(nextTraceId - 1));
+  json.add("unmatched", unmatched);
+  entryLatency.write(json, "entry");
+  ackLatency.write(json, "ack");
+  stateLatency.write(json, "state");
+}
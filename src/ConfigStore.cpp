@@ -0,0 +1,161 @@
+#include "ConfigStore.h"
+#include "Crc32.h"
+#include "Logger.h"
+
+#include <EEPROM.h>
+#include <FS.h>
+#include <ArduinoJson.h>
+
+namespace {
+  const uint32_t CONFIG_MAGIC = 0x4B504346; // "KPCF"
+  const char *LEGACY_FILE = "/config.json";
+
+  struct RecordHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;      // of the payload
+  };
+
+  const int PAYLOAD_ADDRESS = CONFIG_ADDRESS + sizeof(RecordHeader);
+  const int CRC_ADDRESS = PAYLOAD_ADDRESS + sizeof(DeviceConfig);
+
+  static_assert(CRC_ADDRESS + sizeof(uint32_t) <= WIFI_CACHE_ADDRESS, "the config record overlaps the WiFi cache");
+
+  uint32_t recordCrc(const RecordHeader &header, const DeviceConfig &config) {
+    return computeCrc32(&config, sizeof(config), computeCrc32(&header, sizeof(header)));
+  }
+
+  // The fields are zero padded so that equal settings give equal records
+  void terminate(DeviceConfig &config) {
+    DeviceConfig clean;
+    memset(&clean, 0, sizeof(clean));
+    copyConfigField(clean.mqttServer, config.mqttServer);
+    copyConfigField(clean.mqttPort, config.mqttPort);
+    copyConfigField(clean.mqttLogin, config.mqttLogin);
+    copyConfigField(clean.mqttPassword, config.mqttPassword);
+    config = clean;
+  }
+}
+
+ConfigStore::ConfigStore()
+  : loadMicros(0)
+  , heapUsed(0)
+  , loadedFrom(SOURCE_DEFAULTS) {
+}
+
+const char *ConfigStore::sourceName(Source source) {
+  switch (source) {
+    case SOURCE_RECORD:
+      return "record";
+    case SOURCE_JSON:
+      return "json";
+    default:
+      return "defaults";
+  }
+}
+
+ConfigStore::Source ConfigStore::load(DeviceConfig &config) {
+  uint32_t heapBefore = ESP.getFreeHeap();
+  uint32_t start = micros();
+
+  if (readRecord(config)) {
+    loadedFrom = SOURCE_RECORD;
+  } else if (readJson(config)) {
+    loadedFrom = SOURCE_JSON;
+    // One-time migration
+    if (save(config)) {
+      SPIFFS.remove(LEGACY_FILE);
+      LOG_INFO("Config", "migrated /config.json to the EEPROM record");
+    }
+  } else {
+    loadedFrom = SOURCE_DEFAULTS;
+  }
+
+  loadMicros = micros() - start;
+  uint32_t heapAfter = ESP.getFreeHeap();
+  heapUsed = heapBefore > heapAfter ? heapBefore - heapAfter : 0;
+  LOG_INFO("Config", "loaded from %s in %u us, %u bytes of heap", sourceName(loadedFrom), loadMicros, heapUsed);
+  return loadedFrom;
+}
+
+bool ConfigStore::readRecord(DeviceConfig &config) {
+  EEPROM.begin(EEPROM_SIZE);
+
+  RecordHeader header;
+  EEPROM.get(CONFIG_ADDRESS, header);
+  bool valid = header.magic == CONFIG_MAGIC;
+  if (valid && (header.version != CONFIG_VERSION || header.size != sizeof(DeviceConfig))) {
+    // Layout changes bump CONFIG_VERSION and convert the older records here
+    LOG_WARN("Config", "unsupported record version %u", header.version);
+    valid = false;
+  }
+
+  DeviceConfig stored;
+  uint32_t crc = 0;
+  if (valid) {
+    EEPROM.get(PAYLOAD_ADDRESS, stored);
+    EEPROM.get(CRC_ADDRESS, crc);
+    if (crc != recordCrc(header, stored)) {
+      LOG_WARN("Config", "record CRC mismatch");
+      valid = false;
+    }
+  }
+  EEPROM.end();
+
+  if (valid) {
+    terminate(stored);
+    config = stored;
+  }
+  return valid;
+}
+
+bool ConfigStore::readJson(DeviceConfig &config) {
+  if (!SPIFFS.begin()) {
+    LOG_ERROR("Config", "failed to mount FS");
+    return false;
+  }
+  File file = SPIFFS.open(LEGACY_FILE, "r");
+  if (!file) {
+    return false;
+  }
+
+  size_t size = file.size();
+  std::unique_ptr<char[]> buf(new char[size + 1]);
+  file.readBytes(buf.get(), size);
+  buf[size] = 0;
+  file.close();
+
+  DynamicJsonBuffer jsonBuffer;
+  JsonObject& json = jsonBuffer.parseObject(buf.get());
+  if (!json.success()) {
+    LOG_WARN("Config", "failed to parse /config.json");
+    return false;
+  }
+
+  copyConfigField(config.mqttServer, json["mqtt_server"].as<const char*>());
+  copyConfigField(config.mqttPort, json["mqtt_port"].as<const char*>());
+  copyConfigField(config.mqttLogin, json["mqtt_login"].as<const char*>());
+  copyConfigField(config.mqttPassword, json["mqtt_password"].as<const char*>());
+  return true;
+}
+
+bool ConfigStore::save(const DeviceConfig &config) {
+  DeviceConfig clean = config;
+  terminate(clean);
+
+  RecordHeader header;
+  header.magic = CONFIG_MAGIC;
+  header.version = CONFIG_VERSION;
+  header.size = sizeof(DeviceConfig);
+  uint32_t crc = recordCrc(header, clean);
+
+  EEPROM.begin(EEPROM_SIZE);
+  EEPROM.put(CONFIG_ADDRESS, header);
+  EEPROM.put(PAYLOAD_ADDRESS, clean);
+  EEPROM.put(CRC_ADDRESS, crc);
+  bool ok = EEPROM.end();
+  if (!ok) {
+    LOG_ERROR("Config", "failed to write the EEPROM record");
+  }
+  return ok;
+}
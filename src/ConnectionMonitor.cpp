@@ -0,0 +1,78 @@
+#include "ConnectionMonitor.h"
+#include "Logger.h"
+
+ConnectionMonitor::ConnectionMonitor(uint32_t _rescanPeriod, uint32_t _restartTimeout)
+  : rescanPeriod(_rescanPeriod)
+  , restartTimeout(_restartTimeout)
+  , wifiUp(false)
+  , brokerUp(false)
+  , recovering(false)
+  , wifiLostAt(0)
+  , wifiUpAt(0)
+  , offlineSince(0)
+  , lastRescan(0)
+  , outageCount(0)
+  , lastOutageTime(0)
+  , maxOutageTime(0)
+  , lastRecoveryTime(0)
+  , buffered(0)
+  , expired(0) {
+}
+
+bool ConnectionMonitor::update(uint32_t now, bool _wifiUp, bool _brokerUp) {
+  bool restored = false;
+
+  if (_wifiUp != wifiUp) {
+    wifiUp = _wifiUp;
+    if (wifiUp) {
+      // the first connection after boot is not an outage
+      if (outageCount > 0) {
+        lastOutageTime = now - wifiLostAt;
+        if (lastOutageTime > maxOutageTime) {
+          maxOutageTime = lastOutageTime;
+        }
+        LOG_INFO("WiFi", "link back after %u ms", lastOutageTime);
+      }
+      wifiUpAt = now;
+      recovering = true;
+      restored = true;
+    } else {
+      outageCount++;
+      wifiLostAt = now;
+      lastRescan = now;
+      recovering = false;
+      LOG_WARN("WiFi", "link lost, the keypad goes on offline");
+    }
+  }
+
+  if (_brokerUp != brokerUp) {
+    brokerUp = _brokerUp;
+    if (brokerUp) {
+      if (recovering) {
+        lastRecoveryTime = now - wifiUpAt;
+        recovering = false;
+      }
+    } else {
+      offlineSince = now;
+    }
+  }
+
+  return restored;
+}
+
+bool ConnectionMonitor::shouldRescan(uint32_t now) {
+  if (wifiUp || now - lastRescan < rescanPeriod) {
+    return false;
+  }
+  lastRescan = now;
+  return true;
+}
+
+void ConnectionMonitor::write(JsonWriter &json) const {
+  json.add("wifi_outages", outageCount);
+  json.add("wifi_outage_ms", lastOutageTime);
+  json.add("wifi_outage_max_ms", maxOutageTime);
+  json.add("wifi_recovery_ms", lastRecoveryTime);
+  json.add("offline_codes", buffered);
+  json.add("codes_expired", expired);
+}
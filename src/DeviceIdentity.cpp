@@ -0,0 +1,49 @@
+#include "DeviceIdentity.h"
+
+#include <ESP8266WiFi.h>
+
+DeviceIdentity::DeviceIdentity()
+  : hash(0) {
+  topicState[0] = 0;
+  topicCode[0] = 0;
+  topicCommand[0] = 0;
+  topicMetrics[0] = 0;
+  topicStatus[0] = 0;
+  topicDelta[0] = 0;
+  topicCodes[0] = 0;
+  topicLog[0] = 0;
+  topicLatency[0] = 0;
+  topicTrace[0] = 0;
+}
+
+void DeviceIdentity::begin() {
+  // FNV-1a over the MAC, the low bytes alone are too alike in a batch
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  hash = 2166136261u;
+  for (uint8_t i = 0; i < sizeof(mac); i++) {
+    hash = (hash ^ mac[i]) * 16777619u;
+  }
+
+  char prefix[MQTT_TOPIC_SIZE];
+#if MQTT_TOPIC_PER_DEVICE
+  snprintf(prefix, sizeof(prefix), "%s/%06x", MQTT_TOPIC_PREFIX, ESP.getChipId());
+#else
+  snprintf(prefix, sizeof(prefix), "%s", MQTT_TOPIC_PREFIX);
+#endif
+
+  buildTopic(topicState, prefix, "");
+  buildTopic(topicCode, prefix, MQTT_SUFFIX_CODE);
+  buildTopic(topicCommand, prefix, MQTT_SUFFIX_COMMAND);
+  buildTopic(topicMetrics, prefix, MQTT_SUFFIX_METRICS);
+  buildTopic(topicStatus, prefix, MQTT_SUFFIX_STATUS);
+  buildTopic(topicDelta, prefix, MQTT_SUFFIX_DELTA);
+  buildTopic(topicCodes, prefix, MQTT_SUFFIX_CODES);
+  buildTopic(topicLog, prefix, MQTT_SUFFIX_LOG);
+  buildTopic(topicLatency, prefix, MQTT_SUFFIX_LATENCY);
+  buildTopic(topicTrace, prefix, MQTT_SUFFIX_TRACE);
+}
+
+void DeviceIdentity::buildTopic(char *topic, const char *prefix, const char *suffix) {
+  snprintf(topic, MQTT_TOPIC_SIZE, "%s%s", prefix, suffix);
+}
@@ -0,0 +1,235 @@
+#include "DiagnosticsServer.h"
+#include "Logger.h"
+
+bool DiagnosticsWebServer::handleClient() {
+  if (_currentStatus == HC_NONE) {
+    WiFiClient client = _server.available();
+    if (!client) {
+      return false;
+    }
+    client.setTimeout(timeout);
+    _currentClient = client;
+    _currentStatus = HC_WAIT_READ;
+    _statusChange = millis();
+  }
+  ESP8266WebServer::handleClient();
+  return true;
+}
+
+DiagnosticsServer::DiagnosticsServer(uint16_t port, const DiagnosticField *_fields, size_t _count,
+                                     DiagnosticNumber _number, DiagnosticText _text)
+  : server(port, DIAG_HTTP_TIMEOUT)
+  , fields(_fields)
+  , count(_count)
+  , number(_number)
+  , text(_text)
+  , chunkLength(0)
+  , aborted(false)
+  , responseStart(0)
+  , running(false)
+  , requestCount(0)
+  , lastServe(0)
+  , maxServe(0) {
+}
+
+void DiagnosticsServer::begin() {
+  server.on("/status", HTTP_GET, [this]() { serveStatus(); });
+  server.on("/metrics", HTTP_GET, [this]() { serveMetrics(); });
+  server.onNotFound([this]() { serveNotFound(); });
+  server.begin();
+  running = true;
+}
+
+void DiagnosticsServer::stop() {
+  if (running) {
+    server.stop();
+    running = false;
+  }
+}
+
+void DiagnosticsServer::handle() {
+  if (!running) {
+    return;
+  }
+  unsigned long start = micros();
+  if (server.handleClient()) {
+    lastServe = micros() - start;
+    if (lastServe > maxServe) {
+      maxServe = lastServe;
+    }
+  }
+}
+
+void DiagnosticsServer::serveStatus() {
+  beginResponse(PSTR("application/json"));
+  char buffer[48];
+  for (size_t i = 0; i < count; i++) {
+    DiagnosticField field;
+    memcpy_P(&field, &fields[i], sizeof(field));
+    write(i == 0 ? "{\"" : ",\"", 2);
+    write(field.name, strlen(field.name));
+    write("\":", 2);
+    if (field.type == DIAG_TEXT) {
+      write("\"", 1);
+      writeEscaped(text(field.id, buffer, sizeof(buffer)));
+      write("\"", 1);
+    } else {
+      writeNumber(number(field.id), field.type == DIAG_SIGNED);
+    }
+  }
+  write("}", 1);
+  endResponse();
+}
+
+void DiagnosticsServer::serveMetrics() {
+  beginResponse(PSTR("text/plain; version=0.0.4"));
+  char buffer[48];
+
+  // The text fields are the labels of a single info metric
+  writeP(PSTR("# HELP keypad_info Firmware and configuration\n# TYPE keypad_info gauge\nkeypad_info{"));
+  bool first = true;
+  for (size_t i = 0; i < count; i++) {
+    DiagnosticField field;
+    memcpy_P(&field, &fields[i], sizeof(field));
+    if (field.type != DIAG_TEXT) {
+      continue;
+    }
+    if (!first) {
+      write(",", 1);
+    }
+    first = false;
+    write(field.name, strlen(field.name));
+    write("=\"", 2);
+    writeEscaped(text(field.id, buffer, sizeof(buffer)));
+    write("\"", 1);
+  }
+  writeP(PSTR("} 1\n"));
+
+  for (size_t i = 0; i < count; i++) {
+    DiagnosticField field;
+    memcpy_P(&field, &fields[i], sizeof(field));
+    if (field.type == DIAG_TEXT) {
+      continue;
+    }
+    bool counter = field.type == DIAG_COUNTER;
+    // # HELP <name> <help>, # TYPE <name> <type>, <name> <value>
+    for (uint8_t line = 0; line < 3; line++) {
+      if (line < 2) {
+        writeP(line == 0 ? PSTR("# HELP ") : PSTR("# TYPE "));
+      }
+      writeP(PSTR("keypad_"));
+      write(field.name, strlen(field.name));
+      if (counter) {
+        writeP(PSTR("_total"));
+      }
+      write(" ", 1);
+      if (line == 0) {
+        write(field.help, strlen(field.help));
+      } else if (line == 1) {
+        writeP(counter ? PSTR("counter") : PSTR("gauge"));
+      } else {
+        writeNumber(number(field.id), field.type == DIAG_SIGNED);
+      }
+      write("\n", 1);
+    }
+  }
+  endResponse();
+}
+
+void DiagnosticsServer::serveNotFound() {
+  requestCount++;
+  server.send(404, "text/plain", "not found: /status, /metrics\n");
+}
+
+void DiagnosticsServer::beginResponse(const char *type) {
+  requestCount++;
+  char contentType[32];
+  strncpy_P(contentType, type, sizeof(contentType) - 1);
+  contentType[sizeof(contentType) - 1] = 0;
+  // Sent with chunked transfer encoding
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  // The server allows HTTP_MAX_SEND_WAIT for each write of the handler
+  server.client().setTimeout(DIAG_HTTP_TIMEOUT);
+  responseStart = millis();
+  server.send(200, contentType, "");
+  chunkLength = 0;
+  aborted = !server.client().connected();
+}
+
+void DiagnosticsServer::endResponse() {
+  flush();
+  // The empty chunk ends the response
+  if (!aborted) {
+    server.sendContent("");
+  }
+}
+
+void DiagnosticsServer::write(const char *data, size_t length) {
+  while (length > 0) {
+    size_t n = sizeof(chunk) - chunkLength;
+    if (n > length) {
+      n = length;
+    }
+    memcpy(chunk + chunkLength, data, n);
+    chunkLength += n;
+    data += n;
+    length -= n;
+    if (chunkLength == sizeof(chunk)) {
+      flush();
+    }
+  }
+}
+
+void DiagnosticsServer::writeP(const char *text) {
+  size_t length = strlen_P(text);
+  while (length > 0) {
+    size_t n = sizeof(chunk) - chunkLength;
+    if (n > length) {
+      n = length;
+    }
+    memcpy_P(chunk + chunkLength, text, n);
+    chunkLength += n;
+    text += n;
+    length -= n;
+    if (chunkLength == sizeof(chunk)) {
+      flush();
+    }
+  }
+}
+
+void DiagnosticsServer::writeNumber(uint32_t value, bool isSigned) {
+  char digits[12];
+  int length = isSigned ? snprintf(digits, sizeof(digits), "%ld", (long)(int32_t)value)
+                        : snprintf(digits, sizeof(digits), "%lu", (unsigned long)value);
+  write(digits, length);
+}
+
+void DiagnosticsServer::writeEscaped(const char *value) {
+  // The same escapes for JSON strings and Prometheus label values
+  for (const char *c = value; *c != 0; c++) {
+    if (*c == '"' || *c == '\\') {
+      write("\\", 1);
+    } else if (*c == '\n') {
+      write("\\n", 2);
+      continue;
+    }
+    write(c, 1);
+  }
+}
+
+void DiagnosticsServer::flush() {
+  if (chunkLength > 0 && !aborted) {
+    // The writes of a response share the timeout, a client reading just
+    // fast enough for each one would hold loop() up for all of them
+    unsigned long elapsed = millis() - responseStart;
+    if (elapsed < DIAG_HTTP_TIMEOUT) {
+      server.client().setTimeout(DIAG_HTTP_TIMEOUT - elapsed);
+      server.sendContent(chunk, chunkLength);
+    } else {
+      server.client().stop();
+    }
+    // A write that timed out closed the connection
+    aborted = !server.client().connected();
+  }
+  chunkLength = 0;
+}
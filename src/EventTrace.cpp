@@ -0,0 +1,143 @@
+#include "EventTrace.h"
+
+#include <string.h>
+
+EventTrace::EventTrace()
+  : length(0)
+  , lastTime(0)
+  , frame(0)
+  , frameSince(0)
+  , recording(false)
+  , full(false) {
+}
+
+void EventTrace::start(uint32_t now, uint32_t seed) {
+  buffer[0] = 'K';
+  buffer[1] = 'P';
+  buffer[2] = 'T';
+  buffer[3] = VERSION;
+  for (uint8_t i = 0; i < 4; i++) {
+    buffer[4 + i] = (uint8_t)(now >> (8 * i));
+  }
+  buffer[8] = EVENT_TRACE_LED_HOLD;
+  for (uint8_t i = 0; i < 4; i++) {
+    buffer[9 + i] = (uint8_t)(seed >> (8 * i));
+  }
+  length = HEADER_SIZE;
+  lastTime = now;
+  // The next leds() tells the frame on the strip
+  frameSince = now;
+  full = false;
+  recording = true;
+}
+
+size_t EventTrace::varintSize(uint32_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+void EventTrace::putVarint(uint32_t value) {
+  while (value >= 0x80) {
+    buffer[length++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  buffer[length++] = (uint8_t)value;
+}
+
+void EventTrace::putBytes(const void *bytes, size_t count) {
+  memcpy(buffer + length, bytes, count);
+  length += count;
+}
+
+bool EventTrace::begin(Type type, uint32_t time, size_t size) {
+  if (!recording) {
+    return false;
+  }
+  // A key press is stamped with the time its contact closed, which can be
+  // before the last record
+  uint32_t delta = (int32_t)(time - lastTime) > 0 ? time - lastTime : 0;
+  if (length + 1 + varintSize(delta) + size > EVENT_TRACE_SIZE) {
+    recording = false;
+    full = true;
+    return false;
+  }
+  buffer[length++] = type;
+  putVarint(delta);
+  lastTime += delta;
+  return true;
+}
+
+char EventTrace::mask(char key) {
+  return (key == '*' || key == '#') ? key : MASKED_KEY;
+}
+
+void EventTrace::key(uint32_t time, char key) {
+  if (begin(KEY, time, 1)) {
+    buffer[length++] = mask(key);
+  }
+}
+
+void EventTrace::message(uint32_t now, const char *topic, const char *chunk, size_t size, size_t index, size_t total) {
+  if (index > 0) {
+    if (begin(MESSAGE_DATA, now, varintSize(size) + size)) {
+      putVarint(size);
+      putBytes(chunk, size);
+    }
+    return;
+  }
+  size_t topicLength = strlen(topic);
+  if (begin(MESSAGE, now, varintSize(topicLength) + topicLength + varintSize(total) + varintSize(size) + size)) {
+    putVarint(topicLength);
+    putBytes(topic, topicLength);
+    putVarint(total);
+    putVarint(size);
+    putBytes(chunk, size);
+  }
+}
+
+void EventTrace::connected(uint32_t now) {
+  begin(CONNECT, now, 0);
+}
+
+void EventTrace::disconnected(uint32_t now, uint8_t reason) {
+  if (begin(DISCONNECT, now, 1)) {
+    buffer[length++] = reason;
+  }
+}
+
+void EventTrace::code(uint32_t now, const char *digits, size_t size) {
+  if (begin(CODE, now, varintSize(size) + size)) {
+    putVarint(size);
+    for (size_t i = 0; i < size; i++) {
+      buffer[length++] = mask(digits[i]);
+    }
+  }
+}
+
+void EventTrace::leds(uint32_t now, uint32_t checksum) {
+  if (checksum == frame) {
+    return;
+  }
+  if (now - frameSince >= EVENT_TRACE_LED_HOLD && begin(LEDS, now, 4)) {
+    for (uint8_t i = 0; i < 4; i++) {
+      buffer[length++] = (uint8_t)(frame >> (8 * i));
+    }
+  }
+  frame = checksum;
+  frameSince = now;
+}
+
+uint32_t EventTrace::frameChecksum(const uint32_t *colors, uint8_t count) {
+  uint32_t hash = 2166136261u;
+  for (uint8_t i = 0; i < count; i++) {
+    for (int8_t shift = 16; shift >= 0; shift -= 8) {
+      hash ^= (uint8_t)(colors[i] >> shift);
+      hash *= 16777619u;
+    }
+  }
+  return hash;
+}
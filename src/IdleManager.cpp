@@ -0,0 +1,77 @@
+#include "IdleManager.h"
+#include "config.h"
+#include "Logger.h"
+
+#include <ESP8266WiFi.h>
+
+IdleManager::IdleManager(KeyScanner &_keypad, uint32_t _timeout)
+  : keypad(_keypad)
+  , timeout(_timeout)
+  , idle(false)
+  , wakePending(false)
+  , lastActivity(0)
+  , wakeCount(0)
+  , lastLatency(0)
+  , maxLatency(0)
+  , asleep(0)
+  , intervalStart(0) {
+}
+
+void IdleManager::keyRegistered(uint32_t now) {
+  checkWake(now);
+  lastActivity = now;
+  if (wakePending) {
+    wakePending = false;
+    lastLatency = now - keypad.wokeAt();
+    if (lastLatency > maxLatency) {
+      maxLatency = lastLatency;
+    }
+  }
+}
+
+void IdleManager::update(uint32_t now, bool canSleep) {
+  checkWake(now);
+  if (idle) {
+    if (!canSleep) {
+      lastActivity = now;
+      leave();
+    }
+  } else if (!canSleep) {
+    lastActivity = now;
+  } else if (now - lastActivity >= timeout) {
+    enter(now);
+  }
+}
+
+void IdleManager::checkWake(uint32_t now) {
+  if (idle && !keypad.isSleeping()) {
+    // a key press woke the scanner up
+    wakeCount++;
+    wakePending = true;
+    lastActivity = now;
+    leave();
+  }
+}
+
+void IdleManager::enter(uint32_t now) {
+  LOG_INFO("Idle", "sleeping after %u ms without activity", now - lastActivity);
+  idle = true;
+  wakePending = false;
+  keypad.sleep();
+  WiFi.setSleepMode(WIFI_LIGHT_SLEEP, IDLE_LISTEN_INTERVAL);
+}
+
+void IdleManager::leave() {
+  LOG_INFO("Idle", "awake");
+  idle = false;
+  keypad.wake();
+  WiFi.setSleepMode(WIFI_MODEM_SLEEP);
+}
+
+uint8_t IdleManager::asleepPercent(uint32_t now) {
+  uint32_t elapsed = now - intervalStart;
+  uint8_t percent = elapsed > 0 ? (uint8_t)((uint64_t)asleep * 100 / elapsed) : 0;
+  intervalStart = now;
+  asleep = 0;
+  return percent;
+}
@@ -0,0 +1,179 @@
+#include "KeyScanner.h"
+#include "config.h"
+#include "Logger.h"
+
+#ifndef NATIVE_BUILD
+extern "C" {
+#include "gpio.h"
+}
+#endif
+
+KeyScanner *KeyScanner::instance = NULL;
+
+KeyScanner::KeyScanner(const char *_keymap, const byte *_rowPins, const byte *_colPins, byte _rows, byte _cols)
+  : keymap(_keymap)
+  , rowPins(_rowPins)
+  , colPins(_colPins)
+  , rows(_rows)
+  , cols(_cols)
+  , fastRequested(false)
+  , period(0)
+  , raw(0)
+  , debounced(0)
+  , changedAt(0)
+  , scans(0)
+  , sleeping(false)
+  , rowInterrupts(false)
+  , wakeTime(0) {
+}
+
+void KeyScanner::begin() {
+  if (rows * cols > 16) {
+    LOG_ERROR("Keys", "the matrix is limited to 16 keys");
+    return;
+  }
+
+  // Rows are read with pull-ups, columns are driven low one at a time
+  for (byte r = 0; r < rows; r++) {
+    pinMode(rowPins[r], INPUT_PULLUP);
+  }
+  releaseColumns();
+
+  instance = this;
+  timer1_attachInterrupt(onTimer);
+  startTimer();
+  setPeriod(KEYPAD_SCAN_IDLE_MS);
+}
+
+void KeyScanner::sleep() {
+  if (sleeping) {
+    return;
+  }
+  timer1_disable();
+
+  // Any key now connects its row to a low column
+  for (byte c = 0; c < cols; c++) {
+    pinMode(colPins[c], OUTPUT);
+    digitalWrite(colPins[c], LOW);
+  }
+  sleeping = true;
+  for (byte r = 0; r < rows; r++) {
+    attachInterrupt(digitalPinToInterrupt(rowPins[r]), onRowInterrupt, FALLING);
+#ifndef NATIVE_BUILD
+    // Also brings the CPU out of light sleep. This makes the interrupt of
+    // the pin a low level one, onRowInterrupt() turns it off.
+    gpio_pin_wakeup_enable(GPIO_ID_PIN(rowPins[r]), GPIO_PIN_INTR_LOLEVEL);
+#endif
+  }
+  rowInterrupts = true;
+}
+
+void KeyScanner::wake() {
+  if (rowInterrupts) {
+    for (byte r = 0; r < rows; r++) {
+      detachInterrupt(digitalPinToInterrupt(rowPins[r]));
+    }
+#ifndef NATIVE_BUILD
+    gpio_pin_wakeup_disable();
+#endif
+    rowInterrupts = false;
+  }
+  if (sleeping) {
+    // woken up by the firmware, not by a key
+    sleeping = false;
+    releaseColumns();
+    startTimer();
+    setPeriod(KEYPAD_SCAN_IDLE_MS);
+  }
+}
+
+void ICACHE_RAM_ATTR KeyScanner::onTimer() {
+  instance->scan();
+}
+
+void ICACHE_RAM_ATTR KeyScanner::onRowInterrupt() {
+  KeyScanner *self = instance;
+  if (!self->sleeping) {
+    // the scan itself moves the rows until wake() detaches us
+    return;
+  }
+  // The held key keeps its row low, with the level interrupt of the wakeup
+  // we would be back here until loop() gets to wake()
+  self->disarmRows();
+  self->sleeping = false;
+  uint32_t now = millis();
+  self->wakeTime = now;
+  // The scan debounces the press that woke us, at the fast rate
+  self->changedAt = now;
+  self->releaseColumns();
+  self->startTimer();
+  self->setPeriod(KEYPAD_SCAN_FAST_MS);
+}
+
+void ICACHE_RAM_ATTR KeyScanner::disarmRows() {
+#ifndef NATIVE_BUILD
+  // What gpio_pin_wakeup_disable() does, which is not in IRAM: the
+  // interrupt type and the wakeup enable bit above it cleared on the rows.
+  // wake() still detaches them.
+  for (byte r = 0; r < rows; r++) {
+    if (rowPins[r] < 16) {
+      GPC(rowPins[r]) &= ~(0xF << GPCI);
+    }
+  }
+#endif
+}
+
+void ICACHE_RAM_ATTR KeyScanner::startTimer() {
+  period = 0;
+  timer1_enable(TIM_DIV256, TIM_EDGE, TIM_LOOP);
+}
+
+void ICACHE_RAM_ATTR KeyScanner::releaseColumns() {
+  for (byte c = 0; c < cols; c++) {
+    pinMode(colPins[c], INPUT);
+  }
+}
+
+void ICACHE_RAM_ATTR KeyScanner::setPeriod(uint16_t ms) {
+  if (period != ms) {
+    period = ms;
+    // TIM_DIV256 runs at 312.5kHz
+    timer1_write((uint32_t)ms * 625 / 2);
+  }
+}
+
+void ICACHE_RAM_ATTR KeyScanner::scan() {
+  scans++;
+  uint32_t now = millis();
+
+  uint16_t sample = 0;
+  for (byte c = 0; c < cols; c++) {
+    pinMode(colPins[c], OUTPUT);
+    digitalWrite(colPins[c], LOW);
+    for (byte r = 0; r < rows; r++) {
+      if (digitalRead(rowPins[r]) == LOW) {
+        sample |= 1 << (r * cols + c);
+      }
+    }
+    digitalWrite(colPins[c], HIGH);
+    pinMode(colPins[c], INPUT);
+  }
+
+  if (sample != raw) {
+    // the matrix is moving, wait until it settles
+    raw = sample;
+    changedAt = now;
+  } else if (raw != debounced && (now - changedAt) >= KEYPAD_DEBOUNCE_MS) {
+    uint16_t pressed = raw & ~debounced;
+    debounced = raw;
+    for (byte k = 0; pressed != 0; k++, pressed >>= 1) {
+      if (pressed & 1) {
+        KeyEvent event = { keymap[k], changedAt };
+        events.push(event);
+      }
+    }
+  }
+
+  bool busy = fastRequested || raw != 0 || (now - changedAt) < KEYPAD_SCAN_FAST_HOLD_MS;
+  setPeriod(busy ? KEYPAD_SCAN_FAST_MS : KEYPAD_SCAN_IDLE_MS);
+}
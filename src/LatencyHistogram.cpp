@@ -0,0 +1,67 @@
+#include "LatencyHistogram.h"
+
+namespace {
+  const uint32_t latencyBucketLimits[LatencyHistogram::BUCKETS] = {
+    10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 0xFFFFFFFF
+  };
+}
+
+LatencyHistogram::LatencyHistogram()
+  : buckets()
+  , total(0)
+  , count(0)
+  , lastValue(0)
+  , maxValue(0) {
+}
+
+uint32_t LatencyHistogram::bucketLimit(uint8_t bucket) {
+  return latencyBucketLimits[bucket];
+}
+
+void LatencyHistogram::add(uint32_t ms) {
+  uint8_t bucket = 0;
+  while (bucket < BUCKETS - 1 && ms >= bucketLimit(bucket)) {
+    bucket++;
+  }
+  buckets[bucket]++;
+  total++;
+  count++;
+  lastValue = ms;
+  if (ms > maxValue) {
+    maxValue = ms;
+  }
+
+  if (total >= LATENCY_WINDOW) {
+    total = 0;
+    for (uint8_t b = 0; b < BUCKETS; b++) {
+      buckets[b] /= 2;
+      total += buckets[b];
+    }
+  }
+}
+
+uint32_t LatencyHistogram::percentile(uint8_t pct) const {
+  if (total == 0) {
+    return 0;
+  }
+  uint32_t rank = (total * pct + 99) / 100;
+  uint32_t seen = 0;
+  for (uint8_t b = 0; b < BUCKETS - 1; b++) {
+    seen += buckets[b];
+    if (seen >= rank) {
+      return bucketLimit(b) < maxValue ? bucketLimit(b) : maxValue;
+    }
+  }
+  // Past the last limit the maximum is the best bound there is
+  return maxValue;
+}
+
+void LatencyHistogram::write(JsonWriter &json, const char *name) const {
+  char key[24];
+  uint32_t summary[4] = { lastValue, percentile(50), percentile(90), maxValue };
+  snprintf(key, sizeof(key), "%s_ms", name);
+  json.addArray(key, summary, 4);
+  // <10ms, <20ms, <50ms, <100ms, <200ms, <500ms, <1s, <2s, <5s, <10s, more
+  snprintf(key, sizeof(key), "%s_hist", name);
+  json.addArray(key, buckets, BUCKETS);
+}
@@ -0,0 +1,130 @@
+#include "LedCompositor.h"
+
+// Perceived brightness to PWM duty, gamma 2.2
+static const uint8_t GAMMA[256] PROGMEM = {
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+    1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+    3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+    6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+   12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+   20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+   30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+   42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+   56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+   73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+   91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+  113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+  137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+  163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+  192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+  223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255
+};
+
+LedCompositor::LedCompositor(LedStrip &_strip)
+  : strip(_strip)
+  , layers()
+  , active()
+  , shown()
+  , dirty(true)
+  , pending(false)
+  , frames(0)
+  , updateCount(0)
+  , lastShow(0)
+  , maxShow(0) {
+  active[LAYER_CODE] = true;
+  setBrightness(255);
+}
+
+void LedCompositor::setBrightness(uint8_t brightness) {
+  for (uint16_t v = 0; v < 256; v++) {
+    correction[v] = ((uint16_t)pgm_read_byte(&GAMMA[v]) * (brightness + 1)) >> 8;
+  }
+  pending = true;
+}
+
+void LedCompositor::setPixel(Layer layer, uint8_t n, uint32_t color) {
+  if (n >= DIGITS || layers[layer][n] == color) {
+    return;
+  }
+  layers[layer][n] = color;
+  if (active[layer]) {
+    dirty = true;
+  }
+}
+
+void LedCompositor::fill(Layer layer, uint32_t color) {
+  for (uint8_t i = 0; i < DIGITS; i++) {
+    setPixel(layer, i, color);
+  }
+}
+
+void LedCompositor::setActive(Layer layer, bool _active) {
+  if (active[layer] != _active) {
+    active[layer] = _active;
+    dirty = true;
+  }
+}
+
+/* Returns true if the composed frame differs from the one on the strip */
+bool LedCompositor::compose() {
+  int top = LAYER_CODE;
+  for (int l = LAYER_COUNT - 1; l > LAYER_CODE; l--) {
+    if (active[l]) {
+      top = l;
+      break;
+    }
+  }
+
+  bool changed = false;
+  for (uint8_t i = 0; i < DIGITS; i++) {
+    uint32_t color = active[top] ? layers[top][i] : 0;
+    if (shown[i] != color) {
+      shown[i] = color;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+uint32_t LedCompositor::outputColor(uint8_t n) const {
+  uint32_t color = shown[n];
+  return ((uint32_t)correction[(uint8_t)(color >> 16)] << 16) | ((uint32_t)correction[(uint8_t)(color >> 8)] << 8)
+         | correction[(uint8_t)color];
+}
+
+void LedCompositor::push() {
+  for (uint8_t i = 0; i < DIGITS; i++) {
+    uint32_t color = shown[i];
+    strip.setPixelColor(i, correction[(uint8_t)(color >> 16)], correction[(uint8_t)(color >> 8)], correction[(uint8_t)color]);
+  }
+  unsigned long start = micros();
+  strip.show();
+  lastShow = micros() - start;
+  if (lastShow > maxShow) {
+    maxShow = lastShow;
+  }
+  pending = false;
+  frames++;
+}
+
+void LedCompositor::update() {
+  updateCount++;
+  if (dirty) {
+    dirty = false;
+    if (compose()) {
+      pending = true;
+    }
+  }
+  if (pending && strip.canShow()) {
+    push();
+  }
+}
+
+void LedCompositor::forceShow() {
+  dirty = false;
+  compose();
+  pending = true;
+  if (strip.canShow()) {
+    push();
+  }
+}
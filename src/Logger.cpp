@@ -0,0 +1,120 @@
+#include "Logger.h"
+
+namespace {
+  const char LEVEL_LETTERS[] = "-EWID";
+}
+
+static_assert(LOG_LINE_SIZE <= 255, "LOG_LINE_SIZE must fit the line length");
+
+// The serial log of every module, drained when loop() is idle
+Logger logger;
+
+Logger::Logger()
+  : lines()
+  , sent(0)
+  , frontSunk(false)
+  , level(LOG_LEVEL)
+  , blocking(false)
+  , sink(NULL)
+  , sinkLevel(LOG_LEVEL_NONE)
+  , dropped(0)
+  , droppedReported(0) {
+}
+
+void Logger::write(uint8_t _level, const char *tag, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  vwrite(_level, tag, format, args);
+  va_end(args);
+}
+
+void Logger::vwrite(uint8_t _level, const char *tag, const char *format, va_list args) {
+  if (_level > level && _level > sinkLevel) {
+    return;
+  }
+  if (lines.isFull()) {
+    if (!blocking) {
+      dropped++;
+      return;
+    }
+    flush();
+  }
+
+  // "12.345 I MQTT: text\n"
+  Line line;
+  line.level = _level;
+  unsigned long now = millis();
+  int length = snprintf(line.text, sizeof(line.text), "%lu.%03lu %c ", now / 1000, now % 1000,
+                        LEVEL_LETTERS[_level < sizeof(LEVEL_LETTERS) - 1 ? _level : 0]);
+  for (char c; length < (int)sizeof(line.text) - 3 && (c = pgm_read_byte(tag)) != 0; tag++) {
+    line.text[length++] = c;
+  }
+  line.text[length++] = ':';
+  line.text[length++] = ' ';
+  int text = vsnprintf_P(line.text + length, sizeof(line.text) - length, format, args);
+  length += text < (int)sizeof(line.text) - length ? text : (int)sizeof(line.text) - length - 1;
+  // Truncated lines keep their end of line
+  if (length >= (int)sizeof(line.text) - 1) {
+    length = sizeof(line.text) - 2;
+  }
+  line.text[length++] = '\n';
+  line.text[length] = 0;
+  line.length = length;
+  lines.push(line);
+
+  if (blocking) {
+    flush();
+  }
+}
+
+/* Write the rest of the front line, returns true once it is done */
+bool Logger::writeFront(bool wait) {
+  Line done;
+  if (!frontSunk && sink != NULL && lines.front().level <= sinkLevel) {
+    // The sink may log itself, it gets a copy
+    Line copy = lines.front();
+    frontSunk = true;
+    sink(copy.text, copy.length - 1);
+  }
+  const Line &line = lines.front();
+  if (line.level > level) {
+    lines.pop(done);
+    frontSunk = false;
+    return true;
+  }
+
+  size_t room = line.length - sent;
+  if (!wait) {
+    int available = Serial.availableForWrite();
+    if (available <= 0) {
+      return false;
+    }
+    if ((size_t)available < room) {
+      room = available;
+    }
+  }
+  sent += Serial.write((const uint8_t *)line.text + sent, room);
+  if (sent < line.length) {
+    return false;
+  }
+  lines.pop(done);
+  sent = 0;
+  frontSunk = false;
+  return true;
+}
+
+void Logger::drain() {
+  while (!lines.isEmpty() && writeFront(false)) {
+  }
+  if (lines.isEmpty() && dropped != droppedReported) {
+    uint32_t lost = dropped - droppedReported;
+    droppedReported = dropped;
+    write(LOG_LEVEL_WARN, PSTR("Log"), PSTR("%u lines dropped"), lost);
+  }
+}
+
+void Logger::flush() {
+  while (!lines.isEmpty()) {
+    writeFront(true);
+  }
+}
@@ -0,0 +1,52 @@
+#include "Metrics.h"
+
+namespace {
+  const uint32_t loopBucketLimits[Metrics::LOOP_BUCKETS] = {
+    100, 500, 1000, 5000, 10000, 50000, 100000, 0xFFFFFFFF
+  };
+}
+
+Metrics::Metrics()
+  : loopStart(0)
+  , loops(0)
+  , maxLoop(0)
+  , loopHistogram()
+  , minFreeHeap(0xFFFFFFFF)
+  , lastCodeLatency(0)
+  , maxCodeLatency(0)
+  , connectHeapBase(0)
+  , connectHeapLow(0)
+  , lastConnectHeap(0)
+  , connecting(false) {
+}
+
+uint32_t Metrics::bucketLimit(uint8_t bucket) {
+  return loopBucketLimits[bucket];
+}
+
+void Metrics::sampleHeap() {
+  uint32_t freeHeap = ESP.getFreeHeap();
+  if (freeHeap < minFreeHeap) {
+    minFreeHeap = freeHeap;
+  }
+}
+
+void Metrics::write(JsonWriter &json) {
+  sampleHeap();
+  json.add("free_heap", ESP.getFreeHeap());
+  json.add("min_free_heap", minFreeHeap);
+  json.add("max_free_block", ESP.getMaxFreeBlockSize());
+  json.add("heap_fragmentation", (unsigned int)ESP.getHeapFragmentation());
+  json.add("loops", loops);
+  json.add("loop_max_us", maxLoop);
+  // <100us, <500us, <1ms, <5ms, <10ms, <50ms, <100ms, more
+  json.addArray("loop_hist", loopHistogram, LOOP_BUCKETS);
+  json.add("code_latency_ms", lastCodeLatency);
+  json.add("code_latency_max_ms", maxCodeLatency);
+  json.add("connect_heap", lastConnectHeap);
+
+  loops = 0;
+  maxLoop = 0;
+  memset(loopHistogram, 0, sizeof(loopHistogram));
+  maxCodeLatency = 0;
+}
@@ -0,0 +1,208 @@
+#include "PublishQueue.h"
+
+#include <string.h>
+#include <Arduino.h>
+#include <AsyncMqttClient.h>
+
+PublishQueue::PublishQueue()
+  : slots()
+  , reserved(NULL)
+  , nextSeq(0)
+  , dropped(0)
+  , sent(0)
+  , lastRtt(0)
+  , maxRtt(0)
+  , lastAckedSeq(0) {
+}
+
+bool PublishQueue::publish(const char *topic, uint8_t qos, bool retain, const char *payload, size_t length) {
+  if (length > PUBLISH_PAYLOAD_SIZE) {
+    dropped++;
+    return false;
+  }
+  char *buffer = acquire(topic, qos, retain);
+  if (buffer == NULL) {
+    return false;
+  }
+  memcpy(buffer, payload, length);
+  submit(length);
+  return true;
+}
+
+char *PublishQueue::acquire(const char *topic, uint8_t qos, bool retain) {
+  cancel();
+
+  Slot *slot = NULL;
+  if (retain) {
+    // only the latest retained value matters
+    for (Slot &s : slots) {
+      if (s.state == QUEUED && s.retain && strcmp(s.topic, topic) == 0) {
+        slot = &s;
+        break;
+      }
+    }
+  }
+
+  if (slot == NULL) {
+    slot = findFree();
+  }
+
+  if (slot == NULL) {
+    // the pool is full: the oldest message which is not in flight makes
+    // room, QoS 0 ones go first
+    slot = oldest(QUEUED, true);
+    if (slot == NULL) {
+      slot = oldest(QUEUED);
+    }
+    if (slot == NULL) {
+      dropped++;
+      return NULL;
+    }
+    dropped++;
+  }
+
+  slot->state = RESERVED;
+  slot->topic = topic;
+  slot->qos = qos;
+  slot->retain = retain;
+  slot->length = 0;
+  slot->packetId = 0;
+  reserved = slot;
+  return slot->payload;
+}
+
+void PublishQueue::submit(size_t length) {
+  if (reserved == NULL) {
+    return;
+  }
+  reserved->length = length < PUBLISH_PAYLOAD_SIZE ? length : PUBLISH_PAYLOAD_SIZE;
+  if (reserved->length < PUBLISH_PAYLOAD_SIZE) {
+    // AsyncMqttClient takes a length of 0 for a C string
+    reserved->payload[reserved->length] = 0;
+  }
+  reserved->seq = nextSeq++;
+  reserved->queuedAt = millis();
+  reserved->state = QUEUED;
+  reserved = NULL;
+}
+
+void PublishQueue::cancel() {
+  if (reserved != NULL) {
+    reserved->state = FREE;
+    reserved = NULL;
+  }
+}
+
+void PublishQueue::flush(AsyncMqttClient &client, uint32_t now) {
+  // A lost ack must not hold a buffer forever, but sending the message
+  // again on the same session would deliver the code twice. The session
+  // is dropped instead, connectionLost() sends it again after the reconnect.
+  for (Slot &s : slots) {
+    if (s.state == IN_FLIGHT && (now - s.sentAt) >= PUBLISH_ACK_TIMEOUT) {
+      if (client.connected()) {
+        client.disconnect(true);
+      }
+      return;
+    }
+  }
+
+  while (client.connected()) {
+    if (inFlight() >= PUBLISH_MAX_IN_FLIGHT) {
+      return;
+    }
+    Slot *slot = oldest(QUEUED);
+    if (slot == NULL) {
+      return;
+    }
+    uint16_t packetId = client.publish(slot->topic, slot->qos, slot->retain, slot->payload, slot->length);
+    if (packetId == 0) {
+      // no room in the TCP buffer, try again on the next loop
+      return;
+    }
+    sent++;
+    if (slot->qos == 0) {
+      slot->state = FREE;
+    } else {
+      slot->state = IN_FLIGHT;
+      slot->packetId = packetId;
+      slot->sentAt = now;
+    }
+  }
+}
+
+bool PublishQueue::acknowledged(uint16_t packetId, uint32_t now) {
+  for (Slot &s : slots) {
+    if (s.state == IN_FLIGHT && s.packetId == packetId) {
+      lastRtt = now - s.sentAt;
+      if (lastRtt > maxRtt) {
+        maxRtt = lastRtt;
+      }
+      lastAckedSeq = s.seq;
+      s.state = FREE;
+      return true;
+    }
+  }
+  return false;
+}
+
+void PublishQueue::connectionLost() {
+  for (Slot &s : slots) {
+    if (s.state == IN_FLIGHT) {
+      s.state = QUEUED;
+    }
+  }
+}
+
+uint32_t PublishQueue::expire(const char *topic, uint32_t maxAge, uint32_t now) {
+  uint32_t count = 0;
+  for (Slot &s : slots) {
+    if (s.state == QUEUED && (now - s.queuedAt) > maxAge && strcmp(s.topic, topic) == 0) {
+      s.state = FREE;
+      dropped++;
+      count++;
+    }
+  }
+  return count;
+}
+
+size_t PublishQueue::depth() const {
+  size_t n = 0;
+  for (const Slot &s : slots) {
+    if (s.state == QUEUED || s.state == IN_FLIGHT) {
+      n++;
+    }
+  }
+  return n;
+}
+
+size_t PublishQueue::inFlight() const {
+  size_t n = 0;
+  for (const Slot &s : slots) {
+    if (s.state == IN_FLIGHT) {
+      n++;
+    }
+  }
+  return n;
+}
+
+PublishQueue::Slot *PublishQueue::findFree() {
+  for (Slot &s : slots) {
+    if (s.state == FREE) {
+      return &s;
+    }
+  }
+  return NULL;
+}
+
+PublishQueue::Slot *PublishQueue::oldest(State state, bool qos0Only) {
+  Slot *found = NULL;
+  for (Slot &s : slots) {
+    if (qos0Only && s.qos != 0) {
+      continue;
+    }
+    if (s.state == state && (found == NULL || (int32_t)(s.seq - found->seq) < 0)) {
+      found = &s;
+    }
+  }
+  return found;
+}
@@ -0,0 +1,85 @@
+#include "ReconnectScheduler.h"
+
+#include <Arduino.h>
+
+ReconnectScheduler::ReconnectScheduler(uint32_t _minDelay, uint32_t _maxDelay, uint32_t _attemptTimeout)
+  : minDelay(_minDelay)
+  , maxDelay(_maxDelay)
+  , attemptTimeout(_attemptTimeout)
+  , state(WAITING)
+  , delay(_minDelay)
+  , nextAttempt(0)
+  , attemptStart(0)
+  , disconnectedAt(0)
+  , totalAttempts(0)
+  , outageAttempts(0)
+  , reconnectCount(0)
+  , reconnectTime(0)
+  , connectTime(0)
+  , everConnected(false) {
+}
+
+void ReconnectScheduler::disconnected(uint32_t now) {
+  if (state == CONNECTED) {
+    // a fresh outage: the first retry comes quickly
+    state = WAITING;
+    delay = minDelay;
+    disconnectedAt = now;
+    outageAttempts = 0;
+    scheduleNext(now);
+  } else if (state == CONNECTING) {
+    // the attempt failed
+    state = WAITING;
+    scheduleNext(now);
+  }
+}
+
+void ReconnectScheduler::connected(uint32_t now) {
+  if (state == CONNECTING) {
+    connectTime = now - attemptStart;
+  }
+  if (state != CONNECTED) {
+    reconnectTime = now - disconnectedAt;
+    if (everConnected) {
+      reconnectCount++;
+    }
+    everConnected = true;
+  }
+  state = CONNECTED;
+  delay = minDelay;
+}
+
+void ReconnectScheduler::networkRestored(uint32_t now) {
+  if (state == WAITING) {
+    delay = minDelay;
+    nextAttempt = now;
+  }
+}
+
+bool ReconnectScheduler::shouldConnect(uint32_t now, bool networkUp) {
+  if (state == CONNECTING && (now - attemptStart) >= attemptTimeout) {
+    // no answer at all, treat it like a failed attempt
+    state = WAITING;
+    scheduleNext(now);
+  }
+
+  if (state != WAITING || (int32_t)(now - nextAttempt) < 0) {
+    return false;
+  }
+  if (!networkUp) {
+    scheduleNext(now);
+    return false;
+  }
+
+  state = CONNECTING;
+  attemptStart = now;
+  totalAttempts++;
+  outageAttempts++;
+  return true;
+}
+
+void ReconnectScheduler::scheduleNext(uint32_t now) {
+  uint32_t half = delay / 2;
+  nextAttempt = now + half + random(half + 1);
+  delay = (delay >= maxDelay / 2) ? maxDelay : delay * 2;
+}
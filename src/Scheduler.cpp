@@ -0,0 +1,136 @@
+#include "Scheduler.h"
+#include "Logger.h"
+
+#include <Arduino.h>
+
+uint64_t millis64() {
+  static uint32_t high = 0;
+  static uint32_t last = 0;
+  uint32_t now = millis();
+  if (now < last) {
+    high++;
+  }
+  last = now;
+  return ((uint64_t)high << 32) | now;
+}
+
+Scheduler::Scheduler() : heap(), size(0) {
+}
+
+bool Scheduler::every(uint32_t period, TaskCallback callback, uint32_t firstDelay) {
+  return schedule(callback, millis64() + firstDelay, period);
+}
+
+bool Scheduler::after(uint32_t delay, TaskCallback callback) {
+  return schedule(callback, millis64() + delay, 0);
+}
+
+bool Scheduler::schedule(TaskCallback callback, uint64_t due, uint32_t period) {
+  cancel(callback);
+  if (size >= SCHEDULER_MAX_TASKS) {
+    LOG_ERROR("Sched", "too many tasks");
+    return false;
+  }
+  heap[size].callback = callback;
+  heap[size].due = due;
+  heap[size].period = period;
+  size++;
+  siftUp(size - 1);
+  return true;
+}
+
+void Scheduler::cancel(TaskCallback callback) {
+  int8_t position = find(callback);
+  if (position >= 0) {
+    remove(position);
+  }
+}
+
+bool Scheduler::isScheduled(TaskCallback callback) const {
+  return find(callback) >= 0;
+}
+
+void Scheduler::run() {
+  uint64_t now = millis64();
+  while (size > 0 && heap[0].due <= now) {
+    Task task = heap[0];
+    remove(0);
+    if (task.period > 0) {
+      // a late task does not run several times to catch up
+      task.due += task.period;
+      if (task.due <= now) {
+        task.due = now + task.period;
+      }
+      schedule(task.callback, task.due, task.period);
+    }
+    // the task may reschedule or cancel itself
+    task.callback();
+  }
+}
+
+uint32_t Scheduler::timeUntilNext(uint32_t cap) const {
+  if (size == 0) {
+    return cap;
+  }
+  uint64_t now = millis64();
+  if (heap[0].due <= now) {
+    return 0;
+  }
+  uint64_t wait = heap[0].due - now;
+  return wait < cap ? (uint32_t)wait : cap;
+}
+
+int8_t Scheduler::find(TaskCallback callback) const {
+  for (uint8_t i = 0; i < size; i++) {
+    if (heap[i].callback == callback) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void Scheduler::remove(uint8_t position) {
+  size--;
+  if (position == size) {
+    return;
+  }
+  heap[position] = heap[size];
+  siftUp(position);
+  siftDown(position);
+}
+
+void Scheduler::siftUp(uint8_t position) {
+  while (position > 0) {
+    uint8_t parent = (position - 1) / 2;
+    if (!earlier(position, parent)) {
+      return;
+    }
+    swap(position, parent);
+    position = parent;
+  }
+}
+
+void Scheduler::siftDown(uint8_t position) {
+  for (;;) {
+    uint8_t smallest = position;
+    uint8_t left = 2 * position + 1;
+    uint8_t right = left + 1;
+    if (left < size && earlier(left, smallest)) {
+      smallest = left;
+    }
+    if (right < size && earlier(right, smallest)) {
+      smallest = right;
+    }
+    if (smallest == position) {
+      return;
+    }
+    swap(position, smallest);
+    position = smallest;
+  }
+}
+
+void Scheduler::swap(uint8_t a, uint8_t b) {
+  Task t = heap[a];
+  heap[a] = heap[b];
+  heap[b] = t;
+}
@@ -0,0 +1,52 @@
+#include "StateDelta.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+StateDelta::StateDelta(int32_t _rssiThreshold)
+  : rssiThreshold(_rssiThreshold)
+  , baseline(false)
+  , last() {
+}
+
+void StateDelta::published(const StateSnapshot &state) {
+  last = state;
+  baseline = true;
+}
+
+uint8_t StateDelta::write(JsonWriter &json, const StateSnapshot &state) {
+  uint8_t changed = 0;
+
+  if (state.ip != last.ip) {
+    char ip[16];
+    snprintf(ip, sizeof(ip), "%u.%u.%u.%u",
+             (unsigned int)(state.ip & 0xFF), (unsigned int)((state.ip >> 8) & 0xFF),
+             (unsigned int)((state.ip >> 16) & 0xFF), (unsigned int)(state.ip >> 24));
+    json.add("ip", ip);
+    last.ip = state.ip;
+    changed++;
+  }
+  if (abs(state.rssi - last.rssi) >= rssiThreshold) {
+    char rssi[8];
+    snprintf(rssi, sizeof(rssi), "%d", (int)state.rssi);
+    json.add("rssi", rssi);
+    last.rssi = state.rssi;
+    changed++;
+  }
+  if (state.mqttAttempts != last.mqttAttempts) {
+    json.add("mqtt_attempts", state.mqttAttempts);
+    last.mqttAttempts = state.mqttAttempts;
+    changed++;
+  }
+  if (state.mqttReconnects != last.mqttReconnects) {
+    json.add("mqtt_reconnects", state.mqttReconnects);
+    last.mqttReconnects = state.mqttReconnects;
+    changed++;
+  }
+  if (state.publishDropped != last.publishDropped) {
+    json.add("publish_dropped", state.publishDropped);
+    last.publishDropped = state.publishDropped;
+    changed++;
+  }
+  return changed;
+}
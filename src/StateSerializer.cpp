@@ -0,0 +1,31 @@
+#include "StateSerializer.h"
+#include "config.h"
+
+#include <ESP8266WiFi.h>
+
+StateSerializer::StateSerializer()
+  : initialized(false)
+  , cachedIp(0)
+  , fixedLength(0) {
+  fixed[0] = 0;
+}
+
+void StateSerializer::writeFixed(JsonWriter &json, uint32_t ip) {
+  if (!initialized || ip != cachedIp) {
+    cachedIp = ip;
+    format();
+    initialized = true;
+  }
+  json.addRaw(fixed, fixedLength);
+}
+
+void StateSerializer::format() {
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  int len = snprintf(fixed, sizeof(fixed),
+                     "\"ip\":\"%u.%u.%u.%u\",\"mac\":\"%02X:%02X:%02X:%02X:%02X:%02X\",\"version\":\"%s\"",
+                     (unsigned int)(cachedIp & 0xFF), (unsigned int)((cachedIp >> 8) & 0xFF),
+                     (unsigned int)((cachedIp >> 16) & 0xFF), (unsigned int)(cachedIp >> 24),
+                     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], FIRMWARE_VERSION);
+  fixedLength = (len > 0 && len < (int)sizeof(fixed)) ? len : 0;
+}
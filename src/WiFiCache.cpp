@@ -0,0 +1,122 @@
+#include "WiFiCache.h"
+#include "Crc32.h"
+#include "config.h"
+#include "Logger.h"
+
+#include <EEPROM.h>
+#include <ESP8266WiFi.h>
+
+extern "C" {
+#include <user_interface.h>
+}
+
+namespace {
+  const uint32_t CACHE_MAGIC = 0x4B505743; // "KPWC"
+}
+
+static_assert(WIFI_CACHE_ADDRESS + 64 <= EEPROM_SIZE, "EEPROM_SIZE is too small for the WiFi cache");
+
+WiFiCache::WiFiCache()
+  : record()
+  , valid(false) {
+}
+
+uint32_t WiFiCache::recordCrc(const Record &record) {
+  return computeCrc32(&record, offsetof(Record, crc));
+}
+
+/* The WiFiManager's WiFi.begin() and the SDK's reconnects after a drop join with the station config in RAM.
+   With the BSSID left locked, they would not find an access point that was replaced or moved to another
+   channel. The association in place is kept. */
+void WiFiCache::unlockAccessPoint(bool save) {
+  struct station_config config;
+  wifi_station_get_config(&config);
+  config.bssid_set = 0;
+  if (save) {
+    wifi_station_set_config(&config);
+  } else {
+    wifi_station_set_config_current(&config);
+  }
+}
+
+bool WiFiCache::load() {
+  EEPROM.begin(EEPROM_SIZE);
+  EEPROM.get(WIFI_CACHE_ADDRESS, record);
+  EEPROM.end();
+
+  valid = record.magic == CACHE_MAGIC && record.crc == recordCrc(record);
+  if (!valid) {
+    memset(&record, 0, sizeof(record));
+  }
+  return valid;
+}
+
+bool WiFiCache::connect(uint32_t timeout) {
+  if (!valid || WiFi.SSID().length() == 0) {
+    return false;
+  }
+
+  LOG_INFO("WiFi", "joining %02X:%02X:%02X:%02X:%02X:%02X on channel %u",
+           record.bssid[0], record.bssid[1], record.bssid[2],
+           record.bssid[3], record.bssid[4], record.bssid[5], record.channel);
+  WiFi.mode(WIFI_STA);
+#if WIFI_CACHE_STATIC_IP
+  if (record.ip != 0) {
+    WiFi.config(IPAddress(record.ip), IPAddress(record.gateway), IPAddress(record.mask), IPAddress(record.dns));
+  }
+#endif
+  // The BSSID and channel go into the station config in RAM only. Saved to
+  // flash, they would lock the SDK's join at boot to this access point.
+  WiFi.persistent(false);
+  WiFi.begin(WiFi.SSID().c_str(), WiFi.psk().c_str(), record.channel, record.bssid);
+  WiFi.persistent(true);
+
+  uint32_t start = millis();
+  while (WiFi.status() != WL_CONNECTED) {
+    if (millis() - start >= timeout) {
+      LOG_WARN("WiFi", "the cached access point did not answer");
+      // WiFi.disconnect() would clear the stored SSID and PSK the
+      // WiFiManager joins with next
+      wifi_station_disconnect();
+      // Saved too, in case an older firmware left the lock in flash
+      unlockAccessPoint(true);
+#if WIFI_CACHE_STATIC_IP
+      // back to DHCP for the full connection
+      WiFi.config(IPAddress(), IPAddress(), IPAddress());
+#endif
+      return false;
+    }
+    delay(10);
+  }
+  unlockAccessPoint(false);
+  return true;
+}
+
+void WiFiCache::store() {
+  if (WiFi.status() != WL_CONNECTED) {
+    return;
+  }
+
+  Record current;
+  memset(&current, 0, sizeof(current));
+  current.magic = CACHE_MAGIC;
+  memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+  current.channel = WiFi.channel();
+  current.ip = WiFi.localIP();
+  current.gateway = WiFi.gatewayIP();
+  current.mask = WiFi.subnetMask();
+  current.dns = WiFi.dnsIP();
+  current.crc = recordCrc(current);
+
+  if (valid && memcmp(&current, &record, sizeof(record)) == 0) {
+    return;
+  }
+
+  record = current;
+  valid = true;
+  EEPROM.begin(EEPROM_SIZE);
+  EEPROM.put(WIFI_CACHE_ADDRESS, record);
+  if (!EEPROM.end()) {
+    LOG_ERROR("WiFi", "failed to write the cache");
+  }
+}
@@ -0,0 +1,92 @@
+#include "Ws2812Uart.h"
+
+#ifdef NATIVE_BUILD
+#include "NativeSim.h"
+#endif
+
+namespace {
+  const uint32_t UART_BAUD = 3200000;
+
+  /*
+   * Two WS2812 bits per character, most significant first. The inverted
+   * start bit opens both bits, the stop bit closes the second one:
+   * a 0 is high for 1 bit time then low for 3, a 1 high for 3 then low for 1.
+   */
+  const uint8_t SYMBOLS[4] = { 0x37, 0x07, 0x34, 0x04 };
+
+  inline uint8_t fifoUsed() {
+#ifdef NATIVE_BUILD
+    return NativeSim::uart1FifoUsed();
+#else
+    return (USS(1) >> USTXC) & 0xFF;
+#endif
+  }
+
+  inline void fifoWrite(uint8_t c) {
+#ifdef NATIVE_BUILD
+    NativeSim::uart1Write(c);
+#else
+    USF(1) = c;
+#endif
+  }
+}
+
+Ws2812Uart::Ws2812Uart(uint16_t n)
+  : numLEDs(n < MAX_PIXELS ? n : MAX_PIXELS)
+  , brightness(0)
+  , pixels()
+  , frameMicros(0)
+  , shownAt(0) {
+  // 8 bit times of 312.5ns per character
+  frameMicros = (uint32_t)numLEDs * BYTES_PER_PIXEL * 5 / 2 + LATCH_US;
+}
+
+void Ws2812Uart::begin() {
+#ifndef NATIVE_BUILD
+  Serial1.begin(UART_BAUD, SERIAL_6N1, SERIAL_TX_ONLY);
+  USC0(1) |= (1 << UCTXI);
+#endif
+  shownAt = micros() - frameMicros;
+}
+
+bool Ws2812Uart::canShow() const {
+  return (uint32_t)(micros() - shownAt) >= frameMicros
+         && fifoUsed() + numLEDs * BYTES_PER_PIXEL <= FIFO_SIZE;
+}
+
+void Ws2812Uart::show() {
+  if (!canShow()) {
+    return;
+  }
+  for (uint16_t i = 0; i < numLEDs * 3; i++) {
+    uint8_t value = pixels[i];
+    fifoWrite(SYMBOLS[(value >> 6) & 3]);
+    fifoWrite(SYMBOLS[(value >> 4) & 3]);
+    fifoWrite(SYMBOLS[(value >> 2) & 3]);
+    fifoWrite(SYMBOLS[value & 3]);
+  }
+  shownAt = micros();
+}
+
+void Ws2812Uart::clear() {
+  memset(pixels, 0, sizeof(pixels));
+}
+
+void Ws2812Uart::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
+  if (n >= numLEDs) {
+    return;
+  }
+  if (brightness) {
+    r = (r * brightness) >> 8;
+    g = (g * brightness) >> 8;
+    b = (b * brightness) >> 8;
+  }
+  uint8_t *p = &pixels[n * 3];
+  p[0] = g;
+  p[1] = r;
+  p[2] = b;
+}
+
+void Ws2812Uart::setPixelColor(uint16_t n, uint32_t c) {
+  setPixelColor(n, (uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c);
+}
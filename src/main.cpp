@@ -1,6 +1,39 @@
-#include "MyQueueArray.h"
+#include "RingBuffer.h"
+#include "LedCompositor.h"
+#include "Animator.h"
+#include "Animations.h"
+#include "KeyScanner.h"
+#include "ReconnectScheduler.h"
+#include "PublishQueue.h"
+#include "MessageAssembler.h"
+#include "CommandTable.h"
+#include "StateSerializer.h"
+#include "Metrics.h"
+#include "Scheduler.h"
+#include "IdleManager.h"
+#include "ConfigStore.h"
+#include "WiFiCache.h"
+#include "BootTimeline.h"
+#include "DeviceIdentity.h"
+#include "StateDelta.h"
+#include "CodeCache.h"
+#include "Logger.h"
+#include "CodeTracer.h"
+#include "EventTrace.h"
+#include "TlsFingerprint.h"
+#include "ConnectionMonitor.h"
+#include "DiagnosticsServer.h"
 #include "config.h"
 
+#if MQTT_TLS && !ASYNC_TCP_SSL_ENABLED
+#error "MQTT_TLS needs AsyncMqttClient built with ASYNC_TCP_SSL_ENABLED=1"
+#endif
+#if MQTT_TLS
+// Without a pinned certificate any broker would be accepted
+static_assert(tlsFingerprintValid(MQTT_TLS_FINGERPRINT),
+              "MQTT_TLS needs MQTT_TLS_FINGERPRINT, the SHA-1 fingerprint of the broker certificate");
+#endif
+
 // https://escapequotes.net/esp8266-wemos-d1-mini-pins-and-diagram/
 // https://learn.adafruit.com/adafruit-neopixel-uberguide/arduino-library-use
 #include <Adafruit_NeoPixel.h>
@@ -14,24 +47,63 @@
 
 #include <AsyncMqttClient.h>      // https://github.com/marvinroger/async-mqtt-client - Async MQTT client
 
-#include <Keypad.h>
-#include <FS.h>
-
-#include <SimpleTimer.h>          // https://github.com/schinken/SimpleTimer
 
 #include <ArduinoJson.h>          // https://github.com/bblanchon/ArduinoJson
 
-// timer
-SimpleTimer timer;
 
-// MQTT
-char mqtt_server[36];
-char mqtt_port[6] = "1883";
-char mqtt_login[36];
-char mqtt_password[36];
+// Periodic and delayed work
+Scheduler scheduler;
+
+// Topics and per-device phase
+DeviceIdentity identity;
+
+// Settings from the configuration portal
+DeviceConfig deviceConfig = { "", MQTT_DEFAULT_PORT, "", "" };
+ConfigStore configStore;
+// Last access point, for the fast boot path
+WiFiCache wifiCache;
+BootTimeline bootTimeline;
+WiFiEventHandler wifiAssociatedHandler;
+WiFiEventHandler wifiGotIpHandler;
 
 // MQTT client
 AsyncMqttClient mqttClient;
+ReconnectScheduler mqttReconnect(MQTT_RECONNECT_MIN_DELAY, MQTT_RECONNECT_MAX_DELAY, MQTT_CONNECT_TIMEOUT);
+// WiFi outages, the keypad keeps working offline
+ConnectionMonitor connection(WIFI_RESCAN_PERIOD, OFFLINE_RESTART_TIMEOUT);
+#if MQTT_TLS
+uint8_t brokerFingerprint[TLS_FINGERPRINT_SIZE];
+bool brokerPinned = false;
+// Attempts put off for lack of heap
+uint32_t tlsDeferred = 0;
+#endif
+// Outbound messages, held while offline
+PublishQueue outbox;
+// Performance counters
+Metrics metrics;
+
+// Preformatted fields of the state document
+StateSerializer stateSerializer;
+// Last published state, for the delta mode
+StateDelta stateDelta(STATE_RSSI_THRESHOLD);
+unsigned long lastFullState = 0;
+// Inbound command payloads, reassembled from their chunks
+MessageAssembler<COMMAND_PAYLOAD_SIZE> commandAssembler;
+// Hashes of the valid codes, for the instant feedback
+MessageAssembler<CODE_CACHE_PAYLOAD_SIZE> codesAssembler;
+CodeCache codeCache;
+unsigned long codeCheckTime = 0; // us
+#if CODE_TRACE
+// Key press to alarm state latencies of the codes
+CodeTracer codeTracer;
+#endif
+#if EVENT_TRACE
+// Inputs and outputs for a replay on the host
+EventTrace eventTrace;
+uint32_t tracedFrames = 0;
+size_t traceDumpOffset = 0;
+size_t traceDumpSize = 0;
+#endif
 
 // WiFi Manager
 // Flag for saving data
@@ -39,7 +111,7 @@ bool shouldSaveConfig = false;
 
 //callback notifying us of the need to save config
 void saveConfigCallback () {
-  Serial.println("Should save config");
+  LOG_DEBUG("Config", "should save config");
   shouldSaveConfig = true;
 }
 
@@ -60,104 +132,71 @@ char keys[ROWS][COLS] =
 //  Wem:  D0  D1  D2 D3  D4  D5 D6
 
 byte rowPins[ROWS] = {D1, D6, D5, D3};  //{R1, R2, R3, R4}
+#if LED_BACKEND == LED_BACKEND_UART1
+// D4 is the UART1 TX, C3 takes the LED pin
+byte colPins[COLS] = {D2, D0, D7};       //{C1, C2, C3}
+#else
 byte colPins[COLS] = {D2, D0, D4};       //{C1, C2, C3}
+#endif
 
-Keypad keypad = Keypad( makeKeymap(keys), rowPins, colPins, ROWS, COLS );
-QueueArray<char> queueInputCode(DIGITS);
+KeyScanner keypad( (const char*)keys, rowPins, colPins, ROWS, COLS );
+RingBuffer<char, DIGITS> queueInputCode;
+// Sleeps when nobody uses the keypad
+IdleManager idle(keypad, IDLE_TIMEOUT);
 
 // Pixels
+#if LED_BACKEND == LED_BACKEND_UART1
+LedStrip pixels(DIGITS);                 // on D4
+#else
 #define LED_PIN D7
-Adafruit_NeoPixel pixels = Adafruit_NeoPixel(DIGITS, LED_PIN, NEO_GRB + NEO_KHZ800);
+LedStrip pixels(DIGITS, LED_PIN, NEO_GRB + NEO_KHZ800);
+#endif
+LedCompositor leds(pixels);
+Animator animator(leds);
 
 
-// Wating animation globals
+// Waiting for the broker, shown by the waiting animation
 bool waActive = false;
-unsigned int waCount = 0;
-byte waActiveLED = 0;
-bool waForward = true;
 
-// Error animation globals
+// Locked keypad, shown by the lock animation
 bool errActive = false;
 
-// Lock the keypad
-unsigned long lock_endtime = 0;
-
-
-void readConfigurationFile() {
-  //read configuration from FS json
-  Serial.println("mounting FS...");
-  if (SPIFFS.begin()) {
-    Serial.println("mounted file system");
-    if (SPIFFS.exists("/config.json")) {
-      //file exists, reading and loading
-      Serial.println("reading config file");
-      File configFile = SPIFFS.open("/config.json", "r");
-      if (configFile) {
-        Serial.println("opened config file");
-        size_t size = configFile.size();
-        // Allocate a buffer to store contents of the file.
-        std::unique_ptr<char[]> buf(new char[size]);
-
-        configFile.readBytes(buf.get(), size);
-        DynamicJsonBuffer jsonBuffer;
-        JsonObject& json = jsonBuffer.parseObject(buf.get());
-        json.printTo(Serial);
-        if (json.success()) {
-          Serial.println("\nparsed json");
-
-          strcpy(mqtt_server, json["mqtt_server"]);
-          strcpy(mqtt_port, json["mqtt_port"]);
-          strcpy(mqtt_login, json["mqtt_login"]);
-          strcpy(mqtt_password, json["mqtt_password"]);
-
-        } else {
-          Serial.println("failed to load json config");
-        }
-      }
-    } else {
-      Serial.println("/config.json not found");
-    }
-  } else {
-    Serial.println("failed to mount FS");
-  }
+// Requested by commands, carried out by loop()
+bool restartRequested = false;
+bool reconfigureRequested = false;
 
-  Serial.println(mqtt_server);
-  Serial.println(mqtt_port);
-  Serial.println(mqtt_login);
-  Serial.println(mqtt_password);
-}
+// Time from the last key press to its handling, for '#' up to the code publish
+unsigned long keyLatency = 0;
+// First key press of the code being entered
+unsigned long codeStartTime = 0;
 
 
-void writeConfigurationFile() {
-  Serial.println("saving config");
-  DynamicJsonBuffer jsonBuffer;
-  JsonObject& json = jsonBuffer.createObject();
-  json["mqtt_server"] = mqtt_server;
-  json["mqtt_port"] = mqtt_port;
-  json["mqtt_login"] = mqtt_login;
-  json["mqtt_password"] = mqtt_password;
+void readConfiguration() {
+  configStore.load(deviceConfig);
 
-  File configFile = SPIFFS.open("/config.json", "w");
-  if (!configFile) {
-    Serial.println("failed to open config file for writing");
-  } else {
-    Serial.println("Save data in config file");
-  }
+  LOG_DEBUG("Config", "server %s port %s login %s password %s", deviceConfig.mqttServer, deviceConfig.mqttPort,
+            deviceConfig.mqttLogin, deviceConfig.mqttPassword[0] ? "set" : "empty");
+}
 
-  json.prettyPrintTo(Serial);
-  json.printTo(configFile);
-  configFile.close();
+
+void writeConfiguration() {
+  LOG_INFO("Config", "saving");
+  configStore.save(deviceConfig);
   shouldSaveConfig = false;
 }
 
 
-void createCustomWiFiManager() {
+/*
+ * Connect to WiFi, or open the configuration portal if that fails.
+ * With forcePortal the portal is opened right away (the "reconfigure" command).
+ */
+void createCustomWiFiManager(bool forcePortal = false) {
   // The extra parameters to be configured
   WiFiManagerParameter custom_text("<p>MQTT Server</p>");
-  WiFiManagerParameter custom_mqtt_server("mqtt_server", "MQTT server", mqtt_server, 40);
-  WiFiManagerParameter custom_mqtt_port("mqtt_port", "MQTT port", mqtt_port, 5);
-  WiFiManagerParameter custom_mqtt_login("mqtt_login", "MQTT login", mqtt_login, 64);
-  WiFiManagerParameter custom_mqtt_password("mqtt_password", "MQTT password", mqtt_password, 64);
+  WiFiManagerParameter custom_mqtt_server("mqtt_server", "MQTT server", deviceConfig.mqttServer, CONFIG_MQTT_SERVER_LEN);
+  WiFiManagerParameter custom_mqtt_port("mqtt_port", "MQTT port", deviceConfig.mqttPort, CONFIG_MQTT_PORT_LEN);
+  WiFiManagerParameter custom_mqtt_login("mqtt_login", "MQTT login", deviceConfig.mqttLogin, CONFIG_MQTT_LOGIN_LEN);
+  WiFiManagerParameter custom_mqtt_password("mqtt_password", "MQTT password", deviceConfig.mqttPassword, CONFIG_MQTT_PASSWORD_LEN);
 
   //WiFiManager
   //Local intialization. Once its business is done, there is no need to keep it around
@@ -189,18 +228,20 @@ void createCustomWiFiManager() {
   //fetches ssid and pass and tries to connect
   //if it does not connect it starts an access point with the specified name
   //and goes into a blocking loop awaiting configuration
-  if (!wifiManager.autoConnect(WIFI_AP_NAME, WIFI_AP_PASS)) {
-    Serial.println("Failed to connect and hit timeout");
+  bool connected = forcePortal ? wifiManager.startConfigPortal(WIFI_AP_NAME, WIFI_AP_PASS)
+                               : wifiManager.autoConnect(WIFI_AP_NAME, WIFI_AP_PASS);
+  if (!connected) {
+    LOG_WARN("WiFi", "failed to connect and hit timeout");
   }
 
   //if you get here you have connected to the WiFi
-  Serial.println("Connected to WiFi");
+  LOG_INFO("WiFi", "connected");
 
   //read updated parameters
-  strcpy(mqtt_server, custom_mqtt_server.getValue());
-  strcpy(mqtt_port, custom_mqtt_port.getValue());
-  strcpy(mqtt_login, custom_mqtt_login.getValue());
-  strcpy(mqtt_password, custom_mqtt_password.getValue());
+  copyConfigField(deviceConfig.mqttServer, custom_mqtt_server.getValue());
+  copyConfigField(deviceConfig.mqttPort, custom_mqtt_port.getValue());
+  copyConfigField(deviceConfig.mqttLogin, custom_mqtt_login.getValue());
+  copyConfigField(deviceConfig.mqttPassword, custom_mqtt_password.getValue());
 }
 
 
@@ -219,342 +260,983 @@ char *uptime(unsigned long milli)
 }
 
 // MQTT ---------------------------------------------
-/* Send an input code as an mqtt message */
-void sendCode() {
+/* Green or red for a moment, the answer of the alarm comes later */
+void showCodeFeedback(bool valid) {
+  LOG_INFO("Code", "%s by the local cache", valid ? "accepted" : "rejected");
+  animator.play(LedCompositor::LAYER_FEEDBACK, valid ? &ANIM_ACCEPT : &ANIM_REJECT, CODE_FEEDBACK_MS);
+}
+
+/* The waiting animation tells what is missing: amber without WiFi, blue without the broker */
+void showConnectionState() {
+  animator.play(LedCompositor::LAYER_WAITING, connection.isWiFiUp() ? &ANIM_WAITING : &ANIM_OFFLINE);
+}
+
+#if CODE_TRACE
+/* Publish the code with its trace ID and key entry time, start the trace */
+bool publishTracedCode(const char *code, unsigned long entryTime) {
+  char *buffer = outbox.acquire(identity.codeTopic(), 1, false);
+  if (buffer == NULL) {
+    return false;
+  }
+  JsonWriter json(buffer, PUBLISH_PAYLOAD_SIZE);
+  json.add("code", code);
+  json.add("id", (unsigned int)codeTracer.nextId());
+  json.add("keys_ms", entryTime);
+  json.add("t", millis());
+  size_t length = json.end();
+  if (length == 0) {
+    outbox.cancel();
+    return false;
+  }
+  outbox.submit(length);
+  codeTracer.begin(entryTime, outbox.lastSubmitted(), millis());
+  return true;
+}
+
+/* The latency histograms, sent along with the state */
+void publishLatency() {
+  char *buffer = outbox.acquire(identity.latencyTopic(), 0, false);
+  if (buffer == NULL) {
+    LOG_WARN("MQTT", "no buffer to publish the latencies");
+    return;
+  }
+
+  JsonWriter json(buffer, PUBLISH_PAYLOAD_SIZE);
+  codeTracer.write(json, millis());
+
+  size_t length = json.end();
+  if (length == 0) {
+    outbox.cancel();
+    LOG_ERROR("MQTT", "the latency document is too long");
+    return;
+  }
+  outbox.submit(length);
+}
+#endif
+
+/* Send an input code as an mqtt message, pressTime is the time of the '#' */
+void sendCode(unsigned long pressTime) {
   if (!queueInputCode.isEmpty ()) {
     char buffer[DIGITS + 1];
-    byte index = 0;
-    while ( !queueInputCode.isEmpty() ) {
-      buffer[index++] = queueInputCode.dequeue();
+    size_t length = queueInputCode.copyTo(buffer, DIGITS);
+    buffer[length] = 0;
+    queueInputCode.clear();
+    LOG_DEBUG("Code", "send %s", buffer);
+    if (codeCache.isLoaded()) {
+      unsigned long start = micros();
+      bool valid = codeCache.verify(buffer, length);
+      codeCheckTime = micros() - start;
+      showCodeFeedback(valid);
+    } else if (waActive) {
+      animator.play(LedCompositor::LAYER_FEEDBACK, &ANIM_QUEUED, CODE_FEEDBACK_MS);
+    }
+    if (waActive) {
+      LOG_INFO("Code", "held until the broker is back");
+      connection.codeBuffered();
+    }
+#if CODE_TRACE
+    bool queued = publishTracedCode(buffer, pressTime - codeStartTime);
+#else
+    bool queued = outbox.publish(identity.codeTopic(), 1, false, buffer, length);
+#endif
+    if (!queued) {
+      LOG_ERROR("MQTT", "the code is dropped, the publish queue is full");
     }
-    buffer[index] = 0;
-    Serial.printf("Send code: %s\n", buffer);
-    mqttClient.publish(MQTT_TOPIC_CODE, 1, false, buffer);
+#if EVENT_TRACE
+    if (queued) {
+      eventTrace.code(millis(), buffer, length);
+    }
+#endif
   } else {
-    Serial.println("The code is empty. Nothing to send.");
+    LOG_INFO("Code", "empty, nothing to send");
+  }
+}
+
+#if METRICS_ENABLED
+/* Publish the performance counters, sent along with the state. */
+void publishMetrics() {
+  char *buffer = outbox.acquire(identity.metricsTopic(), 0, false);
+  if (buffer == NULL) {
+    LOG_WARN("MQTT", "no buffer to publish the metrics");
+    return;
+  }
+
+  JsonWriter json(buffer, PUBLISH_PAYLOAD_SIZE);
+  metrics.write(json);
+
+  json.add("published", outbox.sentCount());
+  json.add("publish_dropped", outbox.droppedCount());
+  json.add("publish_queue", outbox.depth());
+  json.add("ack_ms", outbox.lastAckTime());
+  json.add("ack_max_ms", outbox.maxAckTime());
+  json.add("mqtt_attempts", mqttReconnect.attempts());
+  json.add("mqtt_reconnects", mqttReconnect.reconnects());
+  json.add("connect_ms", mqttReconnect.lastConnectTime());
+#if MQTT_TLS
+  json.add("tls_deferred", tlsDeferred);
+#endif
+  json.add("led_updates", leds.updates());
+  json.add("led_frames", leds.framesShown());
+  json.add("led_show_us", leds.maxShowTime());
+  json.add("key_scans", keypad.scanCount());
+  json.add("key_dropped", keypad.droppedEvents());
+  json.add("asleep_pct", (unsigned int)idle.asleepPercent(millis()));
+  json.add("wakeups", idle.wakeups());
+  json.add("wake_latency_ms", idle.lastWakeLatency());
+  json.add("wake_latency_max_ms", idle.maxWakeLatency());
+
+  size_t length = json.end();
+  if (length == 0) {
+    outbox.cancel();
+    LOG_ERROR("MQTT", "the metrics document is too long");
+    return;
   }
+  outbox.submit(length);
+}
+#endif
+
+/* The fields of the state that the delta mode follows */
+StateSnapshot currentState() {
+  StateSnapshot snapshot;
+  snapshot.rssi = WiFi.RSSI();
+  snapshot.ip = (uint32_t)WiFi.localIP();
+  snapshot.mqttAttempts = mqttReconnect.attempts();
+  snapshot.mqttReconnects = mqttReconnect.reconnects();
+  snapshot.publishDropped = outbox.droppedCount();
+  return snapshot;
 }
 
-/* Publish the current state odf the device. It will be called perioudically. */
+/* The MQTT log sink, only while the broker is there and the outbox has room for the rest */
+void publishLogLine(const char *line, size_t length) {
+  if (mqttClient.connected() && outbox.depth() < PUBLISH_QUEUE_SIZE / 2) {
+    outbox.publish(identity.logTopic(), 0, false, line, length);
+  }
+}
+
+/* Publish the current state odf the device. */
 void publishState() {
-  const int BUFFER_SIZE = JSON_OBJECT_SIZE(20);
-  StaticJsonBuffer<BUFFER_SIZE> jsonBuffer;
+  unsigned long start = micros();
 
-  JsonObject& root = jsonBuffer.createObject();
+  // Format the document right into the publish buffer
+  char *buffer = outbox.acquire(identity.stateTopic(), 0, true);
+  if (buffer == NULL) {
+    LOG_WARN("MQTT", "no buffer to publish the state");
+    return;
+  }
 
-  char ip[16];
-  memset(ip, 0, 18);
-  sprintf(ip, "%s", WiFi.localIP().toString().c_str());
-  root["ip"] = ip;
+  JsonWriter json(buffer, PUBLISH_PAYLOAD_SIZE);
 
-  uint8_t macAddr[6];
-  WiFi.macAddress(macAddr);
-  char mac[18];
-  memset(mac, 0, 18);
-  sprintf(mac, "%02X:%02X:%02X:%02X:%02X:%02X", macAddr[0], macAddr[1], macAddr[2], macAddr[3], macAddr[4], macAddr[5]);
-  root["mac"] = mac;
+  // ip, mac and version
+  stateSerializer.writeFixed(json, (uint32_t)WiFi.localIP());
+
+  StateSnapshot snapshot = currentState();
 
   char rssi[8];
-  sprintf(rssi, "%d", WiFi.RSSI());
-  root["rssi"] = rssi;
+  sprintf(rssi, "%d", (int)snapshot.rssi);
+  json.add("rssi", rssi);
+
+  json.add("uptime", uptime( millis() ));
+
+  // Connection statistics
+  json.add("mqtt_attempts", snapshot.mqttAttempts);
+  json.add("mqtt_reconnects", snapshot.mqttReconnects);
+  json.add("mqtt_reconnect_ms", mqttReconnect.lastReconnectTime());
+  json.add("publish_queue", outbox.depth());
+  json.add("publish_dropped", snapshot.publishDropped);
+  json.add("ack_ms", outbox.lastAckTime());
+  // Offline periods, left out of the boot document for room
+  if (connection.hasHistory() && !bootTimeline.isPending()) {
+    connection.write(json);
+  }
+
+  // What loading the configuration cost at boot
+  json.add("config", ConfigStore::sourceName(configStore.source()));
+  json.add("config_us", configStore.loadTime());
+  json.add("config_heap", configStore.loadHeap());
 
-  root["uptime"] = uptime( millis() );
+  // Local code cache
+  json.add("codes_cached", (unsigned int)codeCache.size());
+  json.add("code_check_us", codeCheckTime);
+#if CODE_TRACE
+  json.add("code_rtt_ms", codeTracer.lastStateLatency());
+#endif
+
+  // Boot phases, in the first document only
+  if (bootTimeline.isPending()) {
+    bootTimeline.write(json);
+  }
+
+  size_t length = json.end();
+  if (length == 0) {
+    outbox.cancel();
+    LOG_ERROR("MQTT", "the state document is too long");
+    return;
+  }
+  outbox.submit(length);
+  stateDelta.published(snapshot);
+  lastFullState = millis();
+
+  LOG_INFO("MQTT", "publish state (%u bytes, %lu us)", (unsigned int)length, micros() - start);
+  LOG_DEBUG("MQTT", "state %s", buffer);
+
+#if METRICS_ENABLED
+  publishMetrics();
+#endif
+#if CODE_TRACE
+  publishLatency();
+#endif
+}
+
+
+#if STATE_DELTA_MODE
+/* Publish only what changed since the last state, nothing if nothing did. */
+void publishStateDelta() {
+  char *buffer = outbox.acquire(identity.deltaTopic(), 0, false);
+  if (buffer == NULL) {
+    LOG_WARN("MQTT", "no buffer to publish the state delta");
+    return;
+  }
+
+  JsonWriter json(buffer, PUBLISH_PAYLOAD_SIZE);
+  json.add("uptime", uptime( millis() ));
+  uint8_t changed = stateDelta.write(json, currentState());
+
+  size_t length = json.end();
+  if (changed == 0 || length == 0) {
+    outbox.cancel();
+    return;
+  }
+  outbox.submit(length);
+  LOG_INFO("MQTT", "publish state delta: %s", buffer);
+}
+#endif
 
-  // Firmware version
-  root["version"] = FIRMWARE_VERSION;
+/* The periodic state: in delta mode the full document is only a heartbeat */
+void publishStateTick() {
+#if STATE_DELTA_MODE
+  if (stateDelta.hasBaseline() && millis() - lastFullState < STATE_HEARTBEAT_INTERVAL) {
+    publishStateDelta();
+    return;
+  }
+#endif
+  publishState();
+}
 
-  char buffer[root.measureLength() + 1];
-  root.printTo(buffer, sizeof(buffer));
 
-  Serial.printf("\nMQTT: Publish state: %s\n", buffer);
+#if DIAG_HTTP
+// Values of the local diagnostics endpoint
+enum DiagnosticId {
+  DIAG_VERSION, DIAG_IP, DIAG_MAC, DIAG_MODE, DIAG_CONFIG,
+  DIAG_MQTT_PORT, DIAG_MQTT_PASSWORD,
+  DIAG_UPTIME, DIAG_RSSI, DIAG_WIFI_CONNECTED, DIAG_MQTT_CONNECTED,
+  DIAG_FREE_HEAP, DIAG_MIN_FREE_HEAP, DIAG_MAX_FREE_BLOCK, DIAG_HEAP_FRAGMENTATION,
+  DIAG_PUBLISH_QUEUE, DIAG_PUBLISH_IN_FLIGHT, DIAG_PUBLISHED, DIAG_PUBLISH_DROPPED, DIAG_ACK_MS,
+  DIAG_LOG_QUEUE, DIAG_LOG_DROPPED,
+  DIAG_MQTT_ATTEMPTS, DIAG_MQTT_RECONNECTS, DIAG_MQTT_RECONNECT_MS, DIAG_CONNECT_MS, DIAG_CONNECT_HEAP,
+  DIAG_TLS_DEFERRED,
+  DIAG_WIFI_OUTAGES, DIAG_WIFI_OUTAGE_MS, DIAG_WIFI_OUTAGE_MAX_MS, DIAG_WIFI_RECOVERY_MS,
+  DIAG_OFFLINE_CODES, DIAG_CODES_EXPIRED,
+  DIAG_CODES_CACHED, DIAG_CODE_CHECK_US, DIAG_KEY_SCANS, DIAG_KEY_DROPPED,
+  DIAG_LED_FRAMES, DIAG_LED_SHOW_MAX_US, DIAG_IDLE, DIAG_WAKEUPS,
+  DIAG_HTTP_REQUESTS, DIAG_HTTP_SERVE_US, DIAG_HTTP_SERVE_MAX_US
+};
+
+static const DiagnosticField diagnosticFields[] PROGMEM = {
+  { "version",            "",                                        DIAG_TEXT,    DIAG_VERSION },
+  { "ip",                 "",                                        DIAG_TEXT,    DIAG_IP },
+  { "mac",                "",                                        DIAG_TEXT,    DIAG_MAC },
+  { "mode",               "",                                        DIAG_TEXT,    DIAG_MODE },
+  { "config",             "",                                        DIAG_TEXT,    DIAG_CONFIG },
+  { "mqtt_port",          "",                                        DIAG_TEXT,    DIAG_MQTT_PORT },
+  { "mqtt_password",      "",                                        DIAG_TEXT,    DIAG_MQTT_PASSWORD },
+  { "uptime_seconds",     "Time since boot",                         DIAG_GAUGE,   DIAG_UPTIME },
+  { "rssi_dbm",           "WiFi signal strength",                    DIAG_SIGNED,  DIAG_RSSI },
+  { "wifi_connected",     "1 while the WiFi link is up",             DIAG_GAUGE,   DIAG_WIFI_CONNECTED },
+  { "mqtt_connected",     "1 while connected to the broker",         DIAG_GAUGE,   DIAG_MQTT_CONNECTED },
+  { "free_heap_bytes",    "Free heap",                               DIAG_GAUGE,   DIAG_FREE_HEAP },
+#if METRICS_ENABLED
+  { "min_free_heap_bytes", "Lowest free heap seen since boot",       DIAG_GAUGE,   DIAG_MIN_FREE_HEAP },
+#endif
+  { "max_free_block_bytes", "Largest free heap block",               DIAG_GAUGE,   DIAG_MAX_FREE_BLOCK },
+  { "heap_fragmentation", "Heap fragmentation, percent",             DIAG_GAUGE,   DIAG_HEAP_FRAGMENTATION },
+  { "publish_queue",      "Messages queued or in flight",            DIAG_GAUGE,   DIAG_PUBLISH_QUEUE },
+  { "publish_in_flight",  "Messages waiting for their ack",          DIAG_GAUGE,   DIAG_PUBLISH_IN_FLIGHT },
+  { "published",          "Messages sent to the broker",             DIAG_COUNTER, DIAG_PUBLISHED },
+  { "publish_dropped",    "Messages dropped by the full queue",      DIAG_COUNTER, DIAG_PUBLISH_DROPPED },
+  { "ack_ms",             "Publish to ack of the last message",      DIAG_GAUGE,   DIAG_ACK_MS },
+  { "log_queue",          "Log lines waiting for the serial port",   DIAG_GAUGE,   DIAG_LOG_QUEUE },
+  { "log_dropped",        "Log lines dropped by the full queue",     DIAG_COUNTER, DIAG_LOG_DROPPED },
+  { "mqtt_attempts",      "Attempts to connect to the broker",       DIAG_COUNTER, DIAG_MQTT_ATTEMPTS },
+  { "mqtt_reconnects",    "Connections after the first one",         DIAG_COUNTER, DIAG_MQTT_RECONNECTS },
+  { "mqtt_reconnect_ms",  "Time offline before the last connection", DIAG_GAUGE,   DIAG_MQTT_RECONNECT_MS },
+  { "connect_ms",         "Duration of the last connection attempt", DIAG_GAUGE,   DIAG_CONNECT_MS },
+#if METRICS_ENABLED
+  { "connect_heap_bytes", "Heap taken by the last connection",       DIAG_GAUGE,   DIAG_CONNECT_HEAP },
+#endif
+#if MQTT_TLS
+  { "tls_deferred",       "Attempts put off for lack of heap",       DIAG_COUNTER, DIAG_TLS_DEFERRED },
+#endif
+  { "wifi_outages",       "WiFi link losses",                        DIAG_COUNTER, DIAG_WIFI_OUTAGES },
+  { "wifi_outage_ms",     "Duration of the last WiFi outage",        DIAG_GAUGE,   DIAG_WIFI_OUTAGE_MS },
+  { "wifi_outage_max_ms", "Longest WiFi outage",                     DIAG_GAUGE,   DIAG_WIFI_OUTAGE_MAX_MS },
+  { "wifi_recovery_ms",   "WiFi link up to broker connected",        DIAG_GAUGE,   DIAG_WIFI_RECOVERY_MS },
+  { "offline_codes",      "Codes entered while offline",             DIAG_COUNTER, DIAG_OFFLINE_CODES },
+  { "codes_expired",      "Offline codes dropped as too old",        DIAG_COUNTER, DIAG_CODES_EXPIRED },
+  { "codes_cached",       "Codes in the local cache",                DIAG_GAUGE,   DIAG_CODES_CACHED },
+  { "code_check_us",      "Duration of the last local code check",   DIAG_GAUGE,   DIAG_CODE_CHECK_US },
+  { "key_scans",          "Keypad matrix scans",                     DIAG_COUNTER, DIAG_KEY_SCANS },
+  { "key_dropped",        "Key events lost by the full queue",       DIAG_COUNTER, DIAG_KEY_DROPPED },
+  { "led_frames",         "Frames pushed to the LED strip",          DIAG_COUNTER, DIAG_LED_FRAMES },
+  { "led_show_max_us",    "Longest LED strip show()",                DIAG_GAUGE,   DIAG_LED_SHOW_MAX_US },
+  { "idle",               "1 while the keypad sleeps",               DIAG_GAUGE,   DIAG_IDLE },
+  { "wakeups",            "Wakeups from the idle mode by a key",     DIAG_COUNTER, DIAG_WAKEUPS },
+  { "http_requests",      "Requests served by this endpoint",        DIAG_COUNTER, DIAG_HTTP_REQUESTS },
+  { "http_serve_us",      "Duration of the last request",            DIAG_GAUGE,   DIAG_HTTP_SERVE_US },
+  { "http_serve_max_us",  "Longest request",                         DIAG_GAUGE,   DIAG_HTTP_SERVE_MAX_US },
+};
+
+uint32_t readDiagnostic(uint8_t id);
+const char *readDiagnosticText(uint8_t id, char *buffer, size_t size);
+
+DiagnosticsServer diagnostics(DIAG_HTTP_PORT, diagnosticFields, sizeof(diagnosticFields) / sizeof(diagnosticFields[0]),
+                              readDiagnostic, readDiagnosticText);
+
+uint32_t readDiagnostic(uint8_t id) {
+  switch (id) {
+    case DIAG_UPTIME:             return millis() / 1000;
+    case DIAG_RSSI:               return (int32_t)WiFi.RSSI();
+    case DIAG_WIFI_CONNECTED:     return WiFi.isConnected();
+    case DIAG_MQTT_CONNECTED:     return mqttReconnect.isConnected();
+    case DIAG_FREE_HEAP:          return ESP.getFreeHeap();
+    case DIAG_MIN_FREE_HEAP: {
+      // sampled every 256 loops only
+      uint32_t freeHeap = ESP.getFreeHeap();
+      return freeHeap < metrics.minHeap() ? freeHeap : metrics.minHeap();
+    }
+    case DIAG_MAX_FREE_BLOCK:     return ESP.getMaxFreeBlockSize();
+    case DIAG_HEAP_FRAGMENTATION: return ESP.getHeapFragmentation();
+    case DIAG_PUBLISH_QUEUE:      return outbox.depth();
+    case DIAG_PUBLISH_IN_FLIGHT:  return outbox.inFlight();
+    case DIAG_PUBLISHED:          return outbox.sentCount();
+    case DIAG_PUBLISH_DROPPED:    return outbox.droppedCount();
+    case DIAG_ACK_MS:             return outbox.lastAckTime();
+    case DIAG_LOG_QUEUE:          return logger.queuedLines();
+    case DIAG_LOG_DROPPED:        return logger.droppedLines();
+    case DIAG_MQTT_ATTEMPTS:      return mqttReconnect.attempts();
+    case DIAG_MQTT_RECONNECTS:    return mqttReconnect.reconnects();
+    case DIAG_MQTT_RECONNECT_MS:  return mqttReconnect.lastReconnectTime();
+    case DIAG_CONNECT_MS:         return mqttReconnect.lastConnectTime();
+    case DIAG_CONNECT_HEAP:       return metrics.connectHeap();
+#if MQTT_TLS
+    case DIAG_TLS_DEFERRED:       return tlsDeferred;
+#endif
+    case DIAG_WIFI_OUTAGES:       return connection.outages();
+    case DIAG_WIFI_OUTAGE_MS:     return connection.lastOutage();
+    case DIAG_WIFI_OUTAGE_MAX_MS: return connection.maxOutage();
+    case DIAG_WIFI_RECOVERY_MS:   return connection.lastRecovery();
+    case DIAG_OFFLINE_CODES:      return connection.bufferedCodes();
+    case DIAG_CODES_EXPIRED:      return connection.expiredCodes();
+    case DIAG_CODES_CACHED:       return codeCache.size();
+    case DIAG_CODE_CHECK_US:      return codeCheckTime;
+    case DIAG_KEY_SCANS:          return keypad.scanCount();
+    case DIAG_KEY_DROPPED:        return keypad.droppedEvents();
+    case DIAG_LED_FRAMES:         return leds.framesShown();
+    case DIAG_LED_SHOW_MAX_US:    return leds.maxShowTime();
+    case DIAG_IDLE:               return idle.isIdle();
+    case DIAG_WAKEUPS:            return idle.wakeups();
+    case DIAG_HTTP_REQUESTS:      return diagnostics.requests();
+    case DIAG_HTTP_SERVE_US:      return diagnostics.lastServeTime();
+    case DIAG_HTTP_SERVE_MAX_US:  return diagnostics.maxServeTime();
+    default:                      return 0;
+  }
+}
 
-  mqttClient.publish(MQTT_TOPIC_STATE, 0, true, buffer);
+/* The configuration without the broker address and credentials, it only tells whether a password is set */
+const char *readDiagnosticText(uint8_t id, char *buffer, size_t size) {
+  switch (id) {
+    case DIAG_VERSION:       return FIRMWARE_VERSION;
+    case DIAG_IP: {
+      uint32_t ip = WiFi.localIP();
+      snprintf(buffer, size, "%u.%u.%u.%u", (unsigned int)(ip & 0xFF), (unsigned int)((ip >> 8) & 0xFF),
+               (unsigned int)((ip >> 16) & 0xFF), (unsigned int)(ip >> 24));
+      return buffer;
+    }
+    case DIAG_MAC: {
+      uint8_t mac[6];
+      WiFi.macAddress(mac);
+      snprintf(buffer, size, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+      return buffer;
+    }
+    case DIAG_MODE:          return errActive ? "locked" : waActive ? "offline" : idle.isIdle() ? "idle" : "online";
+    case DIAG_CONFIG:        return ConfigStore::sourceName(configStore.source());
+    case DIAG_MQTT_PORT:     return deviceConfig.mqttPort;
+    case DIAG_MQTT_PASSWORD: return deviceConfig.mqttPassword[0] ? "set" : "empty";
+    default:                 return "";
+  }
 }
+#endif
 
 
+/* A TLS handshake fails halfway without a large contiguous block, wait for the next attempt instead.
+   Nothing is sent to a broker whose certificate is not pinned. */
+bool connectAllowed() {
+#if MQTT_TLS
+  if (!brokerPinned) {
+    return false;
+  }
+  uint32_t block = ESP.getMaxFreeBlockSize();
+  if (block < MQTT_TLS_MIN_BLOCK) {
+    tlsDeferred++;
+    LOG_WARN("MQTT", "largest free block %u bytes, too small for a TLS handshake", block);
+    return false;
+  }
+#endif
+  return true;
+}
+
 void onMqttConnect(bool sessionPresent) {
-  Serial.println("MQTT: Connected");
-  Serial.printf("MQTT: Session present: %d\n", sessionPresent);
+  mqttReconnect.connected(millis());
+  metrics.connectEnd();
+#if EVENT_TRACE
+  eventTrace.connected(millis());
+#endif
+  bootTimeline.mark(BootTimeline::PHASE_MQTT, millis());
+
+  LOG_INFO("MQTT", "connected after %u attempt(s), %u ms, session present: %d",
+           mqttReconnect.lastAttempts(), mqttReconnect.lastReconnectTime(), sessionPresent);
 
-  Serial.print("MQTT: Subscribing at QoS 0, topic: ");
-  Serial.println(MQTT_TOPIC_COMMAND);
-  mqttClient.subscribe(MQTT_TOPIC_COMMAND, 0);
+  LOG_DEBUG("MQTT", "subscribing to %s", identity.commandTopic());
+  mqttClient.subscribe(identity.commandTopic(), 0);
+  // The broker sends the retained list of codes right away
+  if (codeCache.hasKey()) {
+    mqttClient.subscribe(identity.codesTopic(), 1);
+  }
+#if CODE_TRACE
+  // The reaction of the alarm to the traced codes
+  mqttClient.subscribe(ALARM_STATE_TOPIC, 0);
+#endif
 
-  Serial.print("MQTT: Publish online status: ");
-  Serial.println(MQTT_TOPIC_STATUS);
-  mqttClient.publish(MQTT_TOPIC_STATUS, 1, true, MQTT_STATUS_PAYLOAD_ON);
+  LOG_DEBUG("MQTT", "publish online status to %s", identity.statusTopic());
+  mqttClient.publish(identity.statusTopic(), 1, true, MQTT_STATUS_PAYLOAD_ON);
 
   waActive = false;
-  publishState();
+  animator.stop(LedCompositor::LAYER_WAITING);
+  // Spread the fleet after a broker restart
+  scheduler.after(identity.phase(STATE_CONNECT_SPREAD), publishState);
 }
 
 void onMqttDisconnect(AsyncMqttClientDisconnectReason reason) {
+#if EVENT_TRACE
+  eventTrace.disconnected(millis(), (uint8_t)reason);
+#endif
   waActive = true;
+  showConnectionState();
+  // loop() schedules the next attempt
+  mqttReconnect.disconnected(millis());
+  // Unacknowledged messages are sent again after the reconnect
+  outbox.connectionLost();
 
-  Serial.println();
-  Serial.print("MQTT: Disconnected: ");
   if (reason == AsyncMqttClientDisconnectReason::TCP_DISCONNECTED) {
-    Serial.println("TCP disconnected");
+    LOG_WARN("MQTT", "disconnected: TCP disconnected");
   } else if (reason == AsyncMqttClientDisconnectReason::MQTT_UNACCEPTABLE_PROTOCOL_VERSION) {
-    Serial.println("Unacceptable protocol version");
+    LOG_ERROR("MQTT", "disconnected: unacceptable protocol version");
   } else if (reason == AsyncMqttClientDisconnectReason::MQTT_IDENTIFIER_REJECTED) {
-    Serial.println("Indentifier rejected");
+    LOG_ERROR("MQTT", "disconnected: identifier rejected");
   } else if (reason == AsyncMqttClientDisconnectReason::MQTT_SERVER_UNAVAILABLE) {
-    Serial.println("Server unavailable");
+    LOG_WARN("MQTT", "disconnected: server unavailable");
   } else if (reason == AsyncMqttClientDisconnectReason::MQTT_MALFORMED_CREDENTIALS) {
-    Serial.println("Malformed credentials");
+    LOG_ERROR("MQTT", "disconnected: malformed credentials");
   } else if (reason == AsyncMqttClientDisconnectReason::MQTT_NOT_AUTHORIZED) {
-    Serial.println("Not authorized");
+    LOG_ERROR("MQTT", "disconnected: not authorized");
+  } else if (reason == AsyncMqttClientDisconnectReason::TLS_BAD_FINGERPRINT) {
+    LOG_ERROR("MQTT", "disconnected: the broker certificate does not match the fingerprint");
+  } else if (reason == AsyncMqttClientDisconnectReason::ESP8266_NOT_ENOUGH_SPACE) {
+    LOG_ERROR("MQTT", "disconnected: not enough memory");
   } else {
-    Serial.println("Unknown reason");
+    LOG_WARN("MQTT", "disconnected: unknown reason");
   }
+}
+
 
-  delay(3000);
-  Serial.println("MQTT: Reconnecting to broker...");
-  if (WiFi.isConnected()) {
-    mqttClient.connect();
+void onMqttPublish(uint16_t packetId) {
+#if CODE_TRACE
+  if (outbox.acknowledged(packetId, millis())) {
+    codeTracer.acknowledged(outbox.lastAcked(), millis());
   }
+#else
+  outbox.acknowledged(packetId, millis());
+#endif
 }
 
 
-void onMqttMessage(char* topic, char* payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total) {
-  Serial.println();
-  Serial.println("MQTT: Message received.");
-  Serial.print("  topic: ");
-  Serial.println(topic);
-  Serial.print("  qos: ");
-  Serial.println(properties.qos);
-  Serial.print("  dup: ");
-  Serial.println(properties.dup);
-  Serial.print("  retain: ");
-  Serial.println(properties.retain);
-  Serial.print("  len: ");
-  Serial.println(len);
-  Serial.print("  index: ");
-  Serial.println(index);
-  Serial.print("  total: ");
-  Serial.println(total);
-
-  Serial.print("  payload: ");
-  DynamicJsonBuffer jsonBuffer;
-  JsonObject& json = jsonBuffer.parseObject(payload);
-  json.printTo(Serial);
-  Serial.println();
+// Commands ---------------------------------------------
+/* The end of a lock, scheduled by the lock command */
+void unlockKeypad() {
+  LOG_INFO("Cmd", "unlock keypad");
+  errActive = false;
+  animator.stop(LedCompositor::LAYER_ERROR);
+}
 
-  if (json.success()) {
-    if (json.containsKey("command")) {
-      const char* command = json["command"];
-      String stringCommand(command);
-      if (stringCommand == String("lock")) {
-        byte duration = 60;
-        if (json.containsKey("duration")) {
-          duration = (byte)atoi(json["duration"]);
-        }
-        Serial.printf("Lock keypad for %d seconds\n", duration);
-        lock_endtime = millis() + duration * 1000;
-        errActive = true;
-      } else {
-        Serial.printf("Unknown command: %s\n", command);
-      }
-    } else {
-      Serial.printf("Payload doesn't contain any command\n");
-    }
+/* {"command":"lock","duration":20} locks the keypad for duration seconds (default 60) */
+void commandLock(JsonObject &args) {
+  byte duration = commandArgument<byte>(args, "duration", 60);
+  LOG_INFO("Cmd", "lock keypad for %d seconds", duration);
+  errActive = true;
+  animator.play(LedCompositor::LAYER_ERROR, &ANIM_LOCK, duration * 1000UL);
+  scheduler.after(duration * 1000UL, unlockKeypad);
+}
+
+/* {"command":"unlock"} ends a lock before its time */
+void commandUnlock(JsonObject &args) {
+  scheduler.cancel(unlockKeypad);
+  unlockKeypad();
+}
+
+/* {"command":"brightness","value":64} sets the LED brightness, 0..255 */
+void commandBrightness(JsonObject &args) {
+  byte value = commandArgument<byte>(args, "value", 255);
+  LOG_INFO("Cmd", "set LED brightness to %d", value);
+  leds.setBrightness(value);
+}
+
+/* {"command":"state"} publishes the state right away */
+void commandState(JsonObject &args) {
+  publishState();
+}
+
+/* {"command":"log","serial":4,"mqtt":2} sets the log levels, 0 turns the MQTT log off */
+void commandLog(JsonObject &args) {
+  logger.setLevel(commandArgument<byte>(args, "serial", logger.getLevel()));
+  logger.setSink(publishLogLine, commandArgument<byte>(args, "mqtt", logger.getSinkLevel()));
+  LOG_INFO("Cmd", "log levels: serial %u, mqtt %u", logger.getLevel(), logger.getSinkLevel());
+}
+
+#if EVENT_TRACE
+/* A new frame went to the strip */
+void traceLedFrame() {
+  if (leds.framesShown() == tracedFrames) {
+    return;
+  }
+  tracedFrames = leds.framesShown();
+  uint32_t colors[DIGITS];
+  for (uint8_t i = 0; i < DIGITS; i++) {
+    colors[i] = leds.outputColor(i);
+  }
+  eventTrace.leds(millis(), EventTrace::frameChecksum(colors, DIGITS));
+}
+
+/* Record from now on, starting with the frame on the strip and a new seed for the reconnect jitter */
+void startEventTrace() {
+  uint32_t seed = ESP.getChipId() ^ micros();
+  randomSeed(seed);
+  eventTrace.start(millis(), seed);
+  tracedFrames = leds.framesShown() - 1;
+  traceLedFrame();
+}
+
+/* Publish the next chunk of the event trace, only while the outbox has room for the rest */
+void publishTraceChunk() {
+  if (!mqttClient.connected() || outbox.depth() >= PUBLISH_QUEUE_SIZE / 2) {
+    return;
+  }
+  size_t chunk = traceDumpSize - traceDumpOffset;
+  if (chunk > PUBLISH_PAYLOAD_SIZE) {
+    chunk = PUBLISH_PAYLOAD_SIZE;
+  }
+  if (chunk == 0) {
+    // The empty message ends the dump
+    outbox.publish(identity.traceTopic(), 1, false, "", 0);
+    scheduler.cancel(publishTraceChunk);
+    LOG_INFO("Trace", "dumped %u bytes", (unsigned int)traceDumpSize);
+    return;
+  }
+  outbox.publish(identity.traceTopic(), 1, false, (const char *)eventTrace.data() + traceDumpOffset, chunk);
+  traceDumpOffset += chunk;
+}
+
+/* {"command":"trace","action":"dump"} publishes the event trace, "start" restarts it, "stop" ends it */
+void commandTrace(JsonObject &args) {
+  const char *action = commandArgument<const char *>(args, "action", "dump");
+  if (strcmp(action, "start") == 0) {
+    scheduler.cancel(publishTraceChunk);
+    startEventTrace();
+    LOG_INFO("Trace", "recording, %u bytes", (unsigned int)EVENT_TRACE_SIZE);
+  } else if (strcmp(action, "stop") == 0) {
+    eventTrace.stop();
+    LOG_INFO("Trace", "stopped at %u bytes", (unsigned int)eventTrace.size());
   } else {
-    Serial.println("Wrong JSON document");
+    traceDumpOffset = 0;
+    traceDumpSize = eventTrace.size();
+    scheduler.every(EVENT_TRACE_DUMP_PERIOD, publishTraceChunk);
+    LOG_INFO("Trace", "dump %u bytes%s", (unsigned int)traceDumpSize, eventTrace.isFull() ? ", full" : "");
   }
 }
+#endif
 
+/* {"command":"reboot"} restarts the device */
+void commandReboot(JsonObject &args) {
+  LOG_INFO("Cmd", "reboot requested");
+  restartRequested = true;
+}
 
-// ----------------------------------------------
-/*
- * The function shows a wating animation as a running blue light
- * from right to left and back.
- */
-void waitingAnimation() {
-  if (waActive) {
-    unsigned int count = millis() / 100;
-    if (waCount != count) {
-      waCount = count;
-      if (waForward) {
-        waActiveLED += 1;
+/* {"command":"reconfigure"} opens the WiFi/MQTT configuration portal */
+void commandReconfigure(JsonObject &args) {
+  LOG_INFO("Cmd", "configuration portal requested");
+  reconfigureRequested = true;
+}
+
+// Sorted by name for the binary search in findCommand()
+constexpr Command commands[] = {
+  { "brightness",  commandBrightness },
+  { "lock",        commandLock },
+  { "log",         commandLog },
+  { "reboot",      commandReboot },
+  { "reconfigure", commandReconfigure },
+  { "state",       commandState },
+#if EVENT_TRACE
+  { "trace",       commandTrace },
+#endif
+  { "unlock",      commandUnlock },
+};
+static_assert(commandsSorted(commands), "The command table must be sorted by name");
+
+
+void onMqttMessage(char* topic, char* payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total) {
+  LOG_DEBUG("MQTT", "message on %s qos %u dup %d retain %d, %u bytes at %u of %u", topic, properties.qos,
+            properties.dup, properties.retain, (unsigned int)len, (unsigned int)index, (unsigned int)total);
+#if EVENT_TRACE
+  eventTrace.message(millis(), topic, payload, len, index, total);
+#endif
+
+#if CODE_TRACE
+  if (strcmp(topic, ALARM_STATE_TOPIC) == 0) {
+    // The retained state sent on subscribe is not a reaction
+    if (!properties.retain && index == 0) {
+      codeTracer.stateChanged(millis());
+    }
+    return;
+  }
+#endif
+
+  if (strcmp(topic, identity.codesTopic()) == 0) {
+    char *codes = codesAssembler.feed(payload, len, index, total);
+    if (codes != NULL) {
+      if (codeCache.load(codes)) {
+        LOG_INFO("Code", "%u cached, %u bytes each", (unsigned int)codeCache.size(), (unsigned int)CodeCache::BYTES_PER_CODE);
       } else {
-        waActiveLED -= 1;
-      }
-      if (waActiveLED == 0) {
-        waForward = true;
-      } else if (waActiveLED == (DIGITS-1)) {
-        waForward = false;
-      }
-      for (int c = 0; c < DIGITS; c++) {
-        byte clr = waActiveLED == c ? 255 : 0;
-        pixels.setPixelColor(c, pixels.Color(0,0,clr));
+        LOG_WARN("Code", "invalid list, the cache is cleared");
       }
+    } else if (index == 0 && total > CODE_CACHE_PAYLOAD_SIZE) {
+      LOG_WARN("Code", "list is too long: %u bytes", (unsigned int)total);
     }
+    return;
   }
-}
 
-/*
- * The function shows an error animation as a flashing red light.
- */
-void errorAnimation() {
-  if (errActive) {
-    unsigned int count = millis() / 250;
-    if (waCount != count) {
-      waCount = count;
-      if ( waCount %2 ) {
-        pixels.setPixelColor(0, pixels.Color(255,0,0));
-        pixels.setPixelColor(1, pixels.Color(255,0,0));
-        pixels.setPixelColor(2, pixels.Color(255,0,0));
-        pixels.setPixelColor(3, pixels.Color(255,0,0));
+  char *message = commandAssembler.feed(payload, len, index, total);
+  if (message == NULL) {
+    if (index == 0 && total > COMMAND_PAYLOAD_SIZE) {
+      LOG_WARN("Cmd", "payload is too long: %u bytes", (unsigned int)total);
+    }
+    return;
+  }
+
+  LOG_DEBUG("Cmd", "payload %s", message);
+
+  // The document is parsed in place, no heap is used
+  StaticJsonBuffer<COMMAND_JSON_SIZE> jsonBuffer;
+  JsonObject& json = jsonBuffer.parseObject(message);
+
+  if (json.success()) {
+    const char* command = json["command"];
+    if (command != NULL) {
+      const Command *entry = findCommand(commands, command);
+      if (entry != NULL) {
+        entry->handler(json);
       } else {
-        pixels.setPixelColor(0, pixels.Color(0,0,0));
-        pixels.setPixelColor(1, pixels.Color(0,0,0));
-        pixels.setPixelColor(2, pixels.Color(0,0,0));
-        pixels.setPixelColor(3, pixels.Color(0,0,0));
+        LOG_WARN("Cmd", "unknown command: %s", command);
       }
+    } else {
+      LOG_WARN("Cmd", "payload doesn't contain any command");
     }
+  } else {
+    LOG_WARN("Cmd", "wrong JSON document");
   }
 }
 
+
+void onWiFiAssociated(const WiFiEventStationModeConnected &event) {
+  bootTimeline.mark(BootTimeline::PHASE_WIFI, millis());
+}
+
+void onWiFiGotIP(const WiFiEventStationModeGotIP &event) {
+  bootTimeline.mark(BootTimeline::PHASE_IP, millis());
+}
+
 void setup() {
   #if defined (__AVR_ATtiny85__)
   if (F_CPU == 16000000) clock_prescale_set(clock_div_1);
 #endif
   //All initializations start. Turn on all LEDs to white
   pixels.begin();
-  pixels.setPixelColor(0, pixels.Color(255, 255, 255));
-  pixels.setPixelColor(1, pixels.Color(255, 255, 255));
-  pixels.setPixelColor(2, pixels.Color(255, 255, 255));
-  pixels.setPixelColor(3, pixels.Color(255, 255, 255));
-  pixels.show();
+  animator.play(LedCompositor::LAYER_BOOT, &ANIM_BOOT);
+  animator.update(millis());
+  leds.forceShow();
 
   Serial.begin(115200);
   Serial.println();
+  // Nothing drains the log before loop() runs
+  logger.setBlocking(true);
 
   //clean FS, for testing
   //SPIFFS.format();
 
   waActive = true; //will be off when connected to mqtt
+  animator.play(LedCompositor::LAYER_WAITING, &ANIM_WAITING);
+
 
+  LOG_INFO("Config", "read the configuration");
+  readConfiguration();
+  bootTimeline.mark(BootTimeline::PHASE_CONFIG, millis());
 
-  Serial.println("Read the configuration file.");
-  readConfigurationFile();
+  wifiAssociatedHandler = WiFi.onStationModeConnected(onWiFiAssociated);
+  wifiGotIpHandler = WiFi.onStationModeGotIP(onWiFiGotIP);
+  // The SDK rejoins the access point by itself after a drop
+  WiFi.setAutoReconnect(true);
 
-  Serial.println("Configure WiFi");
-  createCustomWiFiManager();
+  // Try the last access point first, the WiFiManager scans and may open the portal
+  LOG_INFO("WiFi", "configure");
+  wifiCache.load();
+  if (wifiCache.connect(WIFI_FAST_CONNECT_TIMEOUT)) {
+    LOG_INFO("WiFi", "connected (fast path)");
+    bootTimeline.setFastPath(true);
+  } else {
+    createCustomWiFiManager();
+  }
+  wifiCache.store();
 
   // Save the custom parameters to FS
   if (shouldSaveConfig) {
-    writeConfigurationFile();
+    writeConfiguration();
   }
 
-  Serial.println("Configure MQTT");
-  Serial.printf("MQTT: Server: %s port: %s\n", mqtt_server, mqtt_port);
+  if (!codeCache.setKey(CODE_CACHE_KEY)) {
+    LOG_INFO("Code", "no valid CODE_CACHE_KEY, the list of codes is not used");
+  }
+
+  LOG_INFO("MQTT", "configure");
+  identity.begin();
+  LOG_INFO("MQTT", "server %s port %s", deviceConfig.mqttServer, deviceConfig.mqttPort);
 
-  int p = atoi(mqtt_port);
-  mqttClient.setServer(mqtt_server, p);
-  mqttClient.setCredentials(mqtt_login, mqtt_password);
+  int p = atoi(deviceConfig.mqttPort);
+  mqttClient.setServer(deviceConfig.mqttServer, p);
+  mqttClient.setCredentials(deviceConfig.mqttLogin, deviceConfig.mqttPassword);
   mqttClient.setKeepAlive(30);
-  mqttClient.setWill(MQTT_TOPIC_STATUS, 1, true, MQTT_STATUS_PAYLOAD_OFF); //topic, QoS, retain, payload
+  mqttClient.setWill(identity.statusTopic(), 1, true, MQTT_STATUS_PAYLOAD_OFF); //topic, QoS, retain, payload
+#if MQTT_TLS
+  mqttClient.setSecure(true);
+  brokerPinned = parseTlsFingerprint(MQTT_TLS_FINGERPRINT, brokerFingerprint);
+  if (brokerPinned) {
+    mqttClient.addServerFingerprint(brokerFingerprint);
+  } else {
+    LOG_ERROR("MQTT", "no valid MQTT_TLS_FINGERPRINT, not connecting to the broker");
+  }
+#endif
 
-  Serial.println("MQTT: Set callbacks");
+  LOG_DEBUG("MQTT", "set callbacks");
   mqttClient.onConnect(onMqttConnect);
   mqttClient.onDisconnect(onMqttDisconnect);
   mqttClient.onMessage(onMqttMessage);
+  mqttClient.onPublish(onMqttPublish);
 
-  //Serial.println("MQTT: Connecting to broker...");
-  //mqttClient.connect();
-  /* Connect the MQTT client to the broker */
-  int8_t attemptToConnectToMQTT = 0;
-  Serial.println("MQTT: Connect to the broker");
-  while ( (mqttClient.connected() == false) && (attemptToConnectToMQTT < 5) ) {
-    if (WiFi.isConnected()) {
-      Serial.printf("MQTT: Attempt %d. Connecting to broker ... \n", attemptToConnectToMQTT );
-      mqttClient.connect();
-    } else {
-      //attemptToConnectToMQTT = 0;
-      Serial.println("MQTT: WiFi is not connected. Try to reconnect WiFi.");
-      WiFi.reconnect();
-    }
-    delay(3000);
-    attemptToConnectToMQTT += 1;
-  }
+  // loop() connects to the broker, seed the jitter of the reconnect delays
+  randomSeed(ESP.getChipId() ^ micros());
 
-  /* If there is still no connection here, restart the device */
-  if (!WiFi.isConnected()) {
-    Serial.println("setup(): WiFi is not connected. Reset the device to initiate connection again.");
-    ESP.restart();
-  }
+  // Animation, the waiting animation runs until the broker is connected
+  errActive = false;
 
-  if (!mqttClient.connected()) {
-    Serial.println("setup(): The device is not connected to MQTT. Reset the device to initiate connection again.");
-    ESP.restart();
-  }
+  keypad.begin();
 
-  // Animation
-  waActive = false;
-  errActive = false;
+  // All initializations are done. Hand the LEDs over to the code layer
+  animator.stop(LedCompositor::LAYER_BOOT);
+  animator.update(millis());
+  leds.update();
+
+#if DIAG_HTTP
+  // Served from loop(), after the WiFiManager is done with port 80
+  diagnostics.begin();
+  LOG_INFO("HTTP", "diagnostics on port %u: /status, /metrics", (unsigned int)DIAG_HTTP_PORT);
+#endif
 
-  queueInputCode.setPrinter(Serial);
+  // Each device publishes at its own phase of the interval
+  scheduler.every(INTERVAL_PUBLISH_STATE, publishStateTick, identity.phase(INTERVAL_PUBLISH_STATE));
 
-  // All initializations are done. Turn off all LEDs
-  pixels.setPixelColor(0, pixels.Color(0,0,0));
-  pixels.setPixelColor(1, pixels.Color(0,0,0));
-  pixels.setPixelColor(2, pixels.Color(0,0,0));
-  pixels.setPixelColor(3, pixels.Color(0,0,0));
-  pixels.show();
+  // From now on loop() drains the log
+  logger.setSink(publishLogLine, LOG_MQTT_LEVEL);
+  logger.setBlocking(false);
 
-  timer.setInterval(INTERVAL_PUBLISH_STATE, publishState);
+#if EVENT_TRACE
+  startEventTrace();
+#endif
 }
 
 
 void loop() {
-  timer.run();
+  metrics.loopBegin();
+
+  scheduler.run();
+
+  bool wifiWasUp = connection.isWiFiUp();
+  if (connection.update(millis(), WiFi.isConnected(), mqttReconnect.isConnected())) {
+    // Back on the network: try the broker now, not at the end of the backoff
+    mqttReconnect.networkRestored(millis());
+    // The access point may have changed, for the fast path of the next boot
+    wifiCache.store();
+  }
+  if (connection.isWiFiUp() != wifiWasUp) {
+    if (!connection.isWiFiUp() && mqttReconnect.isConnected()) {
+      // Do not wait for the keep alive to notice
+      mqttClient.disconnect(true);
+    } else if (waActive) {
+      showConnectionState();
+    }
+  }
+  if (connection.shouldRescan(millis())) {
+    // The SDK only retries the access point it lost
+    LOG_WARN("WiFi", "still no link, scanning for the access point");
+    WiFi.begin(WiFi.SSID().c_str(), WiFi.psk().c_str());
+  }
+
+  if (mqttReconnect.shouldConnect(millis(), WiFi.isConnected())) {
+    if (connectAllowed()) {
+      LOG_INFO("MQTT", "attempt %u, connecting to the broker", mqttReconnect.lastAttempts());
+      metrics.connectBegin();
+      mqttClient.connect();
+    } else {
+      mqttReconnect.disconnected(millis());
+    }
+  }
+  // The TLS handshake runs between the iterations
+  if (!mqttReconnect.isConnected()) {
+    metrics.connectSample();
+  }
 
-  waitingAnimation();
+  // Codes held too long offline must not reach the alarm late
+  uint32_t expired = outbox.expire(identity.codeTopic(), OFFLINE_CODE_MAX_AGE, millis());
+  if (expired > 0) {
+    LOG_WARN("Code", "%u held for too long, dropped", expired);
+    connection.codesExpired(expired);
+  }
 
-  errorAnimation();
+  // Send what was queued, in order
+  outbox.flush(mqttClient, millis());
 
-  // In case if the keypad is locked
-  if ( (millis() > lock_endtime) && (lock_endtime > 0) ) {
-    lock_endtime = 0;
-    errActive = false;
+#if DIAG_HTTP
+  // Requests wait while a code is being entered
+  if (queueInputCode.isEmpty()) {
+    diagnostics.handle();
   }
+#endif
 
-  if ( (!waActive) && (!errActive) ) {
-    char key = keypad.getKey();
+  if (reconfigureRequested) {
+    // Blocks in the portal until it is configured or times out
+    reconfigureRequested = false;
+    mqttClient.disconnect();
+#if DIAG_HTTP
+    // The portal takes port 80
+    diagnostics.stop();
+#endif
+    createCustomWiFiManager(true);
+    if (shouldSaveConfig) {
+      writeConfiguration();
+    }
+    restartRequested = true;
+  }
 
-    if (key) {
-      Serial.printf("Input symbol: [%c]\n", key);
-      switch(key)
-      {
-        case '#':
-          sendCode();
-          break;
-        case '*':
-          queueInputCode.removeTail();
-          break;
-        default:
-          queueInputCode.enqueue(key);
-      }
+  // Last resort, not while a code is being entered
+  if (connection.shouldRestart(millis()) && queueInputCode.isEmpty() && !restartRequested) {
+    LOG_ERROR("Main", "offline for %u ms, restarting", connection.offlineFor(millis()));
+    restartRequested = true;
+  }
+
+  if (restartRequested) {
+    LOG_INFO("Main", "restart requested");
+    logger.flush();
+    ESP.restart();
+  }
 
-      Serial.printf("  length: %d; Queue is full: %d\n", queueInputCode.count(), queueInputCode.isFull());
+  KeyEvent event;
+  while (keypad.getEvent(event)) {
+#if EVENT_TRACE
+    eventTrace.key(event.time, event.key);
+#endif
+    if (errActive) {
+      // The keypad is locked, the press is lost
+      continue;
+    }
+
+    char key = event.key;
+    idle.keyRegistered(millis());
+    LOG_DEBUG("Keys", "input symbol [%c]", key);
+    switch(key)
+    {
+      case '#':
+        sendCode(event.time);
+        metrics.codeLatency(millis() - event.time);
+        break;
+      case '*': {
+        char removed;
+        queueInputCode.popBack(removed);
+        break;
+      }
+      default:
+        if (queueInputCode.isEmpty()) {
+          codeStartTime = event.time;
+        }
+        queueInputCode.pushOverwrite(key);
     }
+    keyLatency = millis() - event.time;
+
+    LOG_DEBUG("Keys", "length %d, queue full %d, latency %lu ms", (int)queueInputCode.count(), queueInputCode.isFull(), keyLatency);
+  }
+
+  // Scan faster while a code is being entered
+  keypad.setFastScan(!queueInputCode.isEmpty());
 
+  idle.update(millis(), !waActive && !errActive && queueInputCode.isEmpty() && !keypad.hasEvents()
+                        && !leds.isActive(LedCompositor::LAYER_FEEDBACK));
+  leds.setActive(LedCompositor::LAYER_IDLE, idle.isIdle());
+
+  if (!errActive) {
+    // Amber while offline: the code will be held
+    uint32_t on = waActive ? pixels.Color(150,120,0) : pixels.Color(0,150,0);
     for (byte i = 0; i < DIGITS; i++ ) {
       bool isON = i < queueInputCode.count();
-       if ( isON ) {
-        pixels.setPixelColor(i, pixels.Color(0,150,0));
-      } else {
-        pixels.setPixelColor(i, pixels.Color(0,0,0));
-      }
+      leds.setPixel(LedCompositor::LAYER_CODE, i, isON ? on : pixels.Color(0,0,0));
     }
   }
+  if (waActive) {
+    // The connection state gives way to the code being entered and its feedback
+    leds.setActive(LedCompositor::LAYER_WAITING, queueInputCode.isEmpty() && !leds.isActive(LedCompositor::LAYER_FEEDBACK));
+  }
 
-  pixels.show();
+  // Renders the animation frames which are due, then pushes a frame to
+  // the strip only if the composition changed
+  animator.update(millis());
+  leds.update();
+#if EVENT_TRACE
+  traceLedFrame();
+#endif
 
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("loop(): WiFi is not connected. Reset the device to initiate connection again.");
-    ESP.restart();
+  metrics.loopEnd();
+
+  // Nothing to do before the next deadline: let the SDK run instead of
+  // spinning. Capped so queued key presses are picked up quickly.
+  if (!keypad.hasEvents()) {
+    uint32_t wait = scheduler.timeUntilNext(idle.isIdle() ? IDLE_LOOP_MAX_MS : LOOP_MAX_IDLE_MS);
+    wait = animator.timeUntilNext(millis(), wait);
+    // The log goes out while there is time
+    logger.drain();
+    delay(wait);
+    idle.slept(wait);
   }
 }
@@ -0,0 +1,110 @@
+// CodeCache: keyed hashes against HMAC-SHA256 computed elsewhere, a list
+// is refused without a key, and the verify latency and bytes per code.
+//   pio test -e native_test -f test_bench_code_cache -v
+
+#include <chrono>
+#include <stdio.h>
+#include <unity.h>
+
+#include "CodeCache.h"
+
+static const char KEY[] = "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f";
+// hmac.new(key, salt + code, hashlib.sha256).digest()[:8] for 1234, 0000 and 9876
+static const char LIST[] =
+  "{\"salt\":\"a1b2c3d4e5f60718\",\"codes\":[\"95555b844284b8c6\",\"34c9d7bf25b26e97\",\"2540321984e43491\"]}";
+static const size_t ROUNDS = 20000;
+
+static void load(CodeCache &cache, const char *list) {
+  char payload[CODE_CACHE_PAYLOAD_SIZE];
+  strncpy(payload, list, sizeof(payload) - 1);
+  payload[sizeof(payload) - 1] = 0;
+  TEST_ASSERT_TRUE(cache.load(payload));
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_keyed_hashes() {
+  CodeCache cache;
+  TEST_ASSERT_TRUE(cache.setKey(KEY));
+  load(cache, LIST);
+  TEST_ASSERT_EQUAL(3, cache.size());
+  TEST_ASSERT_TRUE(cache.verify("1234", 4));
+  TEST_ASSERT_TRUE(cache.verify("0000", 4));
+  TEST_ASSERT_TRUE(cache.verify("9876", 4));
+  TEST_ASSERT_FALSE(cache.verify("1235", 4));
+  TEST_ASSERT_FALSE(cache.verify("123", 3));
+}
+
+void test_other_key_matches_nothing() {
+  CodeCache cache;
+  TEST_ASSERT_TRUE(cache.setKey("ffeeddccbbaa99887766554433221100"));
+  load(cache, LIST);
+  TEST_ASSERT_FALSE(cache.verify("1234", 4));
+}
+
+void test_plain_hash_no_longer_matches() {
+  // SHA-256(salt + "1234"), the format before the key
+  CodeCache cache;
+  TEST_ASSERT_TRUE(cache.setKey(KEY));
+  load(cache, "{\"salt\":\"a1b2c3d4e5f60718\",\"codes\":[\"9a1606825eb95fd5\"]}");
+  TEST_ASSERT_FALSE(cache.verify("1234", 4));
+}
+
+void test_no_key_refuses_list() {
+  char payload[CODE_CACHE_PAYLOAD_SIZE];
+  strcpy(payload, LIST);
+  CodeCache cache;
+  TEST_ASSERT_FALSE(cache.setKey(""));
+  TEST_ASSERT_FALSE(cache.hasKey());
+  TEST_ASSERT_FALSE(cache.load(payload));
+  TEST_ASSERT_FALSE(cache.isLoaded());
+}
+
+void test_short_or_invalid_key() {
+  CodeCache cache;
+  TEST_ASSERT_FALSE(cache.setKey("0011223344556677"));          // 8 bytes
+  TEST_ASSERT_FALSE(cache.setKey("00112233445566778899aabbccddeefg"));
+  TEST_ASSERT_FALSE(cache.setKey("0"));
+  TEST_ASSERT_FALSE(cache.hasKey());
+}
+
+void test_bench_verify() {
+  // a full cache, the check compares every slot anyway
+  char list[CODE_CACHE_PAYLOAD_SIZE] = "{\"salt\":\"a1b2c3d4e5f60718\",\"codes\":[";
+  for (int i = 0; i < CODE_CACHE_MAX; i++) {
+    snprintf(list + strlen(list), sizeof(list) - strlen(list), "%s\"%016x\"", i ? "," : "", i + 1);
+  }
+  strcat(list, "]}");
+  CodeCache cache;
+  TEST_ASSERT_TRUE(cache.setKey(KEY));
+  load(cache, list);
+  TEST_ASSERT_EQUAL(CODE_CACHE_MAX, cache.size());
+
+  volatile uint32_t matches = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < ROUNDS; i++) {
+    char code[5];
+    snprintf(code, sizeof(code), "%04u", (unsigned)(i % 10000));
+    matches += cache.verify(code, 4);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  double us = std::chrono::duration<double, std::micro>(elapsed).count() / ROUNDS;
+
+  char line[128];
+  snprintf(line, sizeof(line), "verify %.2f us (host), %u codes, %u bytes per code in the list, %u bytes in all",
+           us, (unsigned)CODE_CACHE_MAX, (unsigned)CodeCache::BYTES_PER_CODE, (unsigned)sizeof(CodeCache));
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL(0, matches);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_keyed_hashes);
+  RUN_TEST(test_other_key_matches_nothing);
+  RUN_TEST(test_plain_hash_no_longer_matches);
+  RUN_TEST(test_no_key_refuses_list);
+  RUN_TEST(test_short_or_invalid_key);
+  RUN_TEST(test_bench_verify);
+  return UNITY_END();
+}
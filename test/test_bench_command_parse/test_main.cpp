@@ -0,0 +1,170 @@
+// Parse time and peak memory per command: the fixed arena and static JSON
+// document of onMqttMessage() against a DynamicJsonBuffer per message, the
+// way the firmware parsed commands before.
+//   pio test -e native_test -f test_bench_command_parse -v
+
+#include <chrono>
+#include <stdio.h>
+#include <unity.h>
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "config.h"
+#include "CommandTable.h"
+#include "MessageAssembler.h"
+
+static const size_t ROUNDS = 20000;
+
+static uint32_t handled;
+static void commandCount(JsonObject &args) {
+  handled += commandArgument<uint32_t>(args, "duration", 1);
+}
+
+// The names of the command table of main.cpp
+static constexpr Command commands[] = {
+  { "brightness",  commandCount },
+  { "lock",        commandCount },
+  { "log",         commandCount },
+  { "reboot",      commandCount },
+  { "reconfigure", commandCount },
+  { "state",       commandCount },
+  { "trace",       commandCount },
+  { "unlock",      commandCount },
+};
+
+struct Sample {
+  const char *name;
+  const char *payload;
+  size_t chunk;     // delivered in chunks of this size, 0 for one
+};
+
+static char oversized[COMMAND_PAYLOAD_SIZE + 64];
+
+static const Sample samples[] = {
+  { "lock",       "{\"command\":\"lock\",\"duration\":20}", 0 },
+  { "brightness", "{\"command\":\"brightness\",\"value\":128}", 0 },
+  { "state",      "{\"command\":\"state\"}", 0 },
+  { "unknown",    "{\"command\":\"launch\",\"target\":\"moon\"}", 0 },
+  { "malformed",  "{\"command\":\"lock\",\"duration\":", 0 },
+  { "fragmented", "{\"command\":\"log\",\"level\":\"debug\",\"module\":\"MQTT\"}", 8 },
+  { "oversized",  oversized, 0 },
+};
+
+static MessageAssembler<COMMAND_PAYLOAD_SIZE> assembler;
+
+// onMqttMessage(): reassemble, parse in place, look the command up
+static size_t parseStatic(const char *payload, size_t total, size_t chunk) {
+  char *message = NULL;
+  for (size_t index = 0; index < total; index += chunk) {
+    size_t len = total - index < chunk ? total - index : chunk;
+    message = assembler.feed(payload + index, len, index, total);
+  }
+  if (message == NULL) {
+    return 0;
+  }
+  StaticJsonBuffer<COMMAND_JSON_SIZE> jsonBuffer;
+  JsonObject &json = jsonBuffer.parseObject(message);
+  if (json.success()) {
+    const char *command = json["command"];
+    const Command *entry = command != NULL ? findCommand(commands, command) : NULL;
+    if (entry != NULL) {
+      entry->handler(json);
+    }
+  }
+  return jsonBuffer.size();
+}
+
+// The former handler: a heap buffer per message parsing each chunk on its own
+static size_t parseDynamic(const char *payload, size_t total, size_t chunk, uint32_t &heapPeak) {
+  uint32_t freeBefore = ESP.getFreeHeap();
+  for (size_t index = 0; index < total; index += chunk) {
+    size_t len = total - index < chunk ? total - index : chunk;
+    // the payload is not terminated, the old code relied on it being so
+    char *copy = new char[len + 1];
+    memcpy(copy, payload + index, len);
+    copy[len] = 0;
+    DynamicJsonBuffer jsonBuffer;
+    JsonObject &json = jsonBuffer.parseObject(copy);
+    uint32_t used = freeBefore - ESP.getFreeHeap();
+    if (used > heapPeak) {
+      heapPeak = used;
+    }
+    if (json.success()) {
+      const char *command = json["command"];
+      const Command *entry = command != NULL ? findCommand(commands, command) : NULL;
+      if (entry != NULL) {
+        entry->handler(json);
+      }
+    }
+    delete[] copy;
+  }
+  return 0;
+}
+
+template<typename F>
+static double usPerCommand(F parse) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < ROUNDS; i++) {
+    parse();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::micro>(elapsed).count() / ROUNDS;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_bench_parse() {
+  memset(oversized, ' ', sizeof(oversized) - 1);
+  oversized[0] = '{';
+  oversized[sizeof(oversized) - 2] = '}';
+  ESP.getFreeHeap();
+
+  char line[128];
+  snprintf(line, sizeof(line), "static: %u bytes arena + %u bytes JSON document, on the stack",
+           (unsigned)sizeof(assembler), (unsigned)COMMAND_JSON_SIZE);
+  TEST_MESSAGE(line);
+
+  for (const Sample &sample : samples) {
+    size_t total = strlen(sample.payload);
+    size_t chunk = sample.chunk != 0 ? sample.chunk : total;
+
+    size_t used = 0;
+    uint32_t freeBefore = ESP.getFreeHeap();
+    double staticUs = usPerCommand([&]() { used = parseStatic(sample.payload, total, chunk); });
+    uint32_t staticHeap = freeBefore - ESP.getFreeHeap();
+
+    uint32_t dynamicHeap = 0;
+    double dynamicUs = usPerCommand([&]() { parseDynamic(sample.payload, total, chunk, dynamicHeap); });
+
+    snprintf(line, sizeof(line), "%-10s %3u bytes: static %.2f us, %u bytes of JSON, %u heap | dynamic %.2f us, %u heap",
+             sample.name, (unsigned)total, staticUs, (unsigned)used, (unsigned)staticHeap, dynamicUs, (unsigned)dynamicHeap);
+    TEST_MESSAGE(line);
+
+    // the command path must not touch the heap
+    TEST_ASSERT_EQUAL(0, staticHeap);
+  }
+  TEST_ASSERT_TRUE(handled > 0);
+}
+
+void test_fragmented_parsed_whole() {
+  const Sample &sample = samples[5];
+  size_t used = parseStatic(sample.payload, strlen(sample.payload), sample.chunk);
+  TEST_ASSERT_TRUE(used > 0);
+  TEST_ASSERT_EQUAL_STRING(sample.payload, assembler.feed(sample.payload, strlen(sample.payload), 0, strlen(sample.payload)));
+}
+
+void test_oversized_rejected() {
+  uint32_t rejected = assembler.rejectedCount();
+  TEST_ASSERT_EQUAL(0, parseStatic(oversized, strlen(oversized), strlen(oversized)));
+  TEST_ASSERT_EQUAL(rejected + 1, assembler.rejectedCount());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_bench_parse);
+  RUN_TEST(test_fragmented_parsed_whole);
+  RUN_TEST(test_oversized_rejected);
+  return UNITY_END();
+}
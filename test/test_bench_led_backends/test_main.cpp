@@ -0,0 +1,111 @@
+// Cost of show() for both LED backends: Adafruit_NeoPixel bit-banging the
+// frame with the interrupts masked against Ws2812Uart loading the UART1
+// FIFO. The device time comes from the simulated strip (virtual us), the
+// host time is only the cost of the code around it.
+//   pio test -e native_test -f test_bench_led_backends -v
+
+#include <chrono>
+#include <stdio.h>
+#include <unity.h>
+
+#include <Adafruit_NeoPixel.h>
+
+#include "config.h"
+#include "NativeSim.h"
+#include "Ws2812Uart.h"
+
+static const uint16_t PIXELS = DIGITS;
+static const size_t FRAMES = 2000;
+static const uint32_t COLORS[] = { 0xFF0000, 0x00FF00, 0x0000FF, 0x123456 };
+
+struct Cost {
+  double deviceUs;     // per show(), virtual time
+  double maskedUs;     // interrupts masked per show()
+  double hostNs;
+};
+
+template<typename Strip>
+static void paint(Strip &strip, size_t frame) {
+  for (uint16_t i = 0; i < PIXELS; i++) {
+    strip.setPixelColor(i, COLORS[(i + frame) % 4]);
+  }
+}
+
+template<typename Strip>
+static Cost measure(Strip &strip, uint32_t period) {
+  Cost cost = {};
+  uint32_t maskedBefore = NativeSim::counters().ledMaskedMicros;
+  uint64_t device = 0;
+  std::chrono::steady_clock::duration host = std::chrono::steady_clock::duration::zero();
+  for (size_t frame = 0; frame < FRAMES; frame++) {
+    paint(strip, frame);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t virtualStart = NativeSim::nowMicros();
+    strip.show();
+    uint64_t virtualEnd = NativeSim::nowMicros();
+    host += std::chrono::steady_clock::now() - start;
+    // the host time of the call is part of the virtual clock too
+    device += virtualEnd - virtualStart;
+    // the next frame once this one is latched
+    NativeSim::advanceMicros(period);
+  }
+  cost.deviceUs = (double)device / FRAMES;
+  cost.maskedUs = (double)(NativeSim::counters().ledMaskedMicros - maskedBefore) / FRAMES;
+  cost.hostNs = std::chrono::duration<double, std::nano>(host).count() / FRAMES;
+  return cost;
+}
+
+template<typename Strip>
+static void assertShown(Strip &strip) {
+  paint(strip, 1);
+  strip.show();
+  NativeSim::advanceMicros(1000);
+  for (uint16_t i = 0; i < PIXELS; i++) {
+    TEST_ASSERT_EQUAL_HEX32(COLORS[(i + 1) % 4], NativeSim::ledColor(i));
+  }
+}
+
+static void report(const char *name, const Cost &cost) {
+  char line[128];
+  snprintf(line, sizeof(line), "%-17s show() %.1f us on the device, %.1f us masked, %.0f ns on the host",
+           name, cost.deviceUs, cost.maskedUs, cost.hostNs);
+  TEST_MESSAGE(line);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_same_frame() {
+  Adafruit_NeoPixel neoPixel(PIXELS);
+  neoPixel.begin();
+  assertShown(neoPixel);
+
+  Ws2812Uart uart(PIXELS);
+  uart.begin();
+  assertShown(uart);
+}
+
+void test_bench_show() {
+  Adafruit_NeoPixel neoPixel(PIXELS);
+  neoPixel.begin();
+  Cost bitBang = measure(neoPixel, 1000);
+
+  Ws2812Uart uart(PIXELS);
+  uart.begin();
+  Cost fifo = measure(uart, 1000);
+
+  report("Adafruit_NeoPixel", bitBang);
+  report("Ws2812Uart", fifo);
+
+  // 24 bits of 1.25us a pixel with the interrupts off
+  TEST_ASSERT_EQUAL_FLOAT(PIXELS * 30.0, bitBang.maskedUs);
+  TEST_ASSERT_EQUAL_FLOAT(0.0, fifo.maskedUs);
+  TEST_ASSERT_TRUE(fifo.deviceUs < bitBang.deviceUs);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_same_frame);
+  RUN_TEST(test_bench_show);
+  return UNITY_END();
+}
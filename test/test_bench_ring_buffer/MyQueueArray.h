@@ -1,4 +1,5 @@
-// The source code is taken from: https://github.com/EinarArnason/ArduinoQueue
+// QueueArray as the firmware used it before RingBuffer, the baseline of the
+// benchmark. Taken from: https://github.com/EinarArnason/ArduinoQueue
 
 #ifndef MY_QUEUEARRAY_H
 #define MY_QUEUEARRAY_H
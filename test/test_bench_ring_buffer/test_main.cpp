@@ -0,0 +1,130 @@
+// Code entry with RingBuffer against the QueueArray it replaced: time per
+// key and bytes per buffer, for the same keys and the same codes.
+//   pio test -e native_test -f test_bench_ring_buffer
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "config.h"
+#include "RingBuffer.h"
+#include "MyQueueArray.h"
+
+// More keys than digits so that the overwrite path runs, then a correction
+static const char KEYS[] = "1234567*8#39*#*#0000000#";
+static const size_t ROUNDS = 200000;
+
+// removeTail() prints the length, the old firmware sent it to Serial
+class NullPrint : public Print {
+  public:
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t *, size_t size) override { return size; }
+};
+
+static NullPrint sink;
+static volatile uint32_t checksum;
+
+// The code entry of main.cpp, returns the codes sent in a round
+static size_t enterRing(RingBuffer<char, DIGITS> &queue, char *codes) {
+  size_t sent = 0;
+  for (const char *key = KEYS; *key != 0; key++) {
+    char removed;
+    switch (*key) {
+      case '#':
+        if (!queue.isEmpty()) {
+          size_t length = queue.copyTo(codes + sent, DIGITS);
+          queue.clear();
+          sent += length;
+          codes[sent++] = '|';
+        }
+        break;
+      case '*':
+        queue.popBack(removed);
+        break;
+      default:
+        queue.pushOverwrite(*key);
+    }
+  }
+  return sent;
+}
+
+// The same with the QueueArray of the original firmware
+static size_t enterQueue(QueueArray<char> &queue, char *codes) {
+  size_t sent = 0;
+  for (const char *key = KEYS; *key != 0; key++) {
+    switch (*key) {
+      case '#':
+        if (!queue.isEmpty()) {
+          while (!queue.isEmpty()) {
+            codes[sent++] = queue.dequeue();
+          }
+          codes[sent++] = '|';
+        }
+        break;
+      case '*':
+        queue.removeTail();
+        break;
+      default:
+        queue.enqueue(*key);
+    }
+  }
+  return sent;
+}
+
+template<typename F>
+static double nsPerKey(F round) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < ROUNDS; i++) {
+    round();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+  return ns / (ROUNDS * (sizeof(KEYS) - 1));
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_same_codes() {
+  RingBuffer<char, DIGITS> ring;
+  QueueArray<char> queue(DIGITS);
+  queue.setPrinter(sink);
+  char ringCodes[64];
+  char queueCodes[64];
+  size_t ringLength = enterRing(ring, ringCodes);
+  size_t queueLength = enterQueue(queue, queueCodes);
+  ringCodes[ringLength] = 0;
+  queueCodes[queueLength] = 0;
+  TEST_ASSERT_EQUAL_STRING("4568|3|0000|", ringCodes);
+  TEST_ASSERT_EQUAL_STRING(ringCodes, queueCodes);
+}
+
+void test_bench_code_entry() {
+  RingBuffer<char, DIGITS> ring;
+  QueueArray<char> queue(DIGITS);
+  queue.setPrinter(sink);
+  char codes[64];
+
+  double ringNs = nsPerKey([&]() { checksum += enterRing(ring, codes) + codes[0]; });
+  double queueNs = nsPerKey([&]() { checksum += enterQueue(queue, codes) + codes[0]; });
+
+  // QueueArray keeps its contents on the heap
+  size_t ringBytes = sizeof(ring);
+  size_t queueBytes = sizeof(queue) + DIGITS * sizeof(char);
+
+  char line[96];
+  snprintf(line, sizeof(line), "RingBuffer %.1f ns/key, %u bytes", ringNs, (unsigned)ringBytes);
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line), "QueueArray %.1f ns/key, %u bytes (heap included)", queueNs, (unsigned)queueBytes);
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_TRUE(ringBytes <= queueBytes);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_same_codes);
+  RUN_TEST(test_bench_code_entry);
+  return UNITY_END();
+}
@@ -0,0 +1,141 @@
+// Bytes and time per state publish: StateSerializer and JsonWriter against
+// the ArduinoJson document publishState() built before. The host has no
+// cycle counter of the ESP8266, the time is wall clock ns on the host; the
+// device logs its own us per publish.
+//   pio test -e native_test -f test_bench_state -v
+
+#include <chrono>
+#include <stdio.h>
+#include <unity.h>
+
+#include <ArduinoJson.h>
+#include <ESP8266WiFi.h>
+
+#include "config.h"
+#include "JsonWriter.h"
+#include "StateSerializer.h"
+
+static const size_t ROUNDS = 50000;
+
+// The volatile fields of a state document
+struct State {
+  int rssi;
+  const char *uptime;
+  uint32_t attempts;
+  uint32_t reconnects;
+  uint32_t reconnectMs;
+  uint32_t queue;
+  uint32_t dropped;
+  uint32_t ackMs;
+};
+
+static const State state = { -58, "0T12:34:56.789", 3, 2, 960, 1, 0, 12 };
+static const uint32_t IP = 0x6601A8C0;   // 192.168.1.102
+
+static StateSerializer serializer;
+
+static size_t publishWriter(char *buffer) {
+  JsonWriter json(buffer, PUBLISH_PAYLOAD_SIZE);
+  serializer.writeFixed(json, IP);
+  char rssi[8];
+  sprintf(rssi, "%d", state.rssi);
+  json.add("rssi", rssi);
+  json.add("uptime", state.uptime);
+  json.add("mqtt_attempts", state.attempts);
+  json.add("mqtt_reconnects", state.reconnects);
+  json.add("mqtt_reconnect_ms", state.reconnectMs);
+  json.add("publish_queue", state.queue);
+  json.add("publish_dropped", state.dropped);
+  json.add("ack_ms", state.ackMs);
+  return json.end();
+}
+
+// publishState() before the serializer, the same fields
+static size_t publishArduinoJson(char *buffer) {
+  StaticJsonBuffer<JSON_OBJECT_SIZE(20)> jsonBuffer;
+  JsonObject &root = jsonBuffer.createObject();
+  char ip[16];
+  memset(ip, 0, sizeof(ip));
+  sprintf(ip, "%s", IPAddress(IP).toString().c_str());
+  root["ip"] = ip;
+  uint8_t macAddr[6];
+  WiFi.macAddress(macAddr);
+  char mac[18];
+  memset(mac, 0, 18);
+  sprintf(mac, "%02X:%02X:%02X:%02X:%02X:%02X", macAddr[0], macAddr[1], macAddr[2], macAddr[3], macAddr[4], macAddr[5]);
+  root["mac"] = mac;
+  root["version"] = FIRMWARE_VERSION;
+  char rssi[8];
+  sprintf(rssi, "%d", state.rssi);
+  root["rssi"] = rssi;
+  root["uptime"] = state.uptime;
+  root["mqtt_attempts"] = state.attempts;
+  root["mqtt_reconnects"] = state.reconnects;
+  root["mqtt_reconnect_ms"] = state.reconnectMs;
+  root["publish_queue"] = state.queue;
+  root["publish_dropped"] = state.dropped;
+  root["ack_ms"] = state.ackMs;
+  if (root.measureLength() >= PUBLISH_PAYLOAD_SIZE) {
+    return 0;
+  }
+  return root.printTo(buffer, PUBLISH_PAYLOAD_SIZE);
+}
+
+template<typename F>
+static double nsPerPublish(F publish) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < ROUNDS; i++) {
+    publish();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / ROUNDS;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_same_document() {
+  char writer[PUBLISH_PAYLOAD_SIZE];
+  char arduinoJson[PUBLISH_PAYLOAD_SIZE];
+  TEST_ASSERT_TRUE(publishWriter(writer) > 0);
+  TEST_ASSERT_TRUE(publishArduinoJson(arduinoJson) > 0);
+
+  // the same fields and values, both parse back
+  StaticJsonBuffer<JSON_OBJECT_SIZE(20)> a;
+  StaticJsonBuffer<JSON_OBJECT_SIZE(20)> b;
+  JsonObject &parsedWriter = a.parseObject(writer);
+  JsonObject &parsedArduinoJson = b.parseObject(arduinoJson);
+  TEST_ASSERT_TRUE(parsedWriter.success());
+  TEST_ASSERT_TRUE(parsedArduinoJson.success());
+  const char *keys[] = { "ip", "mac", "version", "rssi", "uptime", "mqtt_attempts", "mqtt_reconnects",
+                         "mqtt_reconnect_ms", "publish_queue", "publish_dropped", "ack_ms" };
+  for (const char *key : keys) {
+    TEST_ASSERT_TRUE_MESSAGE(parsedWriter.containsKey(key), key);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(parsedArduinoJson[key].as<const char *>(), parsedWriter[key].as<const char *>(), key);
+  }
+}
+
+void test_bench_publish() {
+  char buffer[PUBLISH_PAYLOAD_SIZE];
+  size_t writerBytes = 0;
+  size_t arduinoJsonBytes = 0;
+  double writerNs = nsPerPublish([&]() { writerBytes = publishWriter(buffer); });
+  double arduinoJsonNs = nsPerPublish([&]() { arduinoJsonBytes = publishArduinoJson(buffer); });
+
+  char line[128];
+  snprintf(line, sizeof(line), "JsonWriter  %.0f ns, %u bytes out, %u bytes of state (serializer and writer)",
+           writerNs, (unsigned)writerBytes, (unsigned)(sizeof(StateSerializer) + sizeof(JsonWriter)));
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line), "ArduinoJson %.0f ns, %u bytes out, %u bytes of document on the stack",
+           arduinoJsonNs, (unsigned)arduinoJsonBytes, (unsigned)JSON_OBJECT_SIZE(20));
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_EQUAL(arduinoJsonBytes, writerBytes);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_same_document);
+  RUN_TEST(test_bench_publish);
+  return UNITY_END();
+}
@@ -0,0 +1,133 @@
+// JsonWriter: field formatting, string escaping and what happens when the
+// document does not fit the buffer.
+//   pio test -e native_test -f test_json_writer
+
+#include <limits.h>
+#include <unity.h>
+
+#include "JsonWriter.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_empty_object() {
+  char buffer[8];
+  JsonWriter json(buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL(2, json.end());
+  TEST_ASSERT_EQUAL_STRING("{}", buffer);
+}
+
+void test_field_types() {
+  char buffer[128];
+  const uint32_t values[] = { 1, 0, 4294967295UL };
+  JsonWriter json(buffer, sizeof(buffer));
+  json.add("s", "text");
+  json.add("i", -42);
+  json.add("u", 42u);
+  json.add("l", (long)LONG_MIN);
+  json.add("b", true);
+  json.add("f", false);
+  json.addArray("a", values, 3);
+  json.addArray("e", values, 0);
+  size_t length = json.end();
+  char expected[128];
+  snprintf(expected, sizeof(expected),
+           "{\"s\":\"text\",\"i\":-42,\"u\":42,\"l\":%ld,\"b\":true,\"f\":false,\"a\":[1,0,4294967295],\"e\":[]}",
+           (long)LONG_MIN);
+  TEST_ASSERT_EQUAL_STRING(expected, buffer);
+  TEST_ASSERT_EQUAL(strlen(expected), length);
+}
+
+void test_raw_fragment() {
+  char buffer[64];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.addRaw("\"ip\":\"10.0.0.2\",\"version\":\"1\"", 29);
+  json.addRaw("", 0);
+  json.add("n", 1);
+  json.end();
+  TEST_ASSERT_EQUAL_STRING("{\"ip\":\"10.0.0.2\",\"version\":\"1\",\"n\":1}", buffer);
+}
+
+void test_escape_quote_and_backslash() {
+  char buffer[64];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.add("path", "C:\\keypad \"1\"");
+  json.end();
+  TEST_ASSERT_EQUAL_STRING("{\"path\":\"C:\\\\keypad \\\"1\\\"\"}", buffer);
+}
+
+void test_escape_control_characters() {
+  char buffer[64];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.add("ssid", "a\nb\tc\x01");
+  json.end();
+  TEST_ASSERT_EQUAL_STRING("{\"ssid\":\"a\\u000ab\\u0009c\\u0001\"}", buffer);
+}
+
+void test_utf8_kept() {
+  char buffer[64];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.add("name", "k\xC3\xA4ypad");
+  json.end();
+  TEST_ASSERT_EQUAL_STRING("{\"name\":\"k\xC3\xA4ypad\"}", buffer);
+}
+
+void test_exact_fit() {
+  // 9 characters and the terminator
+  char buffer[10];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.add("ab", 12);
+  TEST_ASSERT_EQUAL(9, json.end());
+  TEST_ASSERT_EQUAL_STRING("{\"ab\":12}", buffer);
+}
+
+void test_overflow_by_one() {
+  char buffer[9];
+  memset(buffer, 'x', sizeof(buffer));
+  JsonWriter json(buffer, sizeof(buffer));
+  json.add("ab", 12);
+  TEST_ASSERT_EQUAL(0, json.end());
+  // nothing is written past the buffer
+  TEST_ASSERT_EQUAL_CHAR('x', buffer[8]);
+}
+
+void test_overflow_in_string() {
+  char buffer[16];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.add("code", "\"\"\"\"\"\"\"\"");
+  TEST_ASSERT_EQUAL(0, json.end());
+}
+
+void test_overflow_ignores_later_fields() {
+  char buffer[16];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.add("a", 1);
+  json.add("long_name", "long value");
+  // would fit on its own, but the document is already truncated
+  json.add("b", 2);
+  TEST_ASSERT_EQUAL(0, json.end());
+}
+
+void test_overflow_in_escape() {
+  // the escape of the control character does not fit, the rest would
+  char buffer[12];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.add("k", "\n");
+  TEST_ASSERT_EQUAL(0, json.end());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_object);
+  RUN_TEST(test_field_types);
+  RUN_TEST(test_raw_fragment);
+  RUN_TEST(test_escape_quote_and_backslash);
+  RUN_TEST(test_escape_control_characters);
+  RUN_TEST(test_utf8_kept);
+  RUN_TEST(test_exact_fit);
+  RUN_TEST(test_overflow_by_one);
+  RUN_TEST(test_overflow_in_string);
+  RUN_TEST(test_overflow_ignores_later_fields);
+  RUN_TEST(test_overflow_in_escape);
+  return UNITY_END();
+}
@@ -0,0 +1,134 @@
+// MessageAssembler: payloads split in chunks as AsyncMqttClient delivers
+// them (len, index, total), chunks out of order and oversized payloads.
+//   pio test -e native_test -f test_message_assembler
+
+#include <unity.h>
+
+#include "MessageAssembler.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Feed a payload in chunks of the given size, returns the result of the last one
+template<size_t N>
+char *feedChunks(MessageAssembler<N> &assembler, const char *payload, size_t chunk) {
+  size_t total = strlen(payload);
+  char *message = NULL;
+  for (size_t index = 0; index < total; index += chunk) {
+    size_t len = total - index < chunk ? total - index : chunk;
+    message = assembler.feed(payload + index, len, index, total);
+    if (index + len < total) {
+      TEST_ASSERT_NULL(message);
+    }
+  }
+  return message;
+}
+
+void test_single_chunk() {
+  MessageAssembler<16> assembler;
+  char *message = assembler.feed("{\"a\":1}", 7, 0, 7);
+  TEST_ASSERT_NOT_NULL(message);
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1}", message);
+  TEST_ASSERT_EQUAL(7, assembler.length());
+  TEST_ASSERT_EQUAL(0, assembler.rejectedCount());
+}
+
+void test_not_null_terminated() {
+  // the payload of AsyncMqttClient is not terminated, only len counts
+  MessageAssembler<16> assembler;
+  char *message = assembler.feed("lockXXXX", 4, 0, 4);
+  TEST_ASSERT_EQUAL_STRING("lock", message);
+}
+
+void test_split_chunks() {
+  MessageAssembler<32> assembler;
+  const char *payload = "{\"command\":\"lock\",\"duration\":9}";
+  for (size_t chunk = 1; chunk <= strlen(payload); chunk++) {
+    char *message = feedChunks(assembler, payload, chunk);
+    TEST_ASSERT_NOT_NULL(message);
+    TEST_ASSERT_EQUAL_STRING(payload, message);
+  }
+  TEST_ASSERT_EQUAL(0, assembler.rejectedCount());
+}
+
+void test_exactly_capacity() {
+  MessageAssembler<8> assembler;
+  char *message = feedChunks(assembler, "12345678", 3);
+  TEST_ASSERT_EQUAL_STRING("12345678", message);
+  TEST_ASSERT_EQUAL(0, assembler.rejectedCount());
+}
+
+void test_oversized_rejected_on_first_chunk() {
+  MessageAssembler<8> assembler;
+  TEST_ASSERT_NULL(assembler.feed("12345", 5, 0, 9));
+  TEST_ASSERT_EQUAL(1, assembler.rejectedCount());
+  // the rest of the message is skipped, not counted again
+  TEST_ASSERT_NULL(assembler.feed("6789", 4, 5, 9));
+  TEST_ASSERT_EQUAL(1, assembler.rejectedCount());
+
+  // the next message is taken
+  TEST_ASSERT_EQUAL_STRING("ok", assembler.feed("ok", 2, 0, 2));
+}
+
+void test_out_of_order_rejected() {
+  MessageAssembler<16> assembler;
+  TEST_ASSERT_NULL(assembler.feed("abc", 3, 0, 9));
+  // a chunk is missing
+  TEST_ASSERT_NULL(assembler.feed("ghi", 3, 6, 9));
+  TEST_ASSERT_EQUAL(1, assembler.rejectedCount());
+  // the missing chunk comes too late
+  TEST_ASSERT_NULL(assembler.feed("def", 3, 3, 9));
+  TEST_ASSERT_EQUAL(1, assembler.rejectedCount());
+
+  TEST_ASSERT_EQUAL_STRING("abcdefghi", feedChunks(assembler, "abcdefghi", 3));
+}
+
+void test_continuation_without_start() {
+  MessageAssembler<16> assembler;
+  TEST_ASSERT_NULL(assembler.feed("def", 3, 3, 6));
+  TEST_ASSERT_EQUAL(1, assembler.rejectedCount());
+}
+
+void test_total_changes_between_chunks() {
+  MessageAssembler<16> assembler;
+  TEST_ASSERT_NULL(assembler.feed("abc", 3, 0, 6));
+  TEST_ASSERT_NULL(assembler.feed("def", 3, 3, 8));
+  TEST_ASSERT_EQUAL(1, assembler.rejectedCount());
+}
+
+void test_new_message_restarts() {
+  // a message cut short by a reconnect is dropped by the next one
+  MessageAssembler<16> assembler;
+  TEST_ASSERT_NULL(assembler.feed("abc", 3, 0, 6));
+  TEST_ASSERT_EQUAL_STRING("xy", assembler.feed("xy", 2, 0, 2));
+  TEST_ASSERT_EQUAL(2, assembler.length());
+}
+
+void test_chunk_longer_than_announced() {
+  MessageAssembler<16> assembler;
+  TEST_ASSERT_NULL(assembler.feed("ab", 2, 0, 4));
+  TEST_ASSERT_NULL(assembler.feed("cdef", 4, 2, 4));
+  TEST_ASSERT_EQUAL(1, assembler.rejectedCount());
+  // the message stays rejected
+  TEST_ASSERT_NULL(assembler.feed("cd", 2, 2, 4));
+  TEST_ASSERT_EQUAL(1, assembler.rejectedCount());
+
+  MessageAssembler<4> small;
+  TEST_ASSERT_NULL(small.feed("abcdef", 6, 0, 4));
+  TEST_ASSERT_EQUAL(1, small.rejectedCount());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_single_chunk);
+  RUN_TEST(test_not_null_terminated);
+  RUN_TEST(test_split_chunks);
+  RUN_TEST(test_exactly_capacity);
+  RUN_TEST(test_oversized_rejected_on_first_chunk);
+  RUN_TEST(test_out_of_order_rejected);
+  RUN_TEST(test_continuation_without_start);
+  RUN_TEST(test_total_changes_between_chunks);
+  RUN_TEST(test_new_message_restarts);
+  RUN_TEST(test_chunk_longer_than_announced);
+  return UNITY_END();
+}
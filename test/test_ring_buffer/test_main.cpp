@@ -0,0 +1,205 @@
+// RingBuffer: FIFO order, overwrite of the oldest item and removal of the
+// newest one, across the wraparound of the storage.
+//   pio test -e native_test -f test_ring_buffer
+
+#include <unity.h>
+
+#include "RingBuffer.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Move the head to the given slot, leaving the buffer empty
+template<typename T, size_t N>
+void rotate(RingBuffer<T, N> &buffer, size_t steps) {
+  T item;
+  for (size_t i = 0; i < steps; i++) {
+    buffer.push(T());
+    buffer.pop(item);
+  }
+}
+
+void test_empty() {
+  RingBuffer<char, 4> buffer;
+  char item = 'x';
+  TEST_ASSERT_TRUE(buffer.isEmpty());
+  TEST_ASSERT_FALSE(buffer.isFull());
+  TEST_ASSERT_EQUAL(0, buffer.count());
+  TEST_ASSERT_FALSE(buffer.pop(item));
+  TEST_ASSERT_FALSE(buffer.popBack(item));
+  TEST_ASSERT_EQUAL_CHAR('x', item);
+  TEST_ASSERT_EQUAL(0, buffer.copyTo(&item, 1));
+}
+
+void test_push_pop_fifo() {
+  RingBuffer<char, 4> buffer;
+  TEST_ASSERT_TRUE(buffer.push('1'));
+  TEST_ASSERT_TRUE(buffer.push('2'));
+  TEST_ASSERT_TRUE(buffer.push('3'));
+  TEST_ASSERT_EQUAL(3, buffer.count());
+  TEST_ASSERT_EQUAL_CHAR('1', buffer.front());
+  TEST_ASSERT_EQUAL_CHAR('3', buffer.back());
+
+  char item;
+  TEST_ASSERT_TRUE(buffer.pop(item));
+  TEST_ASSERT_EQUAL_CHAR('1', item);
+  TEST_ASSERT_TRUE(buffer.pop(item));
+  TEST_ASSERT_EQUAL_CHAR('2', item);
+  TEST_ASSERT_TRUE(buffer.pop(item));
+  TEST_ASSERT_EQUAL_CHAR('3', item);
+  TEST_ASSERT_TRUE(buffer.isEmpty());
+}
+
+void test_push_fails_when_full() {
+  RingBuffer<char, 4> buffer;
+  for (char c = '1'; c <= '4'; c++) {
+    TEST_ASSERT_TRUE(buffer.push(c));
+  }
+  TEST_ASSERT_TRUE(buffer.isFull());
+  TEST_ASSERT_FALSE(buffer.push('5'));
+  TEST_ASSERT_EQUAL(4, buffer.count());
+  TEST_ASSERT_EQUAL_CHAR('4', buffer.back());
+}
+
+void test_push_pop_across_wraparound() {
+  // every start slot, filled to every level
+  for (size_t start = 0; start < 4; start++) {
+    for (size_t fill = 1; fill <= 4; fill++) {
+      RingBuffer<int, 4> buffer;
+      rotate(buffer, start);
+      for (size_t i = 0; i < fill; i++) {
+        TEST_ASSERT_TRUE(buffer.push((int)i));
+      }
+      TEST_ASSERT_EQUAL(fill, buffer.count());
+      for (size_t i = 0; i < fill; i++) {
+        int item;
+        TEST_ASSERT_TRUE(buffer.pop(item));
+        TEST_ASSERT_EQUAL((int)i, item);
+      }
+      TEST_ASSERT_TRUE(buffer.isEmpty());
+    }
+  }
+}
+
+void test_pop_back_across_wraparound() {
+  for (size_t start = 0; start < 4; start++) {
+    RingBuffer<int, 4> buffer;
+    rotate(buffer, start);
+    for (int i = 0; i < 4; i++) {
+      buffer.push(i);
+    }
+    // newest first
+    for (int i = 3; i >= 0; i--) {
+      int item;
+      TEST_ASSERT_EQUAL(i, buffer.back());
+      TEST_ASSERT_TRUE(buffer.popBack(item));
+      TEST_ASSERT_EQUAL(i, item);
+    }
+    TEST_ASSERT_TRUE(buffer.isEmpty());
+  }
+}
+
+void test_pop_back_then_push() {
+  // '*' removes the last digit, the next one takes its place
+  RingBuffer<char, 4> buffer;
+  rotate(buffer, 3);
+  buffer.push('1');
+  buffer.push('2');
+  char item;
+  buffer.popBack(item);
+  buffer.push('3');
+  char code[4];
+  TEST_ASSERT_EQUAL(2, buffer.copyTo(code, sizeof(code)));
+  TEST_ASSERT_EQUAL_MEMORY("13", code, 2);
+}
+
+void test_push_overwrite_drops_oldest() {
+  for (size_t start = 0; start < 4; start++) {
+    RingBuffer<char, 4> buffer;
+    rotate(buffer, start);
+    const char *keys = "123456";
+    for (const char *k = keys; *k != 0; k++) {
+      buffer.pushOverwrite(*k);
+    }
+    TEST_ASSERT_TRUE(buffer.isFull());
+    TEST_ASSERT_EQUAL_CHAR('3', buffer.front());
+    TEST_ASSERT_EQUAL_CHAR('6', buffer.back());
+    char code[4];
+    TEST_ASSERT_EQUAL(4, buffer.copyTo(code, sizeof(code)));
+    TEST_ASSERT_EQUAL_MEMORY("3456", code, 4);
+  }
+}
+
+void test_push_overwrite_below_capacity() {
+  RingBuffer<char, 4> buffer;
+  buffer.pushOverwrite('1');
+  buffer.pushOverwrite('2');
+  TEST_ASSERT_EQUAL(2, buffer.count());
+  TEST_ASSERT_EQUAL_CHAR('1', buffer.front());
+}
+
+void test_copy_to_across_wraparound() {
+  for (size_t start = 0; start < 4; start++) {
+    RingBuffer<char, 4> buffer;
+    rotate(buffer, start);
+    buffer.push('a');
+    buffer.push('b');
+    buffer.push('c');
+    char out[4] = { 0, 0, 0, 0 };
+    TEST_ASSERT_EQUAL(3, buffer.copyTo(out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY("abc", out, 3);
+    // copyTo() leaves the items in place
+    TEST_ASSERT_EQUAL(3, buffer.count());
+  }
+}
+
+void test_copy_to_limited() {
+  RingBuffer<char, 4> buffer;
+  rotate(buffer, 2);
+  for (char c = '1'; c <= '4'; c++) {
+    buffer.push(c);
+  }
+  char out[2];
+  TEST_ASSERT_EQUAL(2, buffer.copyTo(out, sizeof(out)));
+  TEST_ASSERT_EQUAL_MEMORY("12", out, 2);
+}
+
+void test_clear() {
+  RingBuffer<char, 4> buffer;
+  rotate(buffer, 3);
+  buffer.push('1');
+  buffer.push('2');
+  buffer.clear();
+  TEST_ASSERT_TRUE(buffer.isEmpty());
+  buffer.push('3');
+  TEST_ASSERT_EQUAL_CHAR('3', buffer.front());
+  TEST_ASSERT_EQUAL_CHAR('3', buffer.back());
+}
+
+void test_capacity_one() {
+  RingBuffer<char, 1> buffer;
+  buffer.pushOverwrite('1');
+  buffer.pushOverwrite('2');
+  TEST_ASSERT_EQUAL(1, buffer.count());
+  char item;
+  TEST_ASSERT_TRUE(buffer.popBack(item));
+  TEST_ASSERT_EQUAL_CHAR('2', item);
+  TEST_ASSERT_TRUE(buffer.isEmpty());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty);
+  RUN_TEST(test_push_pop_fifo);
+  RUN_TEST(test_push_fails_when_full);
+  RUN_TEST(test_push_pop_across_wraparound);
+  RUN_TEST(test_pop_back_across_wraparound);
+  RUN_TEST(test_pop_back_then_push);
+  RUN_TEST(test_push_overwrite_drops_oldest);
+  RUN_TEST(test_push_overwrite_below_capacity);
+  RUN_TEST(test_copy_to_across_wraparound);
+  RUN_TEST(test_copy_to_limited);
+  RUN_TEST(test_clear);
+  RUN_TEST(test_capacity_one);
+  return UNITY_END();
+}